@@ -0,0 +1,73 @@
+#ifndef UTILITIES_BENCH_H
+#define UTILITIES_BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "../include/utils/types.h"
+
+/**
+ * Minimal helpers for benchmarks, so they don't depend on any external framework.
+ */
+namespace bench {
+
+    using clock = std::chrono::steady_clock;
+
+    static f64 seconds_since(const clock::time_point start) {
+        return std::chrono::duration<f64>(clock::now() - start).count();
+    }
+
+    /**
+     * Runs the function and returns how long it took
+     *
+     * @param function function to measure
+     * @return duration in seconds
+     */
+    template <typename F>
+    f64 measure(const F& function) {
+        const auto start = clock::now();
+        function();
+        return seconds_since(start);
+    }
+
+    static void report(const char* const name, const u64 operations, const f64 seconds) {
+        printf("%-48s %12.2f Mops/s %10.2f ns/op\n",
+               name,
+               operations / seconds / 1e6,
+               seconds * 1e9 / operations);
+    }
+
+    static void report_throughput(const char* const name, const u64 bytes, const f64 seconds) {
+        printf("%-48s %12.2f MB/s\n", name, bytes / seconds / 1e6);
+    }
+
+    /**
+     * @param samples measurements (reordered by the call)
+     * @param fraction from 0 to 1, for example 0.99 for p99
+     * @return the smallest sample which is not less than the fraction of all samples
+     */
+    static u64 percentile(std::vector<u64>& samples, const f64 fraction) {
+        if (samples.empty()) return 0;
+        const size_t index = std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()));
+        std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+        return samples[index];
+    }
+
+    static void report_latency(const char* const name, std::vector<u64>& nanoseconds) {
+        printf("%-48s p50 %8.1f us  p99 %8.1f us  p999 %8.1f us\n",
+               name,
+               percentile(nanoseconds, 0.5) / 1e3,
+               percentile(nanoseconds, 0.99) / 1e3,
+               percentile(nanoseconds, 0.999) / 1e3);
+    }
+
+    // Stops the compiler from removing computations which results are not used
+    template <typename T>
+    void keep(const T& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+}
+
+#endif //UTILITIES_BENCH_H
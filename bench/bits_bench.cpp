@@ -0,0 +1,69 @@
+#include <random>
+#include "bench.h"
+#include "../include/utils/bits.h"
+#include "../include/utils/complex/collections.h"
+
+constexpr u32 VALUES = 4'000'000;
+constexpr u32 REPEATS = 20;
+
+// Decoded bytes are counted as 4 per value, so results of different encodings can be compared
+template <typename F>
+void decode(const char* const name, const F& function) {
+    const f64 seconds = bench::measure([&]() {
+        for (u32 r = 0; r < REPEATS; r++) function();
+    });
+    bench::report_throughput(name, u64{ VALUES } * REPEATS * sizeof(u32), seconds);
+}
+
+int main() {
+    // Delta-encoded coordinates: mostly small steps with rare jumps
+    std::mt19937 random{ 1 };
+    vec<i32> coordinates(VALUES);
+    i32 x = 0;
+    for (i32& c : coordinates) {
+        x += static_cast<i32>(random() % 64) - 32 + (random() % 1000 == 0 ? 1'000'000 : 0);
+        c = x;
+    }
+    vec<u32> values(VALUES);
+    for (u32& v : values) v = random() >> (random() % 32);
+
+    vec<u8> vbyte(bits::stream_vbyte_max_size(VALUES));
+    const size_t vbyte_size = bits::stream_vbyte_encode(values.data(), VALUES, vbyte.data());
+    vec<u8> deltas(bits::stream_vbyte_max_size(VALUES));
+    const size_t deltas_size = bits::stream_vbyte_encode_deltas(coordinates.data(), VALUES, deltas.data());
+    vec<u8> varints(VALUES * bits::VARINT_MAX_SIZE);
+    size_t varints_size = 0;
+    for (u32 i = 1; i < VALUES; i++) {
+        varints_size += bits::write_svarint(coordinates[i] - coordinates[i - 1], varints.data() + varints_size);
+    }
+
+    vec<u32> out(VALUES);
+    vec<i32> out_signed(VALUES);
+    vec<u64> out_wide(VALUES);
+    decode("stream vbyte", [&]() {
+        bits::stream_vbyte_decode(vbyte.data(), vbyte_size, VALUES, out.data());
+        bench::keep(out[VALUES - 1]);
+    });
+    decode("stream vbyte deltas", [&]() {
+        bits::stream_vbyte_decode_deltas(deltas.data(), deltas_size, VALUES, out_signed.data());
+        bench::keep(out_signed[VALUES - 1]);
+    });
+    decode("varint deltas (bulk)", [&]() {
+        bits::read_varints(varints.data(), varints_size, out_wide.data(), VALUES - 1);
+        bench::keep(out_wide[VALUES - 2]);
+    });
+
+    bits::packed_vector packed{ 12, VALUES };
+    for (u32 i = 0; i < VALUES; i++) packed.set(i, values[i] & 0xFFF);
+    decode("packed vector 12 bits unpack", [&]() {
+        packed.unpack(0, VALUES, out.data());
+        bench::keep(out[VALUES - 1]);
+    });
+
+    bits::bitset flags{ VALUES * 32 };
+    for (u32 i = 0; i < VALUES; i++) flags.assign(i * 32 + i % 32, true);
+    decode("bitset popcount", [&]() {
+        bench::keep(flags.count());
+    });
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <thread>
+#include "bench.h"
+#include "../include/utils/memory.h"
+#include "../include/utils/complex/collections.h"
+
+constexpr u32 ALLOCATIONS_PER_THREAD = 2'000'000;
+constexpr u32 SIZE = 48;
+
+template <typename F>
+f64 run_threads(const u32 threads_count, const F& work) {
+    return bench::measure([&]() {
+        vec<std::thread> threads{};
+        for (u32 t = 0; t < threads_count; t++) threads.emplace_back(work);
+        for (auto& thread : threads) thread.join();
+    });
+}
+
+int main() {
+    const u32 max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    allocator::concurrent_arena arena{};
+    if (allocator::concurrent_arena::create(u64{ max_threads } * ALLOCATIONS_PER_THREAD * SIZE * 2, &arena)
+            != allocator::concurrent_arena::status::SUCCESS) {
+        printf("failed to create the arena\n");
+        return 1;
+    }
+
+    vec<u32> counts{};
+    for (u32 threads = 1; threads < max_threads; threads *= 2) counts.emplace_back(threads);
+    counts.emplace_back(max_threads);
+
+    for (const u32 threads : counts) {
+        char name[64]{};
+
+        arena.reset();
+        const f64 arena_seconds = run_threads(threads, [&]() {
+            allocator::concurrent_arena::local local{ arena };
+            for (u32 i = 0; i < ALLOCATIONS_PER_THREAD; i++) bench::keep(local.allocate<u8>(SIZE));
+        });
+        snprintf(name, sizeof(name), "concurrent_arena %u threads", threads);
+        bench::report(name, u64{ threads } * ALLOCATIONS_PER_THREAD, arena_seconds);
+
+        const f64 malloc_seconds = run_threads(threads, [&]() {
+            vec<void*> blocks(ALLOCATIONS_PER_THREAD);
+            for (auto& block : blocks) block = std::malloc(SIZE);
+            for (void* block : blocks) std::free(block);
+        });
+        snprintf(name, sizeof(name), "malloc + free %u threads", threads);
+        bench::report(name, u64{ threads } * ALLOCATIONS_PER_THREAD, malloc_seconds);
+    }
+    return 0;
+}
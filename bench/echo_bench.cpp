@@ -0,0 +1,148 @@
+#include <thread>
+#include <string>
+#include "bench.h"
+#include "../include/utils/proto.h"
+
+using namespace sys::socket;
+using namespace std::chrono_literals;
+
+// Messages which every client keeps in flight
+constexpr u32 DEPTH = 8;
+constexpr auto DURATION = 1s;
+
+static u64 now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(bench::clock::now().time_since_epoch()).count();
+}
+
+// Handles everything that was received, the buffer can be full so it's done until the socket is drained
+template <typename F>
+static void drain(proto1::connection& c, const F& on_message) {
+    while (true) {
+        c.poll();
+        proto1::message m{};
+        while (c.read_message(&m) == sys::status::SUCCESS) on_message(m);
+        const bool was_full = c.socket.incoming_buffer.writable() == 0;
+        c.clear_message();
+        if (!was_full) break;
+    }
+    c.flush();
+}
+
+/**
+ * Sends every message back on a separate thread
+ */
+struct echo_server {
+    sys::event_loop loop{};
+    tcp_acceptor acceptor{};
+    vec<uptr<proto1::connection>> connections{};
+    std::thread thread{};
+
+    void start() {
+        sys::event_loop::create(&loop);
+        tcp_acceptor::listen("127.0.0.1", 0, &acceptor);
+        loop.add(acceptor, [this](u32) {
+            tcp_socket socket{};
+            while (acceptor.accept(1 * MB, &socket) == sys::status::SUCCESS) {
+                proto1::connection* const c = connections.emplace_back(new proto1::connection{ std::move(socket) }).get();
+                loop.add(c->socket, [c](const u32 events) {
+                    if (events & sys::event_loop::READABLE) {
+                        drain(*c, [c](const proto1::message& m) { c->write_message(m.type, m.data, m.size, m.id); });
+                    }
+                    if (events & sys::event_loop::WRITABLE) c->flush();
+                });
+                socket = tcp_socket{};
+            }
+        });
+        thread = std::thread([this]() { loop.run(); });
+    }
+
+    void stop() {
+        loop.stop();
+        thread.join();
+        for (const uptr<proto1::connection>& c : connections) loop.remove(c->socket);
+        loop.remove(acceptor);
+    }
+};
+
+struct client {
+    uptr<proto1::connection> connection{};
+    u32 in_flight = 0;
+    u64 next_id = 0;
+};
+
+static void run(const size_t message_size, const u32 connections) {
+    echo_server server{};
+    server.start();
+
+    sys::event_loop loop{};
+    sys::event_loop::create(&loop);
+    vec<client> clients(connections);
+    for (client& c : clients) {
+        tcp_socket socket{};
+        tcp_socket::create("127.0.0.1", server.acceptor.port(), 1 * MB, &socket);
+        socket.finish_connect(-1);
+        c.connection.reset(new proto1::connection{ std::move(socket) });
+    }
+
+    // Every message starts with the time when it was sent
+    vec<u8> message(message_size, 7);
+    vec<u64> latencies{};
+    u64 received = 0;
+    bool sending = true;
+    const auto send = [&](client& c) {
+        const u64 sent_at = now_ns();
+        std::memcpy(message.data(), &sent_at, sizeof(sent_at));
+        c.connection->write_message(1, message.data(), message.size(), c.next_id++);
+        c.in_flight += 1;
+    };
+
+    for (client& c : clients) {
+        proto1::connection* const connection = c.connection.get();
+        client* const state = &c;
+        loop.add(connection->socket, [&, connection, state](const u32 events) {
+            if (events & sys::event_loop::READABLE) {
+                drain(*connection, [&](const proto1::message& m) {
+                    u64 sent_at = 0;
+                    std::memcpy(&sent_at, m.data, sizeof(sent_at));
+                    latencies.push_back(now_ns() - sent_at);
+                    received += 1;
+                    state->in_flight -= 1;
+                    if (sending) send(*state);
+                });
+            }
+            if (events & sys::event_loop::WRITABLE) connection->flush();
+        });
+    }
+
+    const auto start = bench::clock::now();
+    for (client& c : clients) {
+        for (u32 i = 0; i < DEPTH; i++) send(c);
+        c.connection->flush();
+    }
+    while (bench::clock::now() - start < DURATION) loop.run_once(10);
+    const f64 seconds = bench::seconds_since(start);
+    const u64 measured = received;
+
+    // Wait for the messages which are still in flight, so the server can be stopped safely
+    sending = false;
+    const auto in_flight = [&]() {
+        u32 total = 0;
+        for (const client& c : clients) total += c.in_flight;
+        return total;
+    };
+    while (in_flight() != 0 && bench::clock::now() - start < DURATION + 1s) loop.run_once(10);
+    for (const client& c : clients) loop.remove(c.connection->socket);
+    server.stop();
+
+    const std::string name = std::to_string(message_size) + " B x " + std::to_string(connections) + " conn";
+    printf("%-48s %12.0f msgs/s %10.2f MB/s\n", name.c_str(), measured / seconds, measured * message_size / seconds / 1e6);
+    bench::report_latency("", latencies);
+}
+
+int main() {
+    printf("Echo over 127.0.0.1, %u messages in flight per connection\n", DEPTH);
+    for (const size_t size : { size_t{ 16 }, size_t{ 256 }, size_t{ 4 * KB }, size_t{ 64 * KB } }) {
+        for (const u32 connections : { 1u, 8u, 64u }) run(size, connections);
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include <random>
+#include <thread>
+#include <algorithm>
+#include "bench.h"
+#include "../include/utils/memory.h"
+#include "../include/utils/complex/collections.h"
+
+constexpr u32 BLOCK_SIZE = 64;
+constexpr u32 BLOCKS = 1'000'000;
+
+struct malloc_allocator {
+    void* allocate() { return std::malloc(BLOCK_SIZE); }
+    void free(void* pointer) { std::free(pointer); }
+};
+
+struct pool_allocator {
+    allocator::pool pool{ BLOCK_SIZE };
+    void* allocate() { void* p = nullptr; pool.allocate(&p); return p; }
+    void free(void* pointer) { pool.free(pointer); }
+};
+
+struct cache_allocator {
+    allocator::pool pool{ BLOCK_SIZE };
+    allocator::pool::cache cache{ pool };
+    void* allocate() { void* p = nullptr; cache.allocate(&p); return p; }
+    void free(void* pointer) { cache.free(pointer); }
+};
+
+// Allocate everything, then free in random order (like rebuilding a tree)
+template <typename A>
+void allocate_then_free_shuffled(const char* const name) {
+    A a{};
+    vec<void*> blocks(BLOCKS);
+    std::mt19937 random{ 1 };
+    const f64 seconds = bench::measure([&]() {
+        for (auto& block : blocks) block = a.allocate();
+        std::shuffle(blocks.begin(), blocks.end(), random);
+        for (void* block : blocks) a.free(block);
+    });
+    bench::report(name, 2 * BLOCKS, seconds);
+}
+
+// Keep a working set and replace random elements (like per-connection objects)
+template <typename A>
+void churn(const char* const name) {
+    A a{};
+    vec<void*> blocks(16 * KB);
+    for (auto& block : blocks) block = a.allocate();
+    std::mt19937 random{ 2 };
+    const f64 seconds = bench::measure([&]() {
+        for (u32 i = 0; i < BLOCKS; i++) {
+            const u32 id = random() % blocks.size();
+            a.free(blocks[id]);
+            blocks[id] = a.allocate();
+            bench::keep(blocks[id]);
+        }
+    });
+    for (void* block : blocks) a.free(block);
+    bench::report(name, 2 * BLOCKS, seconds);
+}
+
+// One thread allocates, another one frees
+void cross_thread_pool() {
+    allocator::pool pool{ BLOCK_SIZE };
+    vec<void*> blocks(BLOCKS);
+    const f64 seconds = bench::measure([&]() {
+        std::thread producer([&]() {
+            allocator::pool::cache cache{ pool };
+            for (auto& block : blocks) cache.allocate(&block);
+        });
+        producer.join();
+        std::thread consumer([&]() {
+            for (void* block : blocks) pool.free(block);
+        });
+        consumer.join();
+    });
+    bench::report("pool cross thread (cache + remote free)", 2 * BLOCKS, seconds);
+}
+
+void cross_thread_malloc() {
+    vec<void*> blocks(BLOCKS);
+    const f64 seconds = bench::measure([&]() {
+        std::thread producer([&]() { for (auto& block : blocks) block = std::malloc(BLOCK_SIZE); });
+        producer.join();
+        std::thread consumer([&]() { for (void* block : blocks) std::free(block); });
+        consumer.join();
+    });
+    bench::report("malloc cross thread", 2 * BLOCKS, seconds);
+}
+
+int main() {
+    allocate_then_free_shuffled<malloc_allocator>("malloc allocate all, free shuffled");
+    allocate_then_free_shuffled<pool_allocator>("pool allocate all, free shuffled");
+    allocate_then_free_shuffled<cache_allocator>("pool cache allocate all, free shuffled");
+    churn<malloc_allocator>("malloc churn");
+    churn<pool_allocator>("pool churn");
+    churn<cache_allocator>("pool cache churn");
+    cross_thread_malloc();
+    cross_thread_pool();
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include <thread>
+#include <string>
+#include "bench.h"
+#include "../include/utils/system.h"
+
+using namespace sys::socket;
+
+constexpr size_t TOTAL = 1 * GB;
+
+static void wait_for(const fd_t fd, const i16 events) {
+    pollfd descriptor{ .fd = fd, .events = events, .revents = 0 };
+    ::poll(&descriptor, 1, 100);
+}
+
+// Receives everything on a separate thread, so the sender measures the write path
+static void receive(tcp_socket& server, const size_t total) {
+    size_t received = 0;
+    while (received < total) {
+        wait_for(server.socket_fd, POLLIN);
+        server.poll();
+        u8* data = nullptr;
+        const size_t size = server.read(&data);
+        received += size;
+        server.clear(size);
+    }
+}
+
+template <typename W>
+static void run(const char* const name, const size_t message_size, const bool zerocopy, const W& write) {
+    tcp_acceptor acceptor{};
+    tcp_socket client{}, server{};
+    tcp_acceptor::listen("127.0.0.1", 0, &acceptor);
+    tcp_socket::create("127.0.0.1", acceptor.port(), 1 * MB, &client);
+    client.finish_connect(-1);
+    while (acceptor.accept(1 * MB, &server) == sys::status::WOULD_BLOCK) wait_for(acceptor.socket_fd, POLLIN);
+    if (zerocopy && client.enable_zerocopy() != sys::status::SUCCESS) {
+        printf("%-48s not supported\n", name);
+        return;
+    }
+
+    const vec<u8> message(message_size, 7);
+    const size_t messages = TOTAL / message_size;
+    u64 syscalls = 0;
+    std::thread receiver(receive, std::ref(server), messages * message_size);
+    const f64 seconds = bench::measure([&]() {
+        // Queue a batch of messages, then flush them together
+        const size_t batch = std::max<size_t>(1, 256 * KB / message_size);
+        vec<u64> completed{};
+        for (size_t sent = 0; sent < messages; sent += batch) {
+            for (size_t i = sent; i < std::min(messages, sent + batch); i++) write(client, message, i);
+            while (client.outgoing_buffer.flush(client.socket_fd, &syscalls) == sys::status::WOULD_BLOCK) {
+                wait_for(client.socket_fd, POLLOUT);
+            }
+            client.completed(&completed);
+        }
+    });
+    receiver.join();
+
+    bench::report_throughput(name, messages * message_size, seconds);
+    printf("%-48s %12.2f messages/syscall\n", "", static_cast<f64>(messages) / syscalls);
+}
+
+int main() {
+    const auto copy = [](tcp_socket& socket, const vec<u8>& message, size_t) {
+        socket.write(message.data(), message.size());
+    };
+    const auto reference = [](tcp_socket& socket, const vec<u8>& message, const size_t id) {
+        socket.write_zerocopy(message.data(), message.size(), id);
+    };
+
+    for (const size_t size : { size_t{ 64 }, size_t{ 4 * KB }, size_t{ 64 * KB }, size_t{ 1 * MB } }) {
+        const std::string suffix = " " + std::to_string(size) + " B";
+        run(("copy" + suffix).c_str(), size, false, copy);
+        run(("referenced" + suffix).c_str(), size, false, reference);
+        if (size >= 64 * KB) run(("zerocopy" + suffix).c_str(), size, true, reference);
+    }
+    return 0;
+}
@@ -0,0 +1,554 @@
+#ifndef UTILITIES_ASYNC_H
+#define UTILITIES_ASYNC_H
+
+#include <atomic>
+#include <cerrno>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include "complex/collections.h"
+#include "types.h"
+#include "markers.h"
+#include "system.h"
+
+#ifdef POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(POSIX) && defined(__linux__)
+#define UTILITIES_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+/**
+ * Asynchronous file operations. Requests are queued and submitted in batches,
+ * completions are collected later, so many files can be opened and read at once.
+ * Backed by io_uring on Linux, otherwise by a pool of threads doing regular syscalls.
+ */
+namespace sys::async {
+
+    enum struct operation {
+        // Opens file at "path" for reading, result is the file descriptor
+        OPEN,
+        // Gets size of the file at "path", result is the size in bytes
+        STAT,
+        // Reads "size" bytes at "offset" from "fd" into "buffer", result is amount of bytes read
+        READ,
+        // Closes "fd"
+        CLOSE,
+    };
+
+    struct request {
+        operation op = operation::OPEN;
+        // Returned back in the completion
+        u64 user_data = 0;
+        // Should stay alive until the completion is received
+        const char* path = nullptr;
+        fd_t fd = -1;
+        void* buffer = nullptr;
+        u32 size = 0;
+        u64 offset = 0;
+    };
+
+    struct completion {
+        u64 user_data = 0;
+        operation op = operation::OPEN;
+        // Result of the operation or -errno if it failed
+        i64 result = 0;
+    };
+
+    enum struct backend {
+        // io_uring if it's available, threads otherwise
+        AUTO,
+        IO_URING,
+        THREADS,
+    };
+
+    static status error_status(const i64 result) {
+        #ifdef POSIX
+        switch (-result) {
+            case EACCES: return status::ACCESS_DENIED;
+            case ENOENT: return status::FILE_NOT_FOUND;
+        }
+        #endif
+        return status::UNKNOWN_ERROR;
+    }
+
+    /**
+     * Queue of asynchronous file operations with limited amount of operations in flight.
+     * Not thread-safe, should be used from one thread.
+     */
+    struct file_queue {
+    private:
+
+        struct slot {
+            u64 user_data = 0;
+            operation op = operation::OPEN;
+            #ifdef UTILITIES_IO_URING
+            struct statx stat{};
+            #endif
+        };
+
+        u32 depth_ = 0;
+        vec<slot> slots_{};
+        vec<u32> free_slots_{};
+        bool uring_ = false;
+
+        #ifdef UTILITIES_IO_URING
+        fd_t ring_fd_ = -1;
+        void* sq_ring_ = nullptr;
+        size_t sq_ring_size_ = 0;
+        void* cq_ring_ = nullptr;
+        size_t cq_ring_size_ = 0;
+        io_uring_sqe* sqes_ = nullptr;
+        size_t sqes_size_ = 0;
+        u32* sq_tail_ = nullptr;
+        u32* sq_mask_ = nullptr;
+        u32* sq_array_ = nullptr;
+        u32* cq_head_ = nullptr;
+        u32* cq_tail_ = nullptr;
+        u32* cq_mask_ = nullptr;
+        io_uring_cqe* cqes_ = nullptr;
+        // Entries written into the submission ring but not passed to the kernel yet
+        u32 unsubmitted_ = 0;
+        #endif
+
+        // Thread pool backend
+        std::mutex mutex_{};
+        std::condition_variable requests_ready_{};
+        std::condition_variable completions_ready_{};
+        std::deque<pair<u32, request>> requests_{};
+        std::deque<pair<u32, i64>> completions_{};
+        vec<pair<u32, request>> pending_{};
+        vec<std::thread> workers_{};
+        bool stop_ = false;
+
+    public:
+
+        file_queue() {}
+
+        file_queue(const file_queue&) =delete;
+        file_queue& operator=(const file_queue&) =delete;
+
+        /**
+         * Creates the queue
+         *
+         * @param depth maximum amount of operations in flight
+         * @param result queue to initialize (should not be initialized already)
+         * @param b which backend to use
+         * @param threads amount of threads for the thread pool backend
+         * @return status of the operation
+         */
+        static status create(IN const u32 depth, OUT file_queue* const result, IN const backend b = backend::AUTO, IN const u32 threads = 4) {
+            if (depth == 0) return status::INVALID_ARGUMENT;
+            result->depth_ = depth;
+            result->slots_.resize(depth);
+            result->free_slots_.reserve(depth);
+            for (u32 i = depth; i > 0; i--) result->free_slots_.emplace_back(i - 1);
+
+            if (b != backend::THREADS) {
+                #ifdef UTILITIES_IO_URING
+                if (result->setup_uring_()) {
+                    result->uring_ = true;
+                    return status::SUCCESS;
+                }
+                #endif
+                if (b == backend::IO_URING) return status::NOT_IMPLEMENTED;
+            }
+
+            #ifdef POSIX
+            for (u32 i = 0; i < std::max(threads, 1u); i++) {
+                result->workers_.emplace_back([result]() { result->work_(); });
+            }
+            return status::SUCCESS;
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        bool uses_io_uring() const {
+            return uring_;
+        }
+
+        // Amount of operations which were pushed but not completed yet
+        u32 in_flight() const {
+            return depth_ - free_slots_.size();
+        }
+
+        u32 capacity() const {
+            return depth_;
+        }
+
+        /**
+         * Queues the request. It's not sent anywhere until submit() is called.
+         *
+         * @param r request
+         * @return NOT_ENOUGH_SPACE if there are already "depth" operations in flight
+         */
+        status push(const request& r) {
+            if (free_slots_.empty()) return status::NOT_ENOUGH_SPACE;
+            const u32 id = free_slots_.back();
+            free_slots_.pop_back();
+            slots_[id].user_data = r.user_data;
+            slots_[id].op = r.op;
+
+            #ifdef UTILITIES_IO_URING
+            if (uring_) {
+                prepare_sqe_(id, r);
+                return status::SUCCESS;
+            }
+            #endif
+            pending_.emplace_back(id, r);
+            return status::SUCCESS;
+        }
+
+        /**
+         * Starts all queued requests with as few syscalls as possible
+         *
+         * @return status of the operation
+         */
+        status submit() {
+            #ifdef UTILITIES_IO_URING
+            if (uring_) return enter_(0);
+            #endif
+            if (pending_.empty()) return status::SUCCESS;
+            {
+                std::lock_guard<std::mutex> lock{ mutex_ };
+                requests_.insert(requests_.end(), pending_.begin(), pending_.end());
+            }
+            pending_.clear();
+            requests_ready_.notify_all();
+            return status::SUCCESS;
+        }
+
+        /**
+         * Collects completed operations. Submits queued requests first.
+         *
+         * @param out array for completions
+         * @param max size of the array
+         * @param min minimum amount of completions to wait for
+         * @return amount of completions written into the array
+         */
+        u32 wait(OUT completion* const out, const u32 max, u32 min = 1) {
+            min = std::min({ min, max, in_flight() });
+            if (submit() != status::SUCCESS) return 0;
+
+            u32 collected = 0;
+            #ifdef UTILITIES_IO_URING
+            if (uring_) {
+                while (true) {
+                    collected += reap_(out + collected, max - collected);
+                    if (collected >= min) return collected;
+                    if (enter_(min - collected) != status::SUCCESS) return collected;
+                }
+            }
+            #endif
+
+            std::unique_lock<std::mutex> lock{ mutex_ };
+            completions_ready_.wait(lock, [&]() { return completions_.size() >= min; });
+            while (collected < max && !completions_.empty()) {
+                const auto [id, result] = completions_.front();
+                completions_.pop_front();
+                out[collected++] = finish_(id, result);
+            }
+            return collected;
+        }
+
+        ~file_queue() {
+            {
+                std::lock_guard<std::mutex> lock{ mutex_ };
+                stop_ = true;
+            }
+            requests_ready_.notify_all();
+            for (auto& worker : workers_) worker.join();
+
+            #ifdef UTILITIES_IO_URING
+            if (sqes_ != nullptr) munmap(sqes_, sqes_size_);
+            if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+            if (sq_ring_ != nullptr) munmap(sq_ring_, sq_ring_size_);
+            if (ring_fd_ != -1) close(ring_fd_);
+            #endif
+        }
+
+    private:
+
+        completion finish_(const u32 id, const i64 result) {
+            const slot& s = slots_[id];
+            completion c{ .user_data = s.user_data, .op = s.op, .result = result };
+            #ifdef UTILITIES_IO_URING
+            if (uring_ && s.op == operation::STAT && result >= 0) c.result = s.stat.stx_size;
+            #endif
+            free_slots_.emplace_back(id);
+            return c;
+        }
+
+        static i64 execute_(const request& r) {
+            #ifdef POSIX
+            i64 result = 0;
+            switch (r.op) {
+                case operation::OPEN:
+                    result = open(r.path, O_RDONLY | O_CLOEXEC);
+                    break;
+                case operation::STAT: {
+                    struct stat stat_buf{};
+                    result = stat(r.path, &stat_buf);
+                    if (result == 0) result = stat_buf.st_size;
+                    break;
+                }
+                case operation::READ:
+                    result = pread(r.fd, r.buffer, r.size, r.offset);
+                    break;
+                case operation::CLOSE:
+                    result = close(r.fd);
+                    break;
+            }
+            return result < 0 ? -errno : result;
+            #else
+            return -1;
+            #endif
+        }
+
+        void work_() {
+            while (true) {
+                pair<u32, request> item{};
+                {
+                    std::unique_lock<std::mutex> lock{ mutex_ };
+                    requests_ready_.wait(lock, [&]() { return stop_ || !requests_.empty(); });
+                    if (stop_) return;
+                    item = requests_.front();
+                    requests_.pop_front();
+                }
+                const i64 result = execute_(item.second);
+                {
+                    std::lock_guard<std::mutex> lock{ mutex_ };
+                    completions_.emplace_back(item.first, result);
+                }
+                completions_ready_.notify_one();
+            }
+        }
+
+        #ifdef UTILITIES_IO_URING
+
+        bool setup_uring_() {
+            io_uring_params params{};
+            params.flags = IORING_SETUP_CLAMP;
+            // Completion ring is bigger than the amount of operations in flight, so it never overflows
+            params.flags |= IORING_SETUP_CQSIZE;
+            params.cq_entries = 2 * depth_;
+            const i32 fd = static_cast<i32>(syscall(__NR_io_uring_setup, depth_, &params));
+            if (fd < 0) return false;
+            ring_fd_ = fd;
+            if (params.sq_entries < depth_) return false;
+
+            sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(u32);
+            cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (single_mmap) sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+
+            sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            if (sq_ring_ == MAP_FAILED) { sq_ring_ = nullptr; return false; }
+            if (single_mmap) {
+                cq_ring_ = sq_ring_;
+            } else {
+                cq_ring_ = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+                if (cq_ring_ == MAP_FAILED) { cq_ring_ = nullptr; return false; }
+            }
+            sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+            void* const sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+            if (sqes == MAP_FAILED) return false;
+            sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+            u8* const sq = static_cast<u8*>(sq_ring_);
+            u8* const cq = static_cast<u8*>(cq_ring_);
+            sq_tail_ = reinterpret_cast<u32*>(sq + params.sq_off.tail);
+            sq_mask_ = reinterpret_cast<u32*>(sq + params.sq_off.ring_mask);
+            sq_array_ = reinterpret_cast<u32*>(sq + params.sq_off.array);
+            cq_head_ = reinterpret_cast<u32*>(cq + params.cq_off.head);
+            cq_tail_ = reinterpret_cast<u32*>(cq + params.cq_off.tail);
+            cq_mask_ = reinterpret_cast<u32*>(cq + params.cq_off.ring_mask);
+            cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            return true;
+        }
+
+        void prepare_sqe_(const u32 id, const request& r) {
+            // Only this thread writes the tail, so a plain read is enough
+            const u32 tail = *sq_tail_;
+            const u32 index = tail & *sq_mask_;
+            io_uring_sqe& sqe = sqes_[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.user_data = id;
+
+            switch (r.op) {
+                case operation::OPEN:
+                    sqe.opcode = IORING_OP_OPENAT;
+                    sqe.fd = AT_FDCWD;
+                    sqe.addr = reinterpret_cast<u64>(r.path);
+                    sqe.open_flags = O_RDONLY | O_CLOEXEC;
+                    break;
+                case operation::STAT:
+                    sqe.opcode = IORING_OP_STATX;
+                    sqe.fd = AT_FDCWD;
+                    sqe.addr = reinterpret_cast<u64>(r.path);
+                    sqe.len = STATX_SIZE;
+                    sqe.off = reinterpret_cast<u64>(&slots_[id].stat);
+                    break;
+                case operation::READ:
+                    sqe.opcode = IORING_OP_READ;
+                    sqe.fd = r.fd;
+                    sqe.addr = reinterpret_cast<u64>(r.buffer);
+                    sqe.len = r.size;
+                    sqe.off = r.offset;
+                    break;
+                case operation::CLOSE:
+                    sqe.opcode = IORING_OP_CLOSE;
+                    sqe.fd = r.fd;
+                    break;
+            }
+
+            sq_array_[index] = index;
+            std::atomic_ref<u32>{ *sq_tail_ }.store(tail + 1, std::memory_order_release);
+            unsubmitted_ += 1;
+        }
+
+        status enter_(const u32 min_complete) {
+            if (unsubmitted_ == 0 && min_complete == 0) return status::SUCCESS;
+            while (true) {
+                const u32 flags = min_complete != 0 ? IORING_ENTER_GETEVENTS : 0;
+                const i64 r = syscall(__NR_io_uring_enter, ring_fd_, unsubmitted_, min_complete, flags, nullptr, 0);
+                if (r >= 0) {
+                    unsubmitted_ -= std::min<u32>(unsubmitted_, static_cast<u32>(r));
+                    return status::SUCCESS;
+                }
+                if (errno != EINTR) return status::UNKNOWN_ERROR;
+            }
+        }
+
+        u32 reap_(OUT completion* const out, const u32 max) {
+            u32 head = *cq_head_;
+            const u32 tail = std::atomic_ref<u32>{ *cq_tail_ }.load(std::memory_order_acquire);
+            u32 collected = 0;
+            while (head != tail && collected < max) {
+                const io_uring_cqe& cqe = cqes_[head & *cq_mask_];
+                out[collected++] = finish_(static_cast<u32>(cqe.user_data), cqe.res);
+                head++;
+            }
+            std::atomic_ref<u32>{ *cq_head_ }.store(head, std::memory_order_release);
+            return collected;
+        }
+
+        #endif
+    };
+
+    /**
+     * Reads many whole files at once. All files are opened and their sizes requested
+     * together, reads are started as soon as both are known, so the system always
+     * has up to "depth" operations to work on.
+     *
+     * @param paths paths to the files
+     * @param contents content of every file (empty if reading has failed)
+     * @param statuses status of every file
+     * @param depth maximum amount of operations in flight
+     * @param b which backend to use
+     * @return status of the whole operation (not of individual files)
+     */
+    static status read_files(IN const vec<str>& paths,
+                             OUT vec<vec<u8>>* const contents,
+                             OUT vec<status>* const statuses,
+                             IN const u32 depth = 64,
+                             IN const backend b = backend::AUTO) {
+        struct file {
+            fd_t fd = -1;
+            i64 size = -1;
+            u64 read = 0;
+            bool failed = false;
+        };
+
+        file_queue queue{};
+        const status create_status = file_queue::create(std::max(depth, 2u), &queue, b);
+        if (create_status != status::SUCCESS) return create_status;
+
+        contents->assign(paths.size(), {});
+        statuses->assign(paths.size(), status::SUCCESS);
+        vec<file> files(paths.size());
+        // Requests which didn't fit into the queue yet
+        std::deque<request> backlog{};
+        for (u64 i = 0; i < paths.size(); i++) {
+            backlog.push_back({ .op = operation::OPEN, .user_data = i, .path = paths[i].c_str() });
+            backlog.push_back({ .op = operation::STAT, .user_data = i, .path = paths[i].c_str() });
+        }
+
+        const auto fail = [&](const u64 id, const i64 result) {
+            if (!files[id].failed) (*statuses)[id] = error_status(result);
+            files[id].failed = true;
+            (*contents)[id].clear();
+        };
+
+        const auto continue_file = [&](const u64 id) {
+            file& f = files[id];
+            if (f.fd < 0 || f.size < 0) {
+                // Something has failed, but the file could be opened anyway
+                if (f.failed && f.fd >= 0) backlog.push_front({ .op = operation::CLOSE, .user_data = id, .fd = f.fd });
+                return;
+            }
+            auto& data = (*contents)[id];
+            if (f.read < static_cast<u64>(f.size) && !f.failed) {
+                const u64 left = f.size - f.read;
+                backlog.push_front({ .op = operation::READ, .user_data = id, .fd = f.fd,
+                                     .buffer = data.data() + f.read,
+                                     .size = static_cast<u32>(std::min<u64>(left, 1 * GB)),
+                                     .offset = f.read });
+            } else {
+                backlog.push_front({ .op = operation::CLOSE, .user_data = id, .fd = f.fd });
+            }
+        };
+
+        vec<completion> completions(queue.capacity());
+        while (!backlog.empty() || queue.in_flight() != 0) {
+            while (!backlog.empty() && queue.push(backlog.front()) == status::SUCCESS) backlog.pop_front();
+
+            const u32 collected = queue.wait(completions.data(), completions.size(), 1);
+            for (u32 i = 0; i < collected; i++) {
+                const completion& c = completions[i];
+                const u64 id = c.user_data;
+                file& f = files[id];
+                switch (c.op) {
+                    case operation::OPEN:
+                        if (c.result < 0) { fail(id, c.result); break; }
+                        f.fd = static_cast<fd_t>(c.result);
+                        if (f.size >= 0 || f.failed) continue_file(id);
+                        break;
+                    case operation::STAT:
+                        if (c.result < 0) {
+                            fail(id, c.result);
+                            if (f.fd >= 0) continue_file(id);
+                            break;
+                        }
+                        f.size = c.result;
+                        if (!f.failed) (*contents)[id].resize(f.size);
+                        if (f.fd >= 0) continue_file(id);
+                        break;
+                    case operation::READ:
+                        if (c.result <= 0) {
+                            fail(id, c.result == 0 ? -EIO : c.result);
+                            backlog.push_front({ .op = operation::CLOSE, .user_data = id, .fd = f.fd });
+                            break;
+                        }
+                        f.read += c.result;
+                        continue_file(id);
+                        break;
+                    case operation::CLOSE:
+                        f.fd = -1;
+                        break;
+                }
+            }
+        }
+        return status::SUCCESS;
+    }
+
+}
+
+#endif //UTILITIES_ASYNC_H
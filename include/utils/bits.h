@@ -5,8 +5,19 @@
 #ifndef UTILITIES_BITS_H
 #define UTILITIES_BITS_H
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <bit>
+#include <type_traits>
+#include <array>
+#include <utility>
 #include "types.h"
+#include "complex/collections.h"
+
+#if defined(__SSSE3__) || defined(__BMI2__)
+#include <immintrin.h>
+#endif
 
 namespace bits {
 
@@ -60,6 +71,872 @@ namespace bits {
             else out << "0";
         }
     }
+
+    /**
+     * Reverses order of bytes of the integer
+     *
+     * @param value integer value
+     * @return value with reversed bytes
+     */
+    template <typename T>
+    T byte_swap(const T value) {
+        static_assert(std::is_integral_v<T>, "only integers can be swapped");
+        auto bytes = std::bit_cast<std::array<u8, sizeof(T)>>(value);
+        for (size_t i = 0; i < sizeof(T) / 2; i++) std::swap(bytes[i], bytes[sizeof(T) - 1 - i]);
+        return std::bit_cast<T>(bytes);
+    }
+
+    /**
+     * Reads a little-endian value from unaligned memory
+     *
+     * @tparam T arithmetic type
+     * @param data pointer to the value
+     * @return value in the native byte order
+     */
+    template <typename T>
+    T load_le(const u8* const data) {
+        static_assert(std::is_arithmetic_v<T>, "only numbers have a byte order");
+        if constexpr (std::endian::native == std::endian::little || sizeof(T) == 1) {
+            T value;
+            std::memcpy(&value, data, sizeof(T));
+            return value;
+        } else {
+            using U = std::conditional_t<sizeof(T) == 8, u64, std::conditional_t<sizeof(T) == 4, u32, u16>>;
+            U raw;
+            std::memcpy(&raw, data, sizeof(T));
+            return std::bit_cast<T>(byte_swap(raw));
+        }
+    }
+
+    /**
+     * Writes the value in little-endian byte order to unaligned memory
+     *
+     * @tparam T arithmetic type
+     * @param value value in the native byte order
+     * @param out output
+     */
+    template <typename T>
+    void store_le(const T value, u8* const out) {
+        static_assert(std::is_arithmetic_v<T>, "only numbers have a byte order");
+        if constexpr (std::endian::native == std::endian::little || sizeof(T) == 1) {
+            std::memcpy(out, &value, sizeof(T));
+        } else {
+            using U = std::conditional_t<sizeof(T) == 8, u64, std::conditional_t<sizeof(T) == 4, u32, u16>>;
+            const U raw = byte_swap(std::bit_cast<U>(value));
+            std::memcpy(out, &raw, sizeof(T));
+        }
+    }
+
+    // Maximum size of a 64 bit value encoded as varint
+    constexpr size_t VARINT_MAX_SIZE = 10;
+
+    /**
+     * @param value value to encode
+     * @return amount of bytes required to encode the value as varint
+     */
+    static size_t varint_size(u64 value) {
+        size_t size = 1;
+        while (value >= HIGH_1BIT) {
+            value >>= 7;
+            size += 1;
+        }
+        return size;
+    }
+
+    /**
+     * Encodes the value as varint (unsigned LEB128): 7 bits per byte starting from the
+     * lowest ones, high bit of the byte is set if more bytes follow.
+     *
+     * @param value value to encode
+     * @param out output buffer (at least VARINT_MAX_SIZE bytes or varint_size(value))
+     * @return amount of written bytes
+     */
+    static size_t write_varint(u64 value, u8* const out) {
+        size_t size = 0;
+        while (value >= HIGH_1BIT) {
+            out[size++] = static_cast<u8>(value) | HIGH_1BIT;
+            value >>= 7;
+        }
+        out[size++] = static_cast<u8>(value);
+        return size;
+    }
+
+    /**
+     * Decodes varint written by write_varint()
+     *
+     * @param data encoded bytes
+     * @param size amount of available bytes
+     * @param value decoded value
+     * @return amount of read bytes, 0 if the value is incomplete (or malformed if size >= VARINT_MAX_SIZE)
+     */
+    static size_t read_varint(const u8* const data, const size_t size, u64* const value) {
+        // Single byte values are the most common
+        if (size != 0 && data[0] < HIGH_1BIT) {
+            *value = data[0];
+            return 1;
+        }
+        u64 result = 0;
+        const size_t limit = size < VARINT_MAX_SIZE ? size : VARINT_MAX_SIZE;
+        for (size_t i = 0; i < limit; i++) {
+            result |= static_cast<u64>(data[i] & 0x7F) << (7 * i);
+            if ((data[i] & HIGH_1BIT) == 0) {
+                *value = result;
+                return i + 1;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * Maps signed values to unsigned ones so small negative values stay small: 0, -1, 1, -2, 2...
+     * become 0, 1, 2, 3, 4...
+     *
+     * @param value signed value
+     * @return encoded value
+     */
+    static u64 zigzag_encode(const i64 value) {
+        return (static_cast<u64>(value) << 1) ^ static_cast<u64>(value >> 63);
+    }
+
+    static i64 zigzag_decode(const u64 value) {
+        return static_cast<i64>(value >> 1) ^ -static_cast<i64>(value & 1);
+    }
+
+    static u32 zigzag_encode32(const i32 value) {
+        return (static_cast<u32>(value) << 1) ^ static_cast<u32>(value >> 31);
+    }
+
+    static i32 zigzag_decode32(const u32 value) {
+        return static_cast<i32>(value >> 1) ^ -static_cast<i32>(value & 1);
+    }
+
+    /**
+     * Encodes the signed value as zigzag varint
+     *
+     * @param value value to encode
+     * @param out output buffer (at least VARINT_MAX_SIZE bytes)
+     * @return amount of written bytes
+     */
+    static size_t write_svarint(const i64 value, u8* const out) {
+        return write_varint(zigzag_encode(value), out);
+    }
+
+    /**
+     * Decodes the value written by write_svarint()
+     *
+     * @return amount of read bytes, 0 if the value is incomplete
+     */
+    static size_t read_svarint(const u8* const data, const size_t size, i64* const value) {
+        u64 encoded = 0;
+        const size_t read = read_varint(data, size, &encoded);
+        if (read != 0) *value = zigzag_decode(encoded);
+        return read;
+    }
+
+    /**
+     * Decodes consecutive varints. When the next 8 bytes are all single byte values
+     * (high bits are clear) they are decoded at once.
+     *
+     * @param data encoded bytes
+     * @param size amount of available bytes
+     * @param values decoded values
+     * @param count amount of values to decode
+     * @return amount of read bytes, 0 if there are less than count values
+     */
+    static size_t read_varints(const u8* const data, const size_t size, u64* const values, const size_t count) {
+        constexpr u64 HIGH_BITS = 0x8080808080808080ull;
+        size_t position = 0;
+        size_t i = 0;
+        while (i < count) {
+            if (count - i >= 8 && size - position >= 8 && (load_le<u64>(data + position) & HIGH_BITS) == 0) {
+                for (size_t j = 0; j < 8; j++) values[i + j] = data[position + j];
+                position += 8;
+                i += 8;
+                continue;
+            }
+            const size_t read = read_varint(data + position, size - position, values + i);
+            if (read == 0) return 0;
+            position += read;
+            i += 1;
+        }
+        return position;
+    }
+
+    /**
+     * Writes values of any width (up to 56 bits at a time) into a byte buffer,
+     * starting from the lowest bits of the first byte
+     */
+    struct bit_writer {
+    private:
+        vec<u8>* out_ = nullptr;
+        u64 buffer_ = 0;
+        u32 used_ = 0;
+        size_t written_ = 0;
+
+    public:
+
+        explicit bit_writer(vec<u8>& out): out_(&out) {}
+
+        /**
+         * @param value value (only the lowest count bits are written)
+         * @param count amount of bits (up to 56)
+         */
+        void write(const u64 value, const u32 count) {
+            if (count == 0) return;
+            buffer_ |= (value & (~u64{ 0 } >> (64 - count))) << used_;
+            used_ += count;
+            written_ += count;
+            while (used_ >= 8) {
+                out_->push_back(static_cast<u8>(buffer_));
+                buffer_ >>= 8;
+                used_ -= 8;
+            }
+        }
+
+        void write_bit(const bool value) {
+            write(value ? 1 : 0, 1);
+        }
+
+        /**
+         * Writes the last incomplete byte (the rest of it is 0)
+         */
+        void flush() {
+            if (used_ == 0) return;
+            out_->push_back(static_cast<u8>(buffer_));
+            written_ += 8 - used_;
+            buffer_ = 0;
+            used_ = 0;
+        }
+
+        size_t bits_written() const {
+            return written_;
+        }
+    };
+
+    /**
+     * Reads values written by bit_writer
+     */
+    struct bit_reader {
+    private:
+        const u8* data_ = nullptr;
+        size_t size_ = 0;
+        size_t position_ = 0;
+        u64 buffer_ = 0;
+        u32 available_ = 0;
+        bool overflow_ = false;
+
+        void refill_() {
+            if (size_ - position_ >= 8) {
+                // Takes as many whole bytes as fit into the buffer with one load
+                buffer_ |= load_le<u64>(data_ + position_) << available_;
+                const u32 bytes = (63 - available_) / 8;
+                position_ += bytes;
+                available_ += bytes * 8;
+                return;
+            }
+            while (available_ <= 56 && position_ < size_) {
+                buffer_ |= static_cast<u64>(data_[position_++]) << available_;
+                available_ += 8;
+            }
+        }
+
+    public:
+
+        bit_reader(const u8* const data, const size_t size): data_(data), size_(size) {}
+
+        /**
+         * @param count amount of bits (up to 56)
+         * @return value, 0 bits are read past the end of the data (see overflow())
+         */
+        u64 read(const u32 count) {
+            if (count == 0) return 0;
+            if (available_ < count) {
+                refill_();
+                if (available_ < count) {
+                    overflow_ = true;
+                    available_ = count;
+                }
+            }
+            const u64 value = buffer_ & (~u64{ 0 } >> (64 - count));
+            buffer_ >>= count;
+            available_ -= count;
+            return value;
+        }
+
+        bool read_bit() {
+            return read(1) != 0;
+        }
+
+        /**
+         * @return true if more bits were read than the data has
+         */
+        bool overflow() const {
+            return overflow_;
+        }
+    };
+
+    /**
+     * Stream VByte: 32 bit integers take 1 to 4 bytes each. Lengths are stored separately
+     * as 2 bit codes (4 per control byte), followed by the bytes of all values. With SSSE3
+     * the decoder expands 4 values per control byte with one shuffle.
+     */
+    struct stream_vbyte_tables_ {
+        // Positions of bytes of the 4 values in the data for every control byte (0xFF for zero bytes)
+        arr<arr<u8, 16>, 256> shuffle{};
+        // Amount of data bytes for every control byte
+        arr<u8, 256> length{};
+    };
+
+    static constexpr stream_vbyte_tables_ STREAM_VBYTE_TABLES = []() {
+        stream_vbyte_tables_ tables{};
+        for (u32 control = 0; control < 256; control++) {
+            u8 position = 0;
+            for (u32 value = 0; value < 4; value++) {
+                const u32 length = ((control >> (2 * value)) & 3) + 1;
+                for (u32 byte = 0; byte < 4; byte++) {
+                    tables.shuffle[control][4 * value + byte] = byte < length ? position + byte : 0xFF;
+                }
+                position += length;
+            }
+            tables.length[control] = position;
+        }
+        return tables;
+    }();
+
+    /**
+     * @param count amount of values
+     * @return size of the output buffer which is enough for any values
+     */
+    static size_t stream_vbyte_max_size(const size_t count) {
+        return (count + 3) / 4 + 4 * count;
+    }
+
+    static u8* stream_vbyte_put_(u8* const control, u8* const data, const size_t index, const u32 value) {
+        const u32 length = value < (1u << 8) ? 1 : value < (1u << 16) ? 2 : value < (1u << 24) ? 3 : 4;
+        control[index / 4] |= static_cast<u8>((length - 1) << (2 * (index % 4)));
+        // There is always space for 4 bytes, the rest is overwritten by the next value
+        store_le<u32>(value, data);
+        return data + length;
+    }
+
+    /**
+     * @param values values to encode
+     * @param count amount of values
+     * @param out output buffer of at least stream_vbyte_max_size(count) bytes
+     * @return amount of written bytes
+     */
+    static size_t stream_vbyte_encode(const u32* const values, const size_t count, u8* const out) {
+        const size_t control_size = (count + 3) / 4;
+        if (control_size != 0) std::memset(out, 0, control_size);
+        u8* data = out + control_size;
+        for (size_t i = 0; i < count; i++) data = stream_vbyte_put_(out, data, i, values[i]);
+        return data - out;
+    }
+
+    // Bytes of the encoded values, 0 if the data is too short
+    static size_t stream_vbyte_size_(const u8* const data, const size_t size, const size_t count) {
+        const size_t control_size = (count + 3) / 4;
+        if (size < control_size) return 0;
+        size_t total = control_size;
+        for (size_t i = 0; i < count / 4; i++) total += STREAM_VBYTE_TABLES.length[data[i]];
+        for (size_t i = count / 4 * 4; i < count; i++) total += ((data[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        return total <= size ? total : 0;
+    }
+
+    static u32 stream_vbyte_value_(const u8*& data, const u8* const end, const u8 control, const size_t index) {
+        const u32 length = ((control >> (2 * index)) & 3) + 1;
+        u32 value = 0;
+        if (end - data >= 4) {
+            value = load_le<u32>(data) & (~u32{ 0 } >> (32 - 8 * length));
+        } else {
+            for (u32 byte = 0; byte < length; byte++) value |= static_cast<u32>(data[byte]) << (8 * byte);
+        }
+        data += length;
+        return value;
+    }
+
+    /**
+     * @param data encoded values
+     * @param size amount of available bytes
+     * @param count amount of values to decode
+     * @param values decoded values
+     * @return amount of read bytes, 0 if the data is too short
+     */
+    static size_t stream_vbyte_decode(const u8* const data, const size_t size, const size_t count, u32* const values) {
+        const size_t total = stream_vbyte_size_(data, size, count);
+        if (total == 0) return 0;
+        const u8* const end = data + total;
+        const u8* in = data + (count + 3) / 4;
+        size_t i = 0;
+        #ifdef __SSSE3__
+        // Every step loads 16 bytes, so the last values are decoded by the scalar loop
+        for (; i + 4 <= count && end - in >= 16; i += 4) {
+            const u8 control = data[i / 4];
+            const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(STREAM_VBYTE_TABLES.shuffle[control].data()));
+            const __m128i encoded = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), _mm_shuffle_epi8(encoded, shuffle));
+            in += STREAM_VBYTE_TABLES.length[control];
+        }
+        #endif
+        for (; i < count; i++) values[i] = stream_vbyte_value_(in, end, data[i / 4], i % 4);
+        return total;
+    }
+
+    /**
+     * Encodes differences between consecutive values (zigzag, so they can decrease),
+     * which is compact for sorted ids or coordinates of a path
+     *
+     * @param values values to encode
+     * @param count amount of values
+     * @param out output buffer of at least stream_vbyte_max_size(count) bytes
+     * @param previous value before the first one
+     * @return amount of written bytes
+     */
+    static size_t stream_vbyte_encode_deltas(const i32* const values, const size_t count, u8* const out, i32 previous = 0) {
+        const size_t control_size = (count + 3) / 4;
+        std::memset(out, 0, control_size);
+        u8* data = out + control_size;
+        for (size_t i = 0; i < count; i++) {
+            const u32 delta = static_cast<u32>(values[i]) - static_cast<u32>(previous);
+            data = stream_vbyte_put_(out, data, i, zigzag_encode32(static_cast<i32>(delta)));
+            previous = values[i];
+        }
+        return data - out;
+    }
+
+    /**
+     * Decodes values written by stream_vbyte_encode_deltas()
+     *
+     * @param data encoded values
+     * @param size amount of available bytes
+     * @param count amount of values to decode
+     * @param values decoded values
+     * @param previous value before the first one
+     * @return amount of read bytes, 0 if the data is too short
+     */
+    static size_t stream_vbyte_decode_deltas(const u8* const data,
+                                             const size_t size,
+                                             const size_t count,
+                                             i32* const values,
+                                             i32 previous = 0) {
+        const size_t total = stream_vbyte_size_(data, size, count);
+        if (total == 0) return 0;
+        const u8* const end = data + total;
+        const u8* in = data + (count + 3) / 4;
+        size_t i = 0;
+        #ifdef __SSSE3__
+        __m128i last = _mm_set1_epi32(previous);
+        for (; i + 4 <= count && end - in >= 16; i += 4) {
+            const u8 control = data[i / 4];
+            const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(STREAM_VBYTE_TABLES.shuffle[control].data()));
+            const __m128i encoded = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)), shuffle);
+            // Zigzag decoding and the prefix sum of 4 deltas
+            __m128i deltas = _mm_xor_si128(_mm_srli_epi32(encoded, 1),
+                                           _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(encoded, _mm_set1_epi32(1))));
+            deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 4));
+            deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 8));
+            last = _mm_add_epi32(deltas, last);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), last);
+            last = _mm_shuffle_epi32(last, 0xFF);
+            in += STREAM_VBYTE_TABLES.length[control];
+        }
+        previous = _mm_cvtsi128_si32(last);
+        #endif
+        for (; i < count; i++) {
+            const i32 delta = zigzag_decode32(stream_vbyte_value_(in, end, data[i / 4], i % 4));
+            previous = static_cast<i32>(static_cast<u32>(previous) + static_cast<u32>(delta));
+            values[i] = previous;
+        }
+        return total;
+    }
+
+    /**
+     * Counts set bits of the array. With AVX2 it counts 256 bits at a time
+     * (4 bit lookup table in a vector register), otherwise one word at a time.
+     *
+     * @param words array of words
+     * @param count amount of words
+     * @return amount of set bits
+     */
+    static u64 popcount(const u64* const words, const size_t count) {
+        u64 total = 0;
+        size_t i = 0;
+        #ifdef __AVX2__
+        const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low_4bit = _mm256_set1_epi8(LOW_4BIT);
+        __m256i sums = _mm256_setzero_si256();
+        for (; i + 4 <= count; i += 4) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+            const __m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low_4bit));
+            const __m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_4bit));
+            // Sums of bytes in every 64 bit lane
+            sums = _mm256_add_epi64(sums, _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256()));
+        }
+        total += _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1)
+               + _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+        #endif
+        for (; i < count; i++) total += std::popcount(words[i]);
+        return total;
+    }
+
+    /**
+     * @param word word with more than index set bits
+     * @param index index of the set bit (0 for the lowest one)
+     * @return position of the set bit in the word
+     */
+    static u32 select_in_word(u64 word, const u32 index) {
+        #ifdef __BMI2__
+        return std::countr_zero(_pdep_u64(u64{ 1 } << index, word));
+        #else
+        for (u32 i = 0; i < index; i++) word &= word - 1;
+        return std::countr_zero(word);
+        #endif
+    }
+
+    /**
+     * Dynamic array of bits, 64 bits per word. Bits after size() in the last word are always 0,
+     * so operations work on whole words.
+     */
+    struct bitset {
+    private:
+        vec<u64> words_{};
+        size_t size_ = 0;
+
+        void clear_tail_() {
+            if (size_ % 64 != 0) words_.back() &= (u64{ 1 } << (size_ % 64)) - 1;
+        }
+
+    public:
+
+        bitset() {}
+
+        explicit bitset(const size_t size, const bool value = false) {
+            resize(size, value);
+        }
+
+        void resize(const size_t size, const bool value = false) {
+            const size_t old_size = size_;
+            words_.resize((size + 63) / 64, value ? ~u64{ 0 } : 0);
+            size_ = size;
+            // Bits of the last old word which are added
+            if (value && old_size < size && old_size % 64 != 0) words_[old_size / 64] |= ~u64{ 0 } << (old_size % 64);
+            clear_tail_();
+        }
+
+        void push_back(const bool value) {
+            if (size_ % 64 == 0) words_.push_back(0);
+            size_ += 1;
+            assign(size_ - 1, value);
+        }
+
+        bool get(const size_t index) const {
+            return (words_[index / 64] >> (index % 64)) & 1;
+        }
+
+        bool operator[](const size_t index) const {
+            return get(index);
+        }
+
+        void set(const size_t index) {
+            words_[index / 64] |= u64{ 1 } << (index % 64);
+        }
+
+        void reset(const size_t index) {
+            words_[index / 64] &= ~(u64{ 1 } << (index % 64));
+        }
+
+        void assign(const size_t index, const bool value) {
+            const u64 bit = u64{ 1 } << (index % 64);
+            words_[index / 64] = (words_[index / 64] & ~bit) | (value ? bit : 0);
+        }
+
+        // Sets all bits to the value
+        void fill(const bool value) {
+            std::fill(words_.begin(), words_.end(), value ? ~u64{ 0 } : 0);
+            clear_tail_();
+        }
+
+        // Inverts all bits
+        void flip() {
+            for (u64& word : words_) word = ~word;
+            clear_tail_();
+        }
+
+        // Bitsets should have the same size
+        bitset& operator&=(const bitset& other) {
+            for (size_t i = 0; i < words_.size(); i++) words_[i] &= other.words_[i];
+            return *this;
+        }
+
+        bitset& operator|=(const bitset& other) {
+            for (size_t i = 0; i < words_.size(); i++) words_[i] |= other.words_[i];
+            return *this;
+        }
+
+        bitset& operator^=(const bitset& other) {
+            for (size_t i = 0; i < words_.size(); i++) words_[i] ^= other.words_[i];
+            return *this;
+        }
+
+        // Removes bits which are set in the other bitset
+        bitset& subtract(const bitset& other) {
+            for (size_t i = 0; i < words_.size(); i++) words_[i] &= ~other.words_[i];
+            return *this;
+        }
+
+        bool operator==(const bitset& other) const {
+            return size_ == other.size_ && words_ == other.words_;
+        }
+
+        /**
+         * @return amount of set bits
+         */
+        size_t count() const {
+            return popcount(words_.data(), words_.size());
+        }
+
+        /**
+         * @param from index to start from
+         * @return index of the first set bit at or after the index, size() if there are none
+         */
+        size_t find_next(const size_t from) const {
+            if (from >= size_) return size_;
+            size_t w = from / 64;
+            u64 word = words_[w] & (~u64{ 0 } << (from % 64));
+            while (word == 0) {
+                if (++w == words_.size()) return size_;
+                word = words_[w];
+            }
+            return w * 64 + std::countr_zero(word);
+        }
+
+        /**
+         * Calls the function with the index of every set bit in increasing order
+         *
+         * @param function void(size_t index)
+         */
+        template <typename F>
+        void for_each_set(const F& function) const {
+            for (size_t w = 0; w < words_.size(); w++) {
+                for (u64 word = words_[w]; word != 0; word &= word - 1) function(w * 64 + std::countr_zero(word));
+            }
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        const u64* words() const {
+            return words_.data();
+        }
+
+        size_t word_count() const {
+            return words_.size();
+        }
+
+        // Bytes used by the bits
+        size_t memory() const {
+            return words_.size() * sizeof(u64);
+        }
+    };
+
+    /**
+     * Rank and select over a bitset (rank9 layout: 128 bits of counters per 512 bits of data,
+     * 25% more memory). Should be rebuilt after the bitset is changed.
+     */
+    struct rank_index {
+    private:
+        const bitset* bits_ = nullptr;
+        // For every block of 8 words: amount of set bits before the block, and
+        // 7 packed 9 bit counters of set bits before every word inside of the block
+        vec<u64> counts_{};
+        size_t ones_ = 0;
+
+        size_t block_ones_(const size_t block) const {
+            return counts_[2 * block];
+        }
+
+    public:
+
+        rank_index() {}
+
+        explicit rank_index(const bitset& bits): bits_(&bits) {
+            const u64* const words = bits.words();
+            const size_t word_count = bits.word_count();
+            const size_t blocks = word_count / 8 + 1;
+            counts_.resize(2 * blocks);
+            size_t total = 0;
+            for (size_t block = 0; block < blocks; block++) {
+                counts_[2 * block] = total;
+                u64 relative = 0;
+                u64 in_block = 0;
+                for (size_t j = 0; j < 8; j++) {
+                    if (j != 0) relative |= in_block << (9 * (j - 1));
+                    const size_t w = block * 8 + j;
+                    if (w < word_count) in_block += std::popcount(words[w]);
+                }
+                counts_[2 * block + 1] = relative;
+                total += in_block;
+            }
+            ones_ = total;
+        }
+
+        /**
+         * @param index position in the bitset (up to size() inclusive)
+         * @return amount of set bits before the position, in constant time
+         */
+        size_t rank(const size_t index) const {
+            const size_t w = index / 64;
+            const size_t block = w / 8;
+            const size_t j = w % 8;
+            size_t result = counts_[2 * block];
+            if (j != 0) result += (counts_[2 * block + 1] >> (9 * (j - 1))) & 0x1FF;
+            if (index % 64 != 0) result += std::popcount(bits_->words()[w] & ((u64{ 1 } << (index % 64)) - 1));
+            return result;
+        }
+
+        /**
+         * @param k index of the set bit (0 for the first one), should be less than ones()
+         * @return position of the set bit, in logarithmic time (binary search over blocks)
+         */
+        size_t select(size_t k) const {
+            // The last block which starts with no more than k set bits before it
+            size_t low = 0;
+            size_t high = counts_.size() / 2 - 1;
+            while (low < high) {
+                const size_t middle = (low + high + 1) / 2;
+                if (block_ones_(middle) <= k) low = middle;
+                else high = middle - 1;
+            }
+            k -= block_ones_(low);
+            const u64* const words = bits_->words();
+            for (size_t w = low * 8; ; w++) {
+                const u32 ones = std::popcount(words[w]);
+                if (k < ones) return w * 64 + select_in_word(words[w], static_cast<u32>(k));
+                k -= ones;
+            }
+        }
+
+        /**
+         * @return amount of set bits in the bitset
+         */
+        size_t ones() const {
+            return ones_;
+        }
+    };
+
+    /**
+     * Vector of unsigned integers which take a fixed amount of bits (1 to 32) each.
+     * Values cross word boundaries, so there are no wasted bits.
+     */
+    struct packed_vector {
+    private:
+        // One extra word, so any value can be read with a single unaligned 8 byte load
+        vec<u64> words_{ 0 };
+        size_t size_ = 0;
+        u32 width_ = 1;
+        u64 mask_ = 1;
+
+        template <u32 W>
+        static void unpack_(const u64* const words, const size_t first, const size_t count, u32* const out) {
+            constexpr u64 MASK = (u64{ 1 } << W) - 1;
+            const u8* const bytes = reinterpret_cast<const u8*>(words);
+            size_t bit = first * W;
+            for (size_t i = 0; i < count; i++, bit += W) {
+                // Offset inside of the byte is at most 7, so 32 bits always fit into 8 loaded bytes
+                out[i] = static_cast<u32>((load_le<u64>(bytes + bit / 8) >> (bit % 8)) & MASK);
+            }
+        }
+
+        using unpacker = void (*)(const u64*, size_t, size_t, u32*);
+
+        // Unpackers with the width known at compile time, so shifts and masks are constants
+        static constexpr arr<unpacker, 33> UNPACKERS = []<u32... W>(std::integer_sequence<u32, W...>) {
+            return arr<unpacker, 33>{ nullptr, &unpack_<W + 1>... };
+        }(std::make_integer_sequence<u32, 32>{});
+
+    public:
+
+        packed_vector() {}
+
+        /**
+         * @param width bits per value (from 1 to 32)
+         * @param size amount of values (all 0)
+         */
+        explicit packed_vector(const u32 width, const size_t size = 0):
+                width_(width < 1 ? 1 : (width > 32 ? 32 : width)),
+                mask_((u64{ 1 } << width_) - 1) {
+            resize(size);
+        }
+
+        void resize(const size_t size) {
+            size_ = size;
+            words_.resize((size * width_ + 63) / 64 + 1, 0);
+        }
+
+        u32 get(const size_t index) const {
+            const size_t bit = index * width_;
+            const size_t w = bit / 64;
+            const u32 offset = bit % 64;
+            u64 value = words_[w] >> offset;
+            if (offset + width_ > 64) value |= words_[w + 1] << (64 - offset);
+            return static_cast<u32>(value & mask_);
+        }
+
+        u32 operator[](const size_t index) const {
+            return get(index);
+        }
+
+        /**
+         * @param index index of the value
+         * @param value value (only the lowest width() bits are stored)
+         */
+        void set(const size_t index, const u32 value) {
+            const size_t bit = index * width_;
+            const size_t w = bit / 64;
+            const u32 offset = bit % 64;
+            const u64 v = value & mask_;
+            words_[w] = (words_[w] & ~(mask_ << offset)) | (v << offset);
+            if (offset + width_ > 64) {
+                const u32 written = 64 - offset;
+                words_[w + 1] = (words_[w + 1] & ~(mask_ >> written)) | (v >> written);
+            }
+        }
+
+        void push_back(const u32 value) {
+            resize(size_ + 1);
+            set(size_ - 1, value);
+        }
+
+        /**
+         * Unpacks consecutive values into the array of 32 bit integers
+         *
+         * @param first index of the first value
+         * @param count amount of values
+         * @param out output array of at least count values
+         */
+        void unpack(const size_t first, const size_t count, u32* const out) const {
+            if constexpr (std::endian::native == std::endian::little) {
+                UNPACKERS[width_](words_.data(), first, count, out);
+            } else {
+                for (size_t i = 0; i < count; i++) out[i] = get(first + i);
+            }
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        u32 width() const {
+            return width_;
+        }
+
+        // Bytes used by the values
+        size_t memory() const {
+            return words_.size() * sizeof(u64);
+        }
+    };
 }
 
 
@@ -14,8 +14,9 @@
 #include <string>
 #include <optional>
 #include <queue>
-
-// TODO(vadim): Every one of them should accept an allocator
+#include <variant>
+#include <array>
+#include <memory_resource>
 
 template <typename T, typename A = std::allocator<T>>
 using vec = std::vector<T, A>;
@@ -29,23 +30,27 @@ using vec_priority_queue = std::priority_queue<T, std::vector<T, A>, C>;
 template <typename T>
 using sptr = std::shared_ptr<T>;
 
-template <typename K, typename V, typename H = std::hash<K>>
-using umap = std::unordered_map<K, V, H>;
+template <typename K, typename V, typename H = std::hash<K>, typename A = std::allocator<std::pair<const K, V>>>
+using umap = std::unordered_map<K, V, H, std::equal_to<K>, A>;
+
+template <typename K, typename V, typename C = std::less<K>, typename A = std::allocator<std::pair<const K, V>>>
+using map = std::map<K, V, C, A>;
 
-template <typename K, typename V>
-using map = std::map<K, V>;
+// Not "mmap", so it doesn't collide with mmap() from <sys/mman.h>
+template <typename K, typename V, typename C = std::less<K>, typename A = std::allocator<std::pair<const K, V>>>
+using multimap = std::multimap<K, V, C, A>;
 
-template <typename K, typename V>
-using mmap = std::multimap<K, V>;
+template <typename K, typename H = std::hash<K>, typename A = std::allocator<K>>
+using uset = std::unordered_set<K, H, std::equal_to<K>, A>;
 
-template <typename K, typename H = std::hash<K>>
-using uset = std::unordered_set<K, H>;
+template <typename K, typename C = std::less<K>, typename A = std::allocator<K>>
+using set = std::set<K, C, A>;
 
-template <typename K>
-using set = std::set<K>;
+template <typename K, typename C = std::less<K>, typename A = std::allocator<K>>
+using mset = std::multiset<K, C, A>;
 
-template <typename K>
-using mset = std::multiset<K>;
+template <typename A = std::allocator<char>>
+using basic_str = std::basic_string<char, std::char_traits<char>, A>;
 
 using str = std::string;
 
@@ -58,6 +63,46 @@ using pair = std::pair<A, B>;
 template <typename T, int N>
 using arr = std::array<T, N>;
 
+/**
+ * Same collections but with std::pmr::polymorphic_allocator, so they can take
+ * memory from any std::pmr::memory_resource (see allocator::arena_resource).
+ * std::array doesn't allocate, so there is no version of arr here.
+ */
+namespace pmr {
+
+    template <typename T>
+    using vec = std::pmr::vector<T>;
+
+    template <typename T, typename C = std::less<T>>
+    using vec_priority_queue = std::priority_queue<T, std::pmr::vector<T>, C>;
+
+    template <typename K, typename V, typename H = std::hash<K>>
+    using umap = std::pmr::unordered_map<K, V, H>;
+
+    template <typename K, typename V>
+    using map = std::pmr::map<K, V>;
+
+    template <typename K, typename V>
+    using multimap = std::pmr::multimap<K, V>;
+
+    template <typename K, typename H = std::hash<K>>
+    using uset = std::pmr::unordered_set<K, H>;
+
+    template <typename K>
+    using set = std::pmr::set<K>;
+
+    template <typename K>
+    using mset = std::pmr::multiset<K>;
+
+    using str = std::pmr::string;
+
+    template <typename T, typename... A>
+    sptr<T> make_shared(std::pmr::memory_resource* const resource, A&&... args) {
+        return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>{ resource }, std::forward<A>(args)...);
+    }
+
+}
+
 template <typename V, typename E>
 struct result {
 private:
@@ -0,0 +1,211 @@
+#ifndef UTILITIES_COMPONENTS_H
+#define UTILITIES_COMPONENTS_H
+
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include "../types.h"
+#include "collections.h"
+#include "geometry.h"
+#include "graph.h"
+
+/**
+ * Connected components of a graph. Direction of the edges is ignored.
+ */
+namespace components {
+
+    constexpr u32 INVALID = UINT32_MAX;
+
+    /**
+     * Union-find (disjoint set) which can be modified from multiple threads at once.
+     * Roots are always linked under the root with smaller id, so the result
+     * doesn't depend on the order in which threads perform unions.
+     */
+    struct concurrent_union_find {
+    private:
+        uptr<std::atomic<u32>[]> parent_{};
+        u32 size_ = 0;
+
+    public:
+
+        explicit concurrent_union_find(const u32 size): parent_(new std::atomic<u32>[size]), size_(size) {
+            for (u32 i = 0; i < size; i++) parent_[i].store(i, std::memory_order_relaxed);
+        }
+
+        /**
+         * Finds the root of the set with path halving
+         *
+         * @param id element
+         * @return id of the root element
+         */
+        u32 find(u32 id) {
+            while (true) {
+                u32 parent = parent_[id].load(std::memory_order_relaxed);
+                if (parent == id) return id;
+                const u32 grandparent = parent_[parent].load(std::memory_order_relaxed);
+                if (parent != grandparent) {
+                    // Failure only means that another thread already moved it closer to the root
+                    parent_[id].compare_exchange_weak(parent, grandparent, std::memory_order_relaxed);
+                }
+                id = grandparent;
+            }
+        }
+
+        /**
+         * Merges sets of 2 elements
+         *
+         * @param a first element
+         * @param b second element
+         */
+        void unite(u32 a, u32 b) {
+            while (true) {
+                a = find(a);
+                b = find(b);
+                if (a == b) return;
+                if (a < b) std::swap(a, b);
+
+                // "a" is a root only if nobody linked it while we were looking
+                u32 expected = a;
+                if (parent_[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel)) return;
+            }
+        }
+
+        u32 size() const {
+            return size_;
+        }
+    };
+
+    struct labels {
+        // Component of every vertex indexed by vertex id (INVALID if there is no such vertex)
+        vec<u32> component{};
+        // Amount of vertices in every component
+        vec<u32> sizes{};
+
+        u32 count() const {
+            return sizes.size();
+        }
+
+        u32 largest() const {
+            return std::max_element(sizes.begin(), sizes.end()) - sizes.begin();
+        }
+    };
+
+    struct statistics {
+        u32 vertices = 0;
+        u32 edges = 0;
+        geometry::rectangle bounds{};
+    };
+
+    static u32 default_threads() {
+        const u32 threads = std::thread::hardware_concurrency();
+        return threads == 0 ? 1 : threads;
+    }
+
+    /**
+     * Finds all connected components of the graph. Edges are processed
+     * in parallel on the provided amount of threads.
+     *
+     * @param g graph
+     * @param threads amount of threads to use
+     * @return component of every vertex
+     */
+    static labels label(const graph& g, u32 threads = default_threads()) {
+        // Connections never point to removed vertices, so they can be used as is
+        const u32 id_limit = g.next_id();
+        const auto& edges = g.connections();
+
+        concurrent_union_find sets{ id_limit };
+        const auto unite_range = [&](const size_t begin, const size_t end) {
+            for (size_t i = begin; i < end; i++) sets.unite(edges[i].first, edges[i].second);
+        };
+
+        threads = std::max<u32>(1, std::min<size_t>(threads, edges.size() / (64 * KB) + 1));
+        if (threads == 1) {
+            unite_range(0, edges.size());
+        } else {
+            vec<std::thread> workers{};
+            const size_t step = (edges.size() + threads - 1) / threads;
+            for (size_t begin = 0; begin < edges.size(); begin += step) {
+                workers.emplace_back(unite_range, begin, std::min(begin + step, edges.size()));
+            }
+            for (auto& worker : workers) worker.join();
+        }
+
+        // Roots are the smallest ids in their sets, so a single pass in the order
+        // of ids meets every root before any other member of its component
+        labels result{ .component = vec<u32>(id_limit, INVALID) };
+        for (u32 id = 0; id < id_limit; id++) {
+            if (!g.contains(id)) continue;
+            const u32 root = sets.find(id);
+            if (root == id) {
+                result.component[id] = result.sizes.size();
+                result.sizes.emplace_back(0);
+            } else {
+                result.component[id] = result.component[root];
+            }
+            result.sizes[result.component[id]] += 1;
+        }
+        return result;
+    }
+
+    /**
+     * Calculates statistics for every component
+     *
+     * @param g graph
+     * @param l labels of the graph
+     * @return statistics indexed by the component id
+     */
+    static vec<statistics> describe(const graph& g, const labels& l) {
+        vec<statistics> result(l.count());
+        vec<u8> initialized(l.count(), 0);
+
+        for (const auto& [id, position] : g.vertices()) {
+            const u32 component = l.component[id];
+            auto& stats = result[component];
+            stats.vertices += 1;
+            if (!initialized[component]) {
+                stats.bounds = geometry::rectangle{ position, position };
+                initialized[component] = 1;
+            } else {
+                stats.bounds = geometry::rectangle{
+                    vec2{ glm::min(stats.bounds.bl.x, position.x), glm::min(stats.bounds.bl.y, position.y) },
+                    vec2{ glm::max(stats.bounds.tr.x, position.x), glm::max(stats.bounds.tr.y, position.y) } };
+            }
+        }
+
+        for (const auto& edge : g.connections()) {
+            result[l.component[edge.first]].edges += 1;
+        }
+        return result;
+    }
+
+    /**
+     * Removes every vertex which is not a part of the largest component
+     *
+     * @param g graph
+     * @param threads amount of threads to use for labelling
+     */
+    static void keep_largest(graph& g, const u32 threads = default_threads()) {
+        g.commit();
+        const labels l = label(g, threads);
+        if (l.count() == 0) return;
+        const u32 largest = l.largest();
+        g.retain([&](const u32 id) { return l.component[id] == largest; });
+    }
+
+    /**
+     * Removes every component with less than min_size vertices
+     *
+     * @param g graph
+     * @param min_size minimum amount of vertices in the component
+     * @param threads amount of threads to use for labelling
+     */
+    static void remove_smaller_than(graph& g, const u32 min_size, const u32 threads = default_threads()) {
+        g.commit();
+        const labels l = label(g, threads);
+        g.retain([&](const u32 id) { return l.sizes[l.component[id]] >= min_size; });
+    }
+
+}
+
+#endif //UTILITIES_COMPONENTS_H
@@ -5,19 +5,127 @@
 #ifndef UTILITIES_GRAPH_H
 #define UTILITIES_GRAPH_H
 
+#include <algorithm>
+#include <span>
+#include <stdexcept>
 #include "../types.h"
 #include "geometry.h"
 
 /**
- * Represents a graph with vertices on 2D space
+ * Compressed sparse row form of the connections of a graph.
+ * Connections of the vertex "i" are targets[offsets[i]] .. targets[offsets[i + 1]].
+ */
+struct csr {
+    vec<u32> offsets{};
+    vec<u32> targets{};
+
+    u32 vertices() const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+};
+
+/**
+ * Represents a graph with vertices on 2D space.
+ *
+ * Connections are stored in one array sorted by (source, target), so all connections
+ * of a vertex are next to each other. Single connect_vertices() calls are buffered and
+ * merged into this array by commit() (or the next batch), large changes should go through
+ * a batch. Const methods never modify the graph, so they can be called from many threads at once.
+ * Ids of the vertices are never reused, so they stay valid after removals.
  */
 struct graph {
+public:
+
+    using edge = pair<u32, u32>;
+
+    /**
+     * Set of changes which will be applied to the graph at once
+     */
+    struct batch {
+        // Will get ids starting from graph::next_id() in the order of insertion
+        vec<vec2> insert_vertices{};
+        vec<u32> remove_vertices{};
+        vec<edge> connect{};
+        vec<edge> disconnect{};
+
+        void clear() {
+            insert_vertices.clear();
+            remove_vertices.clear();
+            connect.clear();
+            disconnect.clear();
+        }
+    };
+
+    /**
+     * Iterable view over all vertices of the graph as (id, position) pairs
+     */
+    struct vertices_view {
+        const graph* g = nullptr;
+
+        struct iterator {
+            const graph* g = nullptr;
+            u32 id = 0;
+
+            pair<u32, vec2> operator*() const { return { id, g->positions_[id] }; }
+            bool operator!=(const iterator& other) const { return id != other.id; }
+            bool operator==(const iterator& other) const { return id == other.id; }
+            iterator& operator++() {
+                id = g->skip_removed_(id + 1);
+                return *this;
+            }
+        };
+
+        iterator begin() const { return { g, g->skip_removed_(0) }; }
+        iterator end() const { return { g, static_cast<u32>(g->positions_.size()) }; }
+        size_t size() const { return g->size_; }
+    };
+
 private:
-    umap<u32, vec2> vertices_{};
-    mmap<u32, u32> connections_{};
+    vec<vec2> positions_{};
+    vec<u8> present_{};
+    vec<u32> in_degree_{};
+    vec<u32> out_degree_{};
+    u32 size_ = 0;
+
+    // Sorted by (source, target)
+    vec<edge> connections_{};
+    // Added by connect_vertices() since the last commit()
+    vec<edge> pending_{};
 
 public:
 
+    graph() =default;
+
+    /**
+     * Builds a graph from the vertices and their connections at once.
+     * Id of every vertex is its index in the provided array.
+     *
+     * @param vertices positions of the vertices
+     * @param edges connections of the vertices (targets of every vertex should be sorted)
+     * @throws std::out_of_range if the connections refer to vertices which don't exist
+     */
+    graph(const vec<vec2>& vertices, const csr& edges):
+        positions_(vertices),
+        present_(vertices.size(), 1),
+        in_degree_(vertices.size(), 0),
+        out_degree_(vertices.size(), 0),
+        size_(vertices.size()) {
+
+        if (edges.vertices() > vertices.size()) throw std::out_of_range("graph: connections of unknown vertices");
+        connections_.reserve(edges.targets.size());
+        for (u32 id = 0; id < edges.vertices(); id++) {
+            if (edges.offsets[id] > edges.offsets[id + 1] || edges.offsets[id + 1] > edges.targets.size()) {
+                throw std::out_of_range("graph: invalid offsets of the connections");
+            }
+            for (u32 i = edges.offsets[id]; i < edges.offsets[id + 1]; i++) {
+                if (edges.targets[i] >= vertices.size()) throw std::out_of_range("graph: connection to unknown vertex");
+                connections_.emplace_back(id, edges.targets[i]);
+                out_degree_[id] += 1;
+                in_degree_[edges.targets[i]] += 1;
+            }
+        }
+    }
+
     /**
      * Insert a vertex into the graph
      *
@@ -25,8 +133,12 @@ public:
      * @return id of the inserted vertex
      */
     u32 insert_vertex(const vec2& vertex) {
-        const u32 id = vertices_.size();
-        vertices_.emplace(id, vertex);
+        const u32 id = positions_.size();
+        positions_.emplace_back(vertex);
+        present_.emplace_back(1);
+        in_degree_.emplace_back(0);
+        out_degree_.emplace_back(0);
+        size_ += 1;
         return id;
     }
 
@@ -37,35 +149,94 @@ public:
      * @return vertex
      */
     const vec2& get_vertex(const u32 id) const {
-        return vertices_.at(id);
+        if (!contains(id)) throw std::out_of_range("graph: no vertex with such id");
+        return positions_[id];
+    }
+
+    bool contains(const u32 id) const {
+        return id < present_.size() && present_[id];
     }
 
     /**
-     * Connect 2 vertices together
+     * @return id which will be given to the next inserted vertex
+     */
+    u32 next_id() const {
+        return positions_.size();
+    }
+
+    u32 in_degree(const u32 id) const {
+        return in_degree_[id];
+    }
+
+    u32 out_degree(const u32 id) const {
+        return out_degree_[id];
+    }
+
+    /**
+     * Connect 2 vertices together. Degrees are updated right away, but the connection
+     * is visible to connections() and neighbours() only after commit().
      *
      * @param a id of the first vertex
      * @param b id of the second vertex
      */
     void connect_vertices(const u32 a, const u32 b) {
-        connections_.emplace(a, b);
+        if (!contains(a) || !contains(b)) return;
+        pending_.emplace_back(a, b);
+        out_degree_[a] += 1;
+        in_degree_[b] += 1;
     }
 
     /**
-     * Will remove all vertices which are not connected to anything
+     * Merges connections added by connect_vertices() with one sort of them
+     * and one pass over the existing connections
      */
-    void remove_disconnected() {
-        // list of vertices to remove
-        vec<u32> remove{};
-
-        for (const auto& vertex : vertices_) {
-            const u32 id = vertex.first;
-            const auto begin = connections_.lower_bound(id);
-            const auto end = connections_.upper_bound(id);
-            if (begin == end) remove.emplace_back(id);
+    void commit() {
+        if (pending_.empty()) return;
+        merge_(take_pending_(), {});
+    }
+
+    /**
+     * Applies all changes from the batch with one sort of the batch
+     * and one pass over the existing connections.
+     * Every connection from "disconnect" list removes all copies of that connection.
+     * Connections of removed vertices are removed too.
+     *
+     * @param changes changes to apply (connections inside will be sorted)
+     * @return id of the first inserted vertex
+     */
+    u32 apply(batch& changes) {
+        const u32 first_id = positions_.size();
+        for (const vec2& position : changes.insert_vertices) insert_vertex(position);
+
+        for (const u32 id : changes.remove_vertices) {
+            if (contains(id)) {
+                present_[id] = 0;
+                size_ -= 1;
+            }
         }
 
-        for (const auto& id : remove) {
-            vertices_.erase(id);
+        auto& connect = changes.connect;
+        connect.insert(connect.end(), pending_.begin(), pending_.end());
+        pending_.clear();
+        std::erase_if(connect, [&](const edge& e) { return !contains(e.first) || !contains(e.second); });
+        std::sort(connect.begin(), connect.end());
+
+        auto& disconnect = changes.disconnect;
+        std::sort(disconnect.begin(), disconnect.end());
+
+        merge_(connect, disconnect);
+        return first_id;
+    }
+
+    /**
+     * Will remove all vertices which are not connected to anything
+     */
+    void remove_disconnected() {
+        for (u32 id = 0; id < present_.size(); id++) {
+            if (present_[id] && in_degree_[id] == 0 && out_degree_[id] == 0) {
+                present_[id] = 0;
+                size_ -= 1;
+            }
         }
     }
 
@@ -76,12 +247,93 @@ public:
      */
     void remove_unreachable(const u32 reachable);
 
-    const mmap<u32, u32>& connections() const {
+    /**
+     * Keeps only vertices for which predicate returns true. All connections
+     * of removed vertices are removed too.
+     *
+     * @param keep predicate which accepts id of the vertex
+     */
+    template <typename P>
+    void retain(const P& keep) {
+        for (u32 id = 0; id < present_.size(); id++) {
+            if (present_[id] && !keep(id)) {
+                present_[id] = 0;
+                size_ -= 1;
+            }
+        }
+        merge_(take_pending_(), {});
+    }
+
+    /**
+     * @param id id of the vertex
+     * @return all outgoing connections of the vertex sorted by target
+     * @throws std::logic_error if there are connections which are not committed
+     */
+    std::span<const edge> neighbours(const u32 id) const {
+        const auto& all = connections();
+        const auto begin = std::lower_bound(all.begin(), all.end(), edge{ id, 0 });
+        auto end = begin;
+        while (end != all.end() && end->first == id) ++end;
+        return { begin, end };
+    }
+
+    /**
+     * @return all connections sorted by (source, target)
+     * @throws std::logic_error if there are connections which are not committed
+     */
+    const vec<edge>& connections() const {
+        if (!pending_.empty()) throw std::logic_error("graph: connections are not committed");
         return connections_;
     }
 
-    const umap<u32, vec2>& vertices() const {
-        return vertices_;
+    vertices_view vertices() const {
+        return { this };
+    }
+
+private:
+
+    vec<edge> take_pending_() {
+        vec<edge> added{};
+        added.swap(pending_);
+        std::sort(added.begin(), added.end());
+        return added;
+    }
+
+    u32 skip_removed_(u32 id) const {
+        while (id < present_.size() && !present_[id]) id++;
+        return id;
+    }
+
+    /**
+     * Merges sorted new connections into the existing ones, drops every connection
+     * which is in the "disconnect" list or has a removed vertex, and recalculates degrees.
+     */
+    void merge_(const vec<edge>& connect, const vec<edge>& disconnect) {
+        vec<edge> result{};
+        result.reserve(connections_.size() + connect.size());
+        std::fill(in_degree_.begin(), in_degree_.end(), 0);
+        std::fill(out_degree_.begin(), out_degree_.end(), 0);
+
+        auto removed = disconnect.begin();
+        const auto keep = [&](const edge& e) {
+            if (!present_[e.first] || !present_[e.second]) return;
+            while (removed != disconnect.end() && *removed < e) ++removed;
+            if (removed != disconnect.end() && *removed == e) return;
+            result.emplace_back(e);
+            out_degree_[e.first] += 1;
+            in_degree_[e.second] += 1;
+        };
+
+        auto existing = connections_.begin();
+        auto added = connect.begin();
+        while (existing != connections_.end() || added != connect.end()) {
+            if (added == connect.end() || (existing != connections_.end() && *existing < *added)) {
+                keep(*existing++);
+            } else {
+                keep(*added++);
+            }
+        }
+        connections_ = std::move(result);
     }
 
 };
@@ -0,0 +1,302 @@
+#ifndef UTILITIES_GRAPH_FILE_H
+#define UTILITIES_GRAPH_FILE_H
+
+#include <algorithm>
+#include <cstring>
+#include <span>
+#include "../types.h"
+#include "../markers.h"
+#include "../system.h"
+#include "collections.h"
+#include "geometry.h"
+#include "graph.h"
+
+/**
+ * Binary file format for graphs which can be memory mapped and used without deserialization.
+ *
+ * Layout (all values are in the native byte order):
+ *   header
+ *   positions: f32 x, f32 y  per vertex
+ *   targets:   u32           per connection, sorted by (source, target)
+ *   offsets:   u64           per vertex + 1, connections of vertex "i" are targets[offsets[i]] .. targets[offsets[i + 1]]
+ */
+namespace graph_file {
+
+    constexpr u32 MAGIC = 0x46524755; // "UGRF"
+    constexpr u32 VERSION = 1;
+
+    struct header {
+        u32 magic = MAGIC;
+        u32 version = VERSION;
+        u32 vertices = 0;
+        u32 reserved = 0;
+        u64 connections = 0;
+        u64 positions_offset = 0;
+        u64 targets_offset = 0;
+        u64 offsets_offset = 0;
+    };
+
+    static_assert(sizeof(vec2) == 2 * sizeof(f32), "vec2 is stored in the file as is");
+
+    /**
+     * Read-only graph backed by the memory mapped file
+     */
+    struct view {
+    private:
+        sys::file::mapping file_{};
+        const header* header_ = nullptr;
+        const vec2* positions_ = nullptr;
+        const u32* targets_ = nullptr;
+        const u64* offsets_ = nullptr;
+
+        // True if "count" elements of "element" bytes starting at "offset" are inside of the file
+        static bool fits_(const u64 size, const u64 offset, const u64 count, const u64 element) {
+            return offset <= size && count <= (size - offset) / element;
+        }
+
+    public:
+
+        /**
+         * Maps the graph file and validates its header
+         *
+         * @param path path to the file
+         * @param result view of the graph
+         * @return status of the operation
+         */
+        static sys::status open(IN const char* const path, OUT view* const result) {
+            view v{};
+            const sys::status map_status = sys::file::map(path, &v.file_);
+            if (map_status != sys::status::SUCCESS) return map_status;
+
+            const u8* const data = v.file_.data;
+            const size_t size = v.file_.size;
+            if (size < sizeof(header)) return sys::status::INVALID_FORMAT;
+
+            const auto* h = reinterpret_cast<const header*>(data);
+            if (h->magic != MAGIC || h->version != VERSION) return sys::status::INVALID_FORMAT;
+
+            // Sizes are compared in the subtraction form, so a crafted header can't overflow them
+            if (!fits_(size, h->positions_offset, u64{ h->vertices }, sizeof(vec2)) ||
+                !fits_(size, h->targets_offset, h->connections, sizeof(u32)) ||
+                !fits_(size, h->offsets_offset, u64{ h->vertices } + 1, sizeof(u64))) {
+                return sys::status::INVALID_FORMAT;
+            }
+            if (h->offsets_offset % alignof(u64) != 0 ||
+                h->positions_offset % alignof(vec2) != 0 ||
+                h->targets_offset % alignof(u32) != 0) {
+                return sys::status::INVALID_FORMAT;
+            }
+
+            v.header_ = h;
+            v.positions_ = reinterpret_cast<const vec2*>(data + h->positions_offset);
+            v.targets_ = reinterpret_cast<const u32*>(data + h->targets_offset);
+            v.offsets_ = reinterpret_cast<const u64*>(data + h->offsets_offset);
+
+            // neighbours() trusts the offsets and users trust the targets, so every one of them is checked once here
+            if (v.offsets_[0] != 0 || v.offsets_[h->vertices] != h->connections) return sys::status::INVALID_FORMAT;
+            for (u32 i = 0; i < h->vertices; i++) {
+                if (v.offsets_[i + 1] < v.offsets_[i] || v.offsets_[i + 1] > h->connections) {
+                    return sys::status::INVALID_FORMAT;
+                }
+            }
+            for (u64 i = 0; i < h->connections; i++) {
+                if (v.targets_[i] >= h->vertices) return sys::status::INVALID_FORMAT;
+            }
+
+            *result = std::move(v);
+            return sys::status::SUCCESS;
+        }
+
+        u32 vertices() const {
+            return header_->vertices;
+        }
+
+        u64 connections() const {
+            return header_->connections;
+        }
+
+        const vec2& get_vertex(const u32 id) const {
+            return positions_[id];
+        }
+
+        /**
+         * @param id id of the vertex
+         * @return targets of all outgoing connections sorted by id
+         */
+        std::span<const u32> neighbours(const u32 id) const {
+            return { targets_ + offsets_[id], targets_ + offsets_[id + 1] };
+        }
+
+        u32 out_degree(const u32 id) const {
+            return offsets_[id + 1] - offsets_[id];
+        }
+    };
+
+    /**
+     * Writes the graph file without keeping the graph in memory.
+     * All vertices should be added first, then connections in the order of their source.
+     * Only offsets of the vertices (8 bytes per vertex) are kept in memory until finish().
+     */
+    struct writer {
+    private:
+        sys::file::output file_{};
+        header header_{};
+        vec<u8> buffer_{};
+        u64 position_ = 0;
+        vec<u64> offsets_{};
+        bool connections_started_ = false;
+        // Last written target, so connections of a repeated source continue in order
+        u32 last_target_ = 0;
+
+        sys::status write_(const void* const data, const size_t size) {
+            position_ += size;
+            if (buffer_.size() + size > buffer_.capacity()) {
+                const sys::status s = flush_();
+                if (s != sys::status::SUCCESS) return s;
+                if (size > buffer_.capacity()) return file_.write(data, size);
+            }
+            const u8* const bytes = static_cast<const u8*>(data);
+            buffer_.insert(buffer_.end(), bytes, bytes + size);
+            return sys::status::SUCCESS;
+        }
+
+        sys::status flush_() {
+            const sys::status s = file_.write(buffer_.data(), buffer_.size());
+            buffer_.clear();
+            return s;
+        }
+
+        sys::status align_(const size_t alignment) {
+            static constexpr u8 zeros[16]{};
+            return write_(zeros, (alignment - position_ % alignment) % alignment);
+        }
+
+        sys::status start_connections_() {
+            connections_started_ = true;
+            header_.targets_offset = position_;
+            offsets_.reserve(u64{ header_.vertices } + 1);
+            offsets_.emplace_back(0);
+            return sys::status::SUCCESS;
+        }
+
+    public:
+
+        /**
+         * Creates the graph file
+         *
+         * @param path path to the file
+         * @param result writer
+         * @param buffer_size size of the write buffer
+         * @return status of the operation
+         */
+        static sys::status create(IN const char* const path, OUT writer* const result, IN const size_t buffer_size = 1 * MB) {
+            writer w{};
+            const sys::status s = sys::file::create(path, &w.file_);
+            if (s != sys::status::SUCCESS) return s;
+            w.buffer_.reserve(buffer_size);
+
+            // Header is written again with real values in finish()
+            const sys::status header_status = w.write_(&w.header_, sizeof(header));
+            if (header_status != sys::status::SUCCESS) return header_status;
+            w.header_.positions_offset = w.position_;
+
+            *result = std::move(w);
+            return sys::status::SUCCESS;
+        }
+
+        /**
+         * Appends a vertex. Ids are given in the order of insertion starting from 0.
+         *
+         * @param position position of the vertex
+         * @return status of the operation
+         */
+        sys::status add_vertex(const vec2& position) {
+            if (connections_started_) return sys::status::INVALID_ARGUMENT;
+            header_.vertices += 1;
+            return write_(&position, sizeof(vec2));
+        }
+
+        /**
+         * Appends outgoing connections of the vertex. Sources should not decrease between calls,
+         * connections of a repeated source should continue after its previous targets.
+         *
+         * @param source id of the source vertex
+         * @param targets targets of the connections (should be sorted)
+         * @return status of the operation, INVALID_ARGUMENT if the connections would not be sorted
+         */
+        sys::status add_connections(const u32 source, const std::span<const u32> targets) {
+            if (!connections_started_) start_connections_();
+            if (source >= header_.vertices || offsets_.size() > source + 2) return sys::status::INVALID_ARGUMENT;
+            if (!std::is_sorted(targets.begin(), targets.end())) return sys::status::INVALID_ARGUMENT;
+            for (const u32 target : targets) {
+                if (target >= header_.vertices) return sys::status::INVALID_ARGUMENT;
+            }
+            const bool repeated = offsets_.size() == source + 2 && offsets_[source + 1] != offsets_[source];
+            if (repeated && !targets.empty() && targets.front() < last_target_) return sys::status::INVALID_ARGUMENT;
+            if (!targets.empty()) last_target_ = targets.back();
+
+            // Vertices without connections between the previous source and this one
+            while (offsets_.size() <= source) offsets_.emplace_back(header_.connections);
+            header_.connections += targets.size();
+            if (offsets_.size() == source + 1) offsets_.emplace_back(header_.connections);
+            else offsets_.back() = header_.connections;
+
+            return write_(targets.data(), targets.size_bytes());
+        }
+
+        /**
+         * Writes offsets and the final header. Writer can't be used after that.
+         *
+         * @return status of the operation
+         */
+        sys::status finish() {
+            if (!connections_started_) start_connections_();
+            while (offsets_.size() <= header_.vertices) offsets_.emplace_back(header_.connections);
+
+            sys::status s = align_(alignof(u64));
+            if (s != sys::status::SUCCESS) return s;
+            header_.offsets_offset = position_;
+            s = write_(offsets_.data(), offsets_.size() * sizeof(u64));
+            if (s != sys::status::SUCCESS) return s;
+            s = flush_();
+            if (s != sys::status::SUCCESS) return s;
+            return file_.write_at(0, &header_, sizeof(header));
+        }
+    };
+
+    /**
+     * Writes the graph into the file. Removed vertices are skipped, so
+     * vertices get new continuous ids in the order of their old ids.
+     *
+     * @param path path to the file
+     * @param g graph
+     * @return status of the operation
+     */
+    static sys::status write(IN const char* const path, IN const graph& g) {
+        writer w{};
+        sys::status s = writer::create(path, &w);
+        if (s != sys::status::SUCCESS) return s;
+
+        vec<u32> new_id(g.next_id(), 0);
+        u32 next = 0;
+        for (const auto& [id, position] : g.vertices()) {
+            new_id[id] = next++;
+            s = w.add_vertex(position);
+            if (s != sys::status::SUCCESS) return s;
+        }
+
+        // Old ids are increasing together with new ones, so connections stay sorted
+        vec<u32> targets{};
+        for (const auto& [id, position] : g.vertices()) {
+            targets.clear();
+            for (const auto& edge : g.neighbours(id)) targets.emplace_back(new_id[edge.second]);
+            if (targets.empty()) continue;
+            s = w.add_connections(new_id[id], targets);
+            if (s != sys::status::SUCCESS) return s;
+        }
+        return w.finish();
+    }
+
+}
+
+#endif //UTILITIES_GRAPH_FILE_H
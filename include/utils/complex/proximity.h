@@ -0,0 +1,284 @@
+#ifndef UTILITIES_PROXIMITY_H
+#define UTILITIES_PROXIMITY_H
+
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "../types.h"
+#include "collections.h"
+#include "components.h"
+#include "geometry.h"
+#include "graph.h"
+
+/**
+ * Construction of proximity graphs (radius and k nearest neighbours) from a set of points.
+ */
+namespace proximity {
+
+    /**
+     * Uniform grid over a set of points. Points are sorted by cells,
+     * so every cell is a continuous range of point ids.
+     */
+    struct grid {
+        vec2 origin{};
+        f32 cell = 1.f;
+        i32 width = 0;
+        i32 height = 0;
+        // Points of the cell "c" are points[cell_start[c]] .. points[cell_start[c + 1]]
+        vec<u32> cell_start{};
+        vec<u32> points{};
+
+        /**
+         * Builds a grid with counting sort of the points
+         *
+         * @param positions points to store in the grid
+         * @param cell_size desired size of the cell (can be increased to limit amount of cells)
+         * @return grid
+         * @throws std::invalid_argument if a coordinate is not finite or the cell size is NaN
+         */
+        static grid build(const vec<vec2>& positions, f32 cell_size) {
+            grid g{};
+            if (positions.empty()) return g;
+            if (std::isnan(cell_size)) throw std::invalid_argument("proximity: cell size is NaN");
+
+            vec2 min = positions[0], max = positions[0];
+            for (const vec2& p : positions) {
+                if (!std::isfinite(p.x) || !std::isfinite(p.y)) throw std::invalid_argument("proximity: point is not finite");
+                min = vec2{ glm::min(min.x, p.x), glm::min(min.y, p.y) };
+                max = vec2{ glm::max(max.x, p.x), glm::max(max.y, p.y) };
+            }
+
+            // Don't allow more cells than a few per point, otherwise tiny cells will take all memory
+            const vec2 extent = max - min;
+            if (!std::isfinite(extent.x) || !std::isfinite(extent.y)) throw std::invalid_argument("proximity: points are too far apart");
+            const f32 max_cells = 4.f * positions.size() + 16.f;
+            if (cell_size <= 0.f) cell_size = 1.f;
+            while ((extent.x / cell_size + 1.f) * (extent.y / cell_size + 1.f) > max_cells) cell_size *= 2.f;
+
+            g.origin = min;
+            g.cell = cell_size;
+            g.width = static_cast<i32>(extent.x / cell_size) + 1;
+            g.height = static_cast<i32>(extent.y / cell_size) + 1;
+
+            g.cell_start.assign(static_cast<size_t>(g.width) * g.height + 1, 0);
+            vec<u32> cells(positions.size());
+            for (u32 i = 0; i < positions.size(); i++) {
+                cells[i] = g.cell_of(positions[i]);
+                g.cell_start[cells[i] + 1] += 1;
+            }
+            for (size_t c = 1; c < g.cell_start.size(); c++) g.cell_start[c] += g.cell_start[c - 1];
+
+            vec<u32> cursor(g.cell_start.begin(), g.cell_start.end() - 1);
+            g.points.resize(positions.size());
+            for (u32 i = 0; i < positions.size(); i++) g.points[cursor[cells[i]]++] = i;
+            return g;
+        }
+
+        i32 column(const vec2& p) const {
+            return std::clamp(static_cast<i32>((p.x - origin.x) / cell), 0, width - 1);
+        }
+
+        i32 row(const vec2& p) const {
+            return std::clamp(static_cast<i32>((p.y - origin.y) / cell), 0, height - 1);
+        }
+
+        u32 cell_of(const vec2& p) const {
+            return row(p) * width + column(p);
+        }
+
+        /**
+         * Calls visitor for every point in the cell
+         *
+         * @param x column of the cell
+         * @param y row of the cell
+         * @param visitor called with id of every point
+         */
+        template <typename V>
+        void visit(const i32 x, const i32 y, const V& visitor) const {
+            if (x < 0 || y < 0 || x >= width || y >= height) return;
+            const u32 c = y * width + x;
+            for (u32 i = cell_start[c]; i < cell_start[c + 1]; i++) visitor(points[i]);
+        }
+    };
+
+    static f32 distance2(const vec2& a, const vec2& b) {
+        const vec2 d = a - b;
+        return d.x * d.x + d.y * d.y;
+    }
+
+    using components::default_threads;
+
+    /**
+     * Runs search for every point on multiple threads and collects results into CSR.
+     * Every thread processes a continuous range of points and writes into its own
+     * buffer, so the buffers are simply concatenated at the end.
+     *
+     * @param size amount of points
+     * @param threads amount of threads
+     * @param search called with id of the point and the output array for its neighbours
+     * @return neighbours of every point
+     */
+    template <typename S>
+    csr collect_(const u32 size, u32 threads, const S& search) {
+        struct part {
+            vec<u32> counts{};
+            vec<u32> targets{};
+        };
+
+        threads = std::max<u32>(1, std::min<u32>(threads, size / 1024 + 1));
+        const u32 step = (size + threads - 1) / threads;
+        vec<part> parts(threads);
+
+        const auto run = [&](const u32 part_id) {
+            part& p = parts[part_id];
+            const u32 begin = part_id * step;
+            const u32 end = std::min(begin + step, size);
+            if (begin >= end) return;
+            p.counts.reserve(end - begin);
+            for (u32 id = begin; id < end; id++) {
+                const size_t before = p.targets.size();
+                search(id, p.targets);
+                std::sort(p.targets.begin() + before, p.targets.end());
+                p.counts.emplace_back(p.targets.size() - before);
+            }
+        };
+
+        if (threads == 1) {
+            run(0);
+        } else {
+            vec<std::thread> workers{};
+            for (u32 t = 0; t < threads; t++) workers.emplace_back(run, t);
+            for (auto& worker : workers) worker.join();
+        }
+
+        csr result{};
+        result.offsets.reserve(size + 1);
+        result.offsets.emplace_back(0);
+        size_t total = 0;
+        for (const part& p : parts) total += p.targets.size();
+        result.targets.reserve(total);
+        for (const part& p : parts) {
+            for (const u32 count : p.counts) result.offsets.emplace_back(result.offsets.back() + count);
+            result.targets.insert(result.targets.end(), p.targets.begin(), p.targets.end());
+        }
+        return result;
+    }
+
+    /**
+     * Connects every point with all points within the radius (connections go both ways).
+     *
+     * @param points positions of the points
+     * @param radius radius of the search
+     * @param threads amount of threads to use
+     * @return neighbours of every point sorted by id
+     * @throws std::invalid_argument if the radius or a coordinate is not finite
+     */
+    static csr radius(const vec<vec2>& points, const f32 radius, const u32 threads = default_threads()) {
+        if (!std::isfinite(radius)) throw std::invalid_argument("proximity: radius is not finite");
+        const grid g = grid::build(points, radius);
+        const i32 reach = static_cast<i32>(std::ceil(radius / g.cell));
+        const f32 radius2 = radius * radius;
+
+        return collect_(points.size(), threads, [&](const u32 id, vec<u32>& out) {
+            const vec2& p = points[id];
+            const i32 x = g.column(p), y = g.row(p);
+            for (i32 dy = -reach; dy <= reach; dy++) {
+                for (i32 dx = -reach; dx <= reach; dx++) {
+                    g.visit(x + dx, y + dy, [&](const u32 other) {
+                        if (other != id && distance2(p, points[other]) <= radius2) out.emplace_back(other);
+                    });
+                }
+            }
+        });
+    }
+
+    /**
+     * Connects every point with its k nearest points (connections are directed from the point).
+     *
+     * @param points positions of the points
+     * @param k amount of neighbours
+     * @param threads amount of threads to use
+     * @return neighbours of every point sorted by id
+     * @throws std::invalid_argument if a coordinate is not finite
+     */
+    static csr nearest(const vec<vec2>& points, const u32 k, const u32 threads = default_threads()) {
+        if (points.empty()) return csr{ .offsets = { 0 } };
+
+        // Cell size which gives about k points per cell for uniformly distributed points
+        vec2 min = points[0], max = points[0];
+        for (const vec2& p : points) {
+            min = vec2{ glm::min(min.x, p.x), glm::min(min.y, p.y) };
+            max = vec2{ glm::max(max.x, p.x), glm::max(max.y, p.y) };
+        }
+        const vec2 extent = max - min;
+        const f32 area = std::max(extent.x, 1e-6f) * std::max(extent.y, 1e-6f);
+        const grid g = grid::build(points, std::sqrt(area * std::max<u32>(k, 1) / points.size()));
+        const i32 max_ring = std::max(g.width, g.height);
+
+        return collect_(points.size(), threads, [&](const u32 id, vec<u32>& out) {
+            if (k == 0) return;
+            const vec2& p = points[id];
+            const i32 x = g.column(p), y = g.row(p);
+
+            // Max-heap of the best candidates, top is the farthest one
+            vec_priority_queue<pair<f32, u32>> best{};
+            const auto consider = [&](const u32 other) {
+                if (other == id) return;
+                const f32 d = distance2(p, points[other]);
+                if (best.size() < k) best.emplace(d, other);
+                else if (d < best.top().first) { best.pop(); best.emplace(d, other); }
+            };
+
+            for (i32 ring = 0; ring <= max_ring; ring++) {
+                if (ring == 0) {
+                    g.visit(x, y, consider);
+                } else {
+                    for (i32 d = -ring; d <= ring; d++) {
+                        g.visit(x + d, y - ring, consider);
+                        g.visit(x + d, y + ring, consider);
+                    }
+                    for (i32 d = -ring + 1; d <= ring - 1; d++) {
+                        g.visit(x - ring, y + d, consider);
+                        g.visit(x + ring, y + d, consider);
+                    }
+                }
+                // Every point in the next ring is at least (ring * cell) away
+                const f32 bound = ring * g.cell;
+                if (best.size() == k && best.top().first <= bound * bound) break;
+            }
+
+            while (!best.empty()) {
+                out.emplace_back(best.top().second);
+                best.pop();
+            }
+        });
+    }
+
+    /**
+     * Builds a graph where every vertex is connected with all vertices within the radius
+     *
+     * @param points positions of the vertices
+     * @param r radius of the search
+     * @param threads amount of threads to use
+     * @return graph
+     */
+    static graph radius_graph(const vec<vec2>& points, const f32 r, const u32 threads = default_threads()) {
+        return graph{ points, radius(points, r, threads) };
+    }
+
+    /**
+     * Builds a graph where every vertex is connected with its k nearest vertices
+     *
+     * @param points positions of the vertices
+     * @param k amount of neighbours
+     * @param threads amount of threads to use
+     * @return graph
+     */
+    static graph nearest_graph(const vec<vec2>& points, const u32 k, const u32 threads = default_threads()) {
+        return graph{ points, nearest(points, k, threads) };
+    }
+
+}
+
+#endif //UTILITIES_PROXIMITY_H
@@ -0,0 +1,210 @@
+#ifndef UTILITIES_LZ_H
+#define UTILITIES_LZ_H
+
+#include <bit>
+#include <cstring>
+#include "types.h"
+#include "markers.h"
+
+/**
+ * Fast LZ77 block compression (LZ4-like format), made for speed of decompression
+ * rather than for the best ratio.
+ *
+ * Block is a list of sequences:
+ *   u8      token: high 4 bits - amount of literals, low 4 bits - match length - MIN_MATCH
+ *   u8[]    more literal length bytes if it's 15 (255 means that one more byte follows)
+ *   u8[]    literals
+ *   u16     offset of the match back from the current position (little-endian)
+ *   u8[]    more match length bytes if it's 15
+ * The last sequence has only literals.
+ */
+namespace lz {
+
+    constexpr size_t MIN_MATCH = 4;
+    constexpr size_t MAX_OFFSET = 65535;
+    // Last bytes are always literals, so the decoder can copy matches in 8 byte steps
+    constexpr size_t LAST_LITERALS = 5;
+    constexpr size_t MATCH_LIMIT = 12;
+    constexpr u32 HASH_BITS = 12;
+
+    /**
+     * @param size size of the input
+     * @return size of the output buffer which is enough for any input of this size
+     */
+    static size_t max_compressed_size(const size_t size) {
+        return size + size / 255 + 16;
+    }
+
+    static u32 read32_(const u8* const data) {
+        u32 value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    static u64 read64_(const u8* const data) {
+        u64 value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    static u32 hash_(const u32 sequence) {
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    static u8* write_length_(u8* out, size_t length) {
+        while (length >= 255) {
+            *out++ = 255;
+            length -= 255;
+        }
+        *out++ = static_cast<u8>(length);
+        return out;
+    }
+
+    // Amount of equal bytes at a and b, but not further than the limit
+    static size_t common_length_(const u8* a, const u8* b, const u8* const limit) {
+        const u8* const start = a;
+        if constexpr (std::endian::native == std::endian::little) {
+            while (a + 8 <= limit) {
+                const u64 difference = read64_(a) ^ read64_(b);
+                if (difference != 0) return a - start + std::countr_zero(difference) / 8;
+                a += 8;
+                b += 8;
+            }
+        }
+        while (a < limit && *a == *b) {
+            a++;
+            b++;
+        }
+        return a - start;
+    }
+
+    static u8* write_sequence_(u8* out, const u8* const literals, const size_t literal_length, const size_t offset, const size_t match_length) {
+        u8* const token = out++;
+        *token = static_cast<u8>((literal_length >= 15 ? 15 : literal_length) << 4);
+        if (literal_length >= 15) out = write_length_(out, literal_length - 15);
+        if (literal_length != 0) std::memcpy(out, literals, literal_length);
+        out += literal_length;
+        if (match_length == 0) return out;
+
+        out[0] = static_cast<u8>(offset);
+        out[1] = static_cast<u8>(offset >> 8);
+        out += 2;
+        const size_t length = match_length - MIN_MATCH;
+        *token |= static_cast<u8>(length >= 15 ? 15 : length);
+        if (length >= 15) out = write_length_(out, length - 15);
+        return out;
+    }
+
+    /**
+     * Compresses the block
+     *
+     * @param data input
+     * @param size size of the input
+     * @param out output buffer
+     * @param capacity size of the output buffer (at least max_compressed_size(size))
+     * @return size of the compressed block, 0 if the output buffer is too small
+     */
+    static size_t compress(IN const u8* const data, IN const size_t size, OUT u8* const out, IN const size_t capacity) {
+        if (capacity < max_compressed_size(size)) return 0;
+        u32 table[1u << HASH_BITS]{};
+
+        u8* op = out;
+        size_t anchor = 0;
+        size_t position = 0;
+        if (size > MATCH_LIMIT) {
+            const size_t limit = size - MATCH_LIMIT;
+            const u8* const match_limit = data + size - LAST_LITERALS;
+            while (position < limit) {
+                const u32 sequence = read32_(data + position);
+                const u32 hash = hash_(sequence);
+                size_t candidate = table[hash];
+                table[hash] = static_cast<u32>(position);
+
+                if (candidate >= position || position - candidate > MAX_OFFSET || read32_(data + candidate) != sequence) {
+                    // Incompressible data is skipped faster and faster
+                    position += 1 + ((position - anchor) >> 6);
+                    continue;
+                }
+
+                // Match could start earlier than the hash says
+                while (position > anchor && candidate > 0 && data[position - 1] == data[candidate - 1]) {
+                    position--;
+                    candidate--;
+                }
+                const size_t length = MIN_MATCH + common_length_(data + position + MIN_MATCH, data + candidate + MIN_MATCH, match_limit);
+                op = write_sequence_(op, data + anchor, position - anchor, position - candidate, length);
+                position += length;
+                anchor = position;
+                if (position - 2 < limit) table[hash_(read32_(data + position - 2))] = static_cast<u32>(position - 2);
+            }
+        }
+        op = write_sequence_(op, data + anchor, size - anchor, 0, 0);
+        return op - out;
+    }
+
+    static bool read_length_(const u8*& in, const u8* const end, size_t& length) {
+        u8 byte = 255;
+        while (byte == 255) {
+            if (in == end) return false;
+            byte = *in++;
+            length += byte;
+        }
+        return true;
+    }
+
+    /**
+     * Decompresses the block. Never reads or writes outside of the buffers, even if the block is corrupted.
+     *
+     * @param data compressed block
+     * @param size size of the block
+     * @param out output buffer
+     * @param out_size exact size of the decompressed data
+     * @return true if the block is valid and has exactly out_size bytes
+     */
+    static bool decompress(IN const u8* const data, IN const size_t size, OUT u8* const out, IN const size_t out_size) {
+        const u8* in = data;
+        const u8* const in_end = data + size;
+        u8* op = out;
+        u8* const out_end = out + out_size;
+
+        while (in < in_end) {
+            const u8 token = *in++;
+            size_t literals = token >> 4;
+            if (literals == 15 && !read_length_(in, in_end, literals)) return false;
+            if (literals > static_cast<size_t>(in_end - in) || literals > static_cast<size_t>(out_end - op)) return false;
+
+            // Copying 8 bytes at a time can go past the literals, but not past the buffers
+            if (static_cast<size_t>(in_end - in) >= literals + 8 && static_cast<size_t>(out_end - op) >= literals + 8) {
+                for (size_t i = 0; i < literals; i += 8) std::memcpy(op + i, in + i, 8);
+            } else if (literals != 0) {
+                std::memcpy(op, in, literals);
+            }
+            in += literals;
+            op += literals;
+            if (in == in_end) break;
+
+            if (in_end - in < 2) return false;
+            const size_t offset = in[0] | (static_cast<size_t>(in[1]) << 8);
+            in += 2;
+            if (offset == 0 || offset > static_cast<size_t>(op - out)) return false;
+
+            size_t length = token & 15;
+            if (length == 15 && !read_length_(in, in_end, length)) return false;
+            length += MIN_MATCH;
+            if (length > static_cast<size_t>(out_end - op)) return false;
+
+            const u8* match = op - offset;
+            if (offset >= 8 && static_cast<size_t>(out_end - op) >= length + 8) {
+                for (size_t i = 0; i < length; i += 8) std::memcpy(op + i, match + i, 8);
+            } else {
+                // Overlapping match repeats the last bytes
+                for (size_t i = 0; i < length; i++) op[i] = match[i];
+            }
+            op += length;
+        }
+        return op == out_end;
+    }
+
+}
+
+#endif //UTILITIES_LZ_H
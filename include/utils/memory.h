@@ -1,9 +1,25 @@
 #ifndef UTILITIES_MEMORY_H
 #define UTILITIES_MEMORY_H
 
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <utility>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <memory_resource>
 #include "types.h"
 #include "markers.h"
 
+#ifdef POSIX
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
 namespace allocator {
 
     struct stack {
@@ -26,12 +42,22 @@ namespace allocator {
             size = buffer_size;
         }
 
-        status allocate(IN const size_t n, OUT void** pointer) {
-            if (head + n > size) {
+        /**
+         * Allocates n bytes on top of the stack
+         *
+         * @param n amount of bytes
+         * @param pointer start of the allocated block
+         * @param alignment alignment of the block (power of 2)
+         * @return status of the operation
+         */
+        status allocate(IN const size_t n, OUT void** pointer, IN const size_t alignment = 1) {
+            const uintptr_t address = reinterpret_cast<uintptr_t>(data + head);
+            const size_t padding = (alignment - address % alignment) % alignment;
+            if (head + padding + n > size) {
                 return status::NOT_ENOUGH_SPACE;
             }
-            head += n;
-            *pointer = data + head;
+            *pointer = data + head + padding;
+            head += padding + n;
             return status::SUCCESS;
         }
 
@@ -49,12 +75,914 @@ namespace allocator {
         }
 
         // Removes data from the beggining of the stack
-        // this will end up performing full copy
+        // this will end up performing full copy (use ring to avoid it)
         void clear_start(const size_t bytes_to_remove) {
+            std::memmove(data, data + bytes_to_remove, head - bytes_to_remove);
             head -= bytes_to_remove;
-            for (size_t i = bytes_to_remove; i < size; i++) {
-                data[i - bytes_to_remove] = data[i];
+        }
+
+    };
+
+    /**
+     * Ring buffer which maps the same memory twice back-to-back, so both
+     * readable and writable regions are always continuous and removing data
+     * from the start of the buffer doesn't copy anything.
+     *
+     * Capacity is rounded up to the page size.
+     */
+    struct ring {
+
+        u8* data = nullptr;
+        // Size of one mapping in bytes
+        size_t capacity = 0;
+        // Position of the first readable byte (always less than capacity)
+        size_t start = 0;
+        // Amount of readable bytes
+        size_t length = 0;
+
+        enum struct status {
+            SUCCESS,
+            NOT_ENOUGH_SPACE,
+            MAPPING_FAILED,
+            NOT_IMPLEMENTED,
+        };
+
+        ring() {}
+
+        ring(const ring&) =delete;
+        ring& operator=(const ring&) =delete;
+
+        ring(ring&& other) noexcept {
+            swap(other);
+        }
+
+        ring& operator=(ring&& other) noexcept {
+            swap(other);
+            return *this;
+        }
+
+        void swap(ring& other) noexcept {
+            std::swap(data, other.data);
+            std::swap(capacity, other.capacity);
+            std::swap(start, other.start);
+            std::swap(length, other.length);
+        }
+
+        /**
+         * Creates ring buffer
+         *
+         * @param min_capacity minimum capacity of the buffer in bytes
+         * @param result created buffer
+         * @return status of the operation
+         */
+        static status create(IN const size_t min_capacity, OUT ring* const result) {
+            #ifdef POSIX
+            const size_t page = sysconf(_SC_PAGESIZE);
+            const size_t capacity = (min_capacity + page - 1) / page * page;
+            if (capacity == 0) return status::MAPPING_FAILED;
+
+            #ifdef __linux__
+            const fd_t fd = memfd_create("allocator::ring", MFD_CLOEXEC);
+            #else
+            char name[64]{};
+            snprintf(name, sizeof(name), "/allocator.ring.%d.%p", getpid(), (void*)result);
+            const fd_t fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+            if (fd != -1) shm_unlink(name);
+            #endif
+            if (fd == -1) return status::MAPPING_FAILED;
+            if (ftruncate(fd, capacity) != 0) {
+                close(fd);
+                return status::MAPPING_FAILED;
+            }
+
+            // Reserve continuous range for both mappings, then put the file twice over it
+            void* const base = ::mmap(nullptr, 2 * capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (base == MAP_FAILED) {
+                close(fd);
+                return status::MAPPING_FAILED;
+            }
+            u8* const bytes = static_cast<u8*>(base);
+            const void* const first = ::mmap(bytes, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+            const void* const second = ::mmap(bytes + capacity, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+            close(fd);
+            if (first == MAP_FAILED || second == MAP_FAILED) {
+                munmap(base, 2 * capacity);
+                return status::MAPPING_FAILED;
+            }
+
+            ring r{};
+            r.data = bytes;
+            r.capacity = capacity;
+            *result = std::move(r);
+            return status::SUCCESS;
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        // Continuous region with all readable bytes
+        u8* read_ptr() const {
+            return data + start;
+        }
+
+        size_t readable() const {
+            return length;
+        }
+
+        // Continuous region where new data can be written, call commit() after writing
+        u8* write_ptr() const {
+            return data + start + length;
+        }
+
+        size_t writable() const {
+            return capacity - length;
+        }
+
+        /**
+         * Makes bytes written to write_ptr() readable
+         *
+         * @param n amount of written bytes
+         * @return status of the operation
+         */
+        status commit(const size_t n) {
+            if (n > writable()) return status::NOT_ENOUGH_SPACE;
+            length += n;
+            return status::SUCCESS;
+        }
+
+        /**
+         * Copies bytes to the end of the buffer
+         *
+         * @param bytes data to copy
+         * @param n amount of bytes
+         * @return status of the operation
+         */
+        status write(IN const void* const bytes, const size_t n) {
+            if (n > writable()) return status::NOT_ENOUGH_SPACE;
+            std::memcpy(write_ptr(), bytes, n);
+            length += n;
+            return status::SUCCESS;
+        }
+
+        // Removes data from the beginning of the buffer without copying
+        void consume(const size_t n) {
+            length -= n;
+            start += n;
+            if (start >= capacity) start -= capacity;
+        }
+
+        bool is_empty() const {
+            return length == 0;
+        }
+
+        void clear() {
+            start = 0;
+            length = 0;
+        }
+
+        ~ring() {
+            #ifdef POSIX
+            if (data != nullptr) munmap(data, 2 * capacity);
+            #endif
+        }
+
+    };
+
+    /**
+     * Allocator of fixed-size blocks. Free blocks are kept in an intrusive list,
+     * so both allocation and freeing are O(1) and can happen in any order.
+     * Memory is requested from the system in large chunks and returned only on destruction.
+     *
+     * allocate() and free() are thread-safe. free() never takes the lock, so blocks
+     * can be freed from any thread. Threads which allocate a lot should use pool::cache.
+     */
+    struct pool {
+
+        enum struct status {
+            SUCCESS,
+            NOT_ENOUGH_SPACE,
+        };
+
+    private:
+
+        struct block {
+            block* next;
+        };
+
+        struct chunk {
+            chunk* next;
+            size_t size;
+        };
+
+        static constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+        static constexpr size_t CHUNK_HEADER = (sizeof(chunk) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+        size_t block_size_ = 0;
+        size_t chunk_size_ = 0;
+
+        std::mutex mutex_{};
+        // Everything below is protected by the mutex
+        block* free_ = nullptr;
+        chunk* chunks_ = nullptr;
+        u8* bump_ = nullptr;
+        u8* bump_end_ = nullptr;
+
+        // Blocks freed with free(), they are moved to free_ all at once under the lock
+        std::atomic<block*> remote_{ nullptr };
+
+        block* take_locked_() {
+            if (free_ == nullptr) {
+                free_ = remote_.exchange(nullptr, std::memory_order_acquire);
+            }
+            if (free_ != nullptr) {
+                block* const b = free_;
+                free_ = b->next;
+                return b;
+            }
+            if (bump_ == bump_end_ && !grow_locked_()) {
+                return nullptr;
+            }
+            block* const b = reinterpret_cast<block*>(bump_);
+            bump_ += block_size_;
+            return b;
+        }
+
+        bool grow_locked_() {
+            #ifdef POSIX
+            void* const memory = ::mmap(nullptr, chunk_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED) return false;
+            #else
+            void* const memory = std::malloc(chunk_size_);
+            if (memory == nullptr) return false;
+            #endif
+            chunk* const c = static_cast<chunk*>(memory);
+            c->next = chunks_;
+            c->size = chunk_size_;
+            chunks_ = c;
+
+            const size_t blocks = (chunk_size_ - CHUNK_HEADER) / block_size_;
+            bump_ = static_cast<u8*>(memory) + CHUNK_HEADER;
+            bump_end_ = bump_ + blocks * block_size_;
+            return true;
+        }
+
+    public:
+
+        /**
+         * @param block_size size of every block in bytes
+         * @param chunk_size size of memory requested from the system at once (rounded up to the page size)
+         */
+        explicit pool(const size_t block_size, const size_t chunk_size = 2 * MB) {
+            block_size_ = (std::max(block_size, sizeof(block)) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+            #ifdef POSIX
+            const size_t page = sysconf(_SC_PAGESIZE);
+            #else
+            const size_t page = 4 * KB;
+            #endif
+            const size_t min_chunk = CHUNK_HEADER + block_size_;
+            chunk_size_ = (std::max(chunk_size, min_chunk) + page - 1) / page * page;
+        }
+
+        pool(const pool&) =delete;
+        pool& operator=(const pool&) =delete;
+
+        size_t block_size() const {
+            return block_size_;
+        }
+
+        /**
+         * Allocates one block
+         *
+         * @param pointer allocated block
+         * @return status of the operation
+         */
+        status allocate(OUT void** const pointer) {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            block* const b = take_locked_();
+            if (b == nullptr) return status::NOT_ENOUGH_SPACE;
+            *pointer = b;
+            return status::SUCCESS;
+        }
+
+        /**
+         * Returns the block to the pool. Can be called from any thread.
+         *
+         * @param pointer block allocated from this pool
+         */
+        void free(void* const pointer) {
+            block* const b = static_cast<block*>(pointer);
+            b->next = remote_.load(std::memory_order_relaxed);
+            while (!remote_.compare_exchange_weak(b->next, b, std::memory_order_release, std::memory_order_relaxed)) {}
+        }
+
+        /**
+         * Per-thread cache of free blocks. Allocation and freeing through the cache
+         * don't use any synchronization until the cache has to be refilled from the pool
+         * or gives part of its blocks back. Blocks can be freed through any cache or
+         * the pool itself, no matter where they were allocated.
+         * Must be destroyed before the pool.
+         */
+        struct cache {
+        private:
+            pool* pool_ = nullptr;
+            block* free_ = nullptr;
+            size_t size_ = 0;
+            size_t batch_ = 0;
+
+        public:
+
+            /**
+             * @param p pool to take blocks from
+             * @param batch amount of blocks taken from the pool at once
+             */
+            explicit cache(pool& p, const size_t batch = 64): pool_(&p), batch_(batch == 0 ? 1 : batch) {}
+
+            cache(const cache&) =delete;
+            cache& operator=(const cache&) =delete;
+
+            status allocate(OUT void** const pointer) {
+                if (free_ == nullptr) {
+                    std::lock_guard<std::mutex> lock{ pool_->mutex_ };
+                    for (size_t i = 0; i < batch_; i++) {
+                        block* const b = pool_->take_locked_();
+                        if (b == nullptr) break;
+                        b->next = free_;
+                        free_ = b;
+                        size_ += 1;
+                    }
+                    if (free_ == nullptr) return status::NOT_ENOUGH_SPACE;
+                }
+                block* const b = free_;
+                free_ = b->next;
+                size_ -= 1;
+                *pointer = b;
+                return status::SUCCESS;
             }
+
+            void free(void* const pointer) {
+                block* const b = static_cast<block*>(pointer);
+                b->next = free_;
+                free_ = b;
+                size_ += 1;
+
+                // Don't let one thread hold on to all the memory
+                if (size_ > 2 * batch_) release_(batch_);
+            }
+
+            ~cache() {
+                release_(size_);
+            }
+
+        private:
+
+            void release_(size_t n) {
+                if (n == 0) return;
+                block* const first = free_;
+                block* last = first;
+                for (size_t i = 1; i < n; i++) last = last->next;
+                free_ = last->next;
+                size_ -= n;
+
+                std::lock_guard<std::mutex> lock{ pool_->mutex_ };
+                last->next = pool_->free_;
+                pool_->free_ = first;
+            }
+        };
+
+        ~pool() {
+            while (chunks_ != nullptr) {
+                chunk* const next = chunks_->next;
+                #ifdef POSIX
+                munmap(chunks_, chunks_->size);
+                #else
+                std::free(chunks_);
+                #endif
+                chunks_ = next;
+            }
+        }
+
+    };
+
+    /**
+     * std::pmr::memory_resource on top of the stack allocator, so standard containers
+     * can allocate from it. Memory is freed only when the last allocation is freed
+     * or the stack is cleared. When the stack is full allocations go to the upstream
+     * resource (which throws std::bad_alloc by default).
+     */
+    struct stack_resource : std::pmr::memory_resource {
+    private:
+        stack* stack_ = nullptr;
+        std::pmr::memory_resource* upstream_ = nullptr;
+
+    public:
+
+        explicit stack_resource(stack& s, std::pmr::memory_resource* const upstream = std::pmr::null_memory_resource()):
+            stack_(&s), upstream_(upstream) {}
+
+    private:
+
+        void* do_allocate(const size_t bytes, const size_t alignment) override {
+            void* pointer = nullptr;
+            if (stack_->allocate(bytes, &pointer, alignment) != stack::status::SUCCESS) {
+                return upstream_->allocate(bytes, alignment);
+            }
+            return pointer;
+        }
+
+        void do_deallocate(void* const pointer, const size_t bytes, const size_t alignment) override {
+            u8* const p = static_cast<u8*>(pointer);
+            if (p < stack_->data || p >= stack_->data + stack_->size) {
+                upstream_->deallocate(pointer, bytes, alignment);
+            } else if (p + bytes == stack_->data + stack_->head) {
+                // Only the last allocation can be given back to the stack
+                stack_->head -= bytes;
+            }
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    /**
+     * Growable arena as a std::pmr::memory_resource. Individual deallocations do nothing,
+     * everything is freed at once with reset(). reset() keeps one chunk as big as all
+     * chunks together, so an arena reused for every frame/request stops requesting
+     * memory from the upstream after the first iteration.
+     */
+    struct arena_resource : std::pmr::memory_resource {
+    private:
+
+        struct chunk {
+            chunk* next;
+            size_t size;
+        };
+
+        static constexpr size_t HEADER = (sizeof(chunk) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+        std::pmr::memory_resource* upstream_ = nullptr;
+        chunk* chunks_ = nullptr;
+        u8* head_ = nullptr;
+        u8* end_ = nullptr;
+        size_t next_size_ = 0;
+
+        void grow_(const size_t bytes, const size_t alignment) {
+            size_t size = next_size_;
+            while (size < HEADER + bytes + alignment) size *= 2;
+            void* const memory = upstream_->allocate(size, alignof(std::max_align_t));
+
+            chunk* const c = static_cast<chunk*>(memory);
+            c->next = chunks_;
+            c->size = size;
+            chunks_ = c;
+            head_ = static_cast<u8*>(memory) + HEADER;
+            end_ = static_cast<u8*>(memory) + size;
+            next_size_ = size * 2;
+        }
+
+        void release_(chunk* c) {
+            while (c != nullptr) {
+                chunk* const next = c->next;
+                upstream_->deallocate(c, c->size, alignof(std::max_align_t));
+                c = next;
+            }
+        }
+
+    public:
+
+        /**
+         * @param initial_size size of the first chunk
+         * @param upstream resource where chunks are allocated
+         */
+        explicit arena_resource(const size_t initial_size = 64 * KB,
+                                std::pmr::memory_resource* const upstream = std::pmr::new_delete_resource()):
+            upstream_(upstream), next_size_(std::max<size_t>(initial_size, 2 * HEADER)) {}
+
+        arena_resource(const arena_resource&) =delete;
+        arena_resource& operator=(const arena_resource&) =delete;
+
+        /**
+         * Frees everything allocated from the arena. Containers which use
+         * the arena must not be used after that.
+         */
+        void reset() {
+            if (chunks_ == nullptr) return;
+
+            // Replace all chunks with one chunk big enough for everything
+            // that was allocated, so the next iteration fits into it
+            if (chunks_->next != nullptr) {
+                size_t total = 0;
+                for (chunk* c = chunks_; c != nullptr; c = c->next) total += c->size;
+                release();
+                next_size_ = total;
+                grow_(0, 1);
+            }
+            head_ = reinterpret_cast<u8*>(chunks_) + HEADER;
+        }
+
+        // Releases all memory back to the upstream resource
+        void release() {
+            release_(chunks_);
+            chunks_ = nullptr;
+            head_ = end_ = nullptr;
+        }
+
+        ~arena_resource() override {
+            release();
+        }
+
+    private:
+
+        void* do_allocate(const size_t bytes, const size_t alignment) override {
+            uintptr_t address = reinterpret_cast<uintptr_t>(head_);
+            uintptr_t aligned = (address + alignment - 1) / alignment * alignment;
+            if (head_ == nullptr || aligned + bytes > reinterpret_cast<uintptr_t>(end_)) {
+                grow_(bytes, alignment);
+                address = reinterpret_cast<uintptr_t>(head_);
+                aligned = (address + alignment - 1) / alignment * alignment;
+            }
+            head_ = reinterpret_cast<u8*>(aligned + bytes);
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        void do_deallocate(void*, size_t, size_t) override {}
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    /**
+     * Bump allocator over a large range of virtual memory. The whole range is reserved
+     * up front, but physical memory is committed only when allocations reach it, so
+     * the arena can grow up to the reserved size without moving anything.
+     *
+     * Allocations are freed by rolling back to a marker (see arena::scope) or with clear().
+     */
+    struct arena {
+
+        enum struct status {
+            SUCCESS,
+            NOT_ENOUGH_SPACE,
+            MAPPING_FAILED,
+            NOT_IMPLEMENTED,
+        };
+
+        enum struct pages {
+            // Regular pages
+            NORMAL,
+            // Ask the kernel to back the range with transparent huge pages
+            TRANSPARENT_HUGE,
+            // Explicit huge pages (MAP_HUGETLB), have to be reserved in the system
+            HUGETLB,
+        };
+
+        static constexpr size_t HUGE_PAGE = 2 * MB;
+
+    private:
+        u8* data_ = nullptr;
+        size_t reserved_ = 0;
+        size_t committed_ = 0;
+        size_t head_ = 0;
+        size_t high_water_ = 0;
+        size_t granularity_ = 0;
+
+        bool commit_(const size_t end) {
+            const size_t new_committed = std::min(reserved_, (end + granularity_ - 1) / granularity_ * granularity_);
+            #ifdef POSIX
+            if (mprotect(data_ + committed_, new_committed - committed_, PROT_READ | PROT_WRITE) != 0) {
+                return false;
+            }
+            #endif
+            committed_ = new_committed;
+            return true;
+        }
+
+    public:
+
+        arena() {}
+
+        arena(const arena&) =delete;
+        arena& operator=(const arena&) =delete;
+
+        arena(arena&& other) noexcept {
+            swap(other);
+        }
+
+        arena& operator=(arena&& other) noexcept {
+            swap(other);
+            return *this;
+        }
+
+        void swap(arena& other) noexcept {
+            std::swap(data_, other.data_);
+            std::swap(reserved_, other.reserved_);
+            std::swap(committed_, other.committed_);
+            std::swap(head_, other.head_);
+            std::swap(high_water_, other.high_water_);
+            std::swap(granularity_, other.granularity_);
+        }
+
+        /**
+         * Reserves virtual memory for the arena
+         *
+         * @param reserve maximum size of the arena in bytes
+         * @param result created arena
+         * @param mode which pages should back the arena
+         * @return status of the operation
+         */
+        static status create(IN const size_t reserve, OUT arena* const result, IN const pages mode = pages::NORMAL) {
+            #ifdef POSIX
+            const size_t page = sysconf(_SC_PAGESIZE);
+            const size_t granularity = mode == pages::NORMAL ? page : HUGE_PAGE;
+            const size_t size = (reserve + granularity - 1) / granularity * granularity;
+            if (size == 0) return status::MAPPING_FAILED;
+
+            i32 flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+            #ifdef MAP_HUGETLB
+            if (mode == pages::HUGETLB) flags |= MAP_HUGETLB;
+            #else
+            if (mode == pages::HUGETLB) return status::NOT_IMPLEMENTED;
+            #endif
+
+            void* const memory = ::mmap(nullptr, size, PROT_NONE, flags, -1, 0);
+            if (memory == MAP_FAILED) return status::MAPPING_FAILED;
+
+            #ifdef MADV_HUGEPAGE
+            // Only a hint, the arena works with regular pages if it's ignored
+            if (mode == pages::TRANSPARENT_HUGE) madvise(memory, size, MADV_HUGEPAGE);
+            #endif
+
+            arena a{};
+            a.data_ = static_cast<u8*>(memory);
+            a.reserved_ = size;
+            a.granularity_ = granularity;
+            *result = std::move(a);
+            return status::SUCCESS;
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        /**
+         * Allocates n bytes
+         *
+         * @param n amount of bytes
+         * @param pointer start of the allocated block
+         * @param alignment alignment of the block (power of 2)
+         * @return status of the operation
+         */
+        status allocate(IN const size_t n, OUT void** const pointer, IN const size_t alignment = alignof(std::max_align_t)) {
+            const size_t start = (head_ + alignment - 1) & ~(alignment - 1);
+            const size_t end = start + n;
+            if (end > reserved_ || end < start) return status::NOT_ENOUGH_SPACE;
+            if (end > committed_ && !commit_(end)) return status::MAPPING_FAILED;
+
+            head_ = end;
+            high_water_ = std::max(high_water_, head_);
+            *pointer = data_ + start;
+            return status::SUCCESS;
+        }
+
+        /**
+         * Allocates memory for n objects of type T (objects are not constructed)
+         *
+         * @param n amount of objects
+         * @return pointer to the memory or nullptr if there is no space
+         */
+        template <typename T>
+        T* allocate(const size_t n = 1) {
+            void* pointer = nullptr;
+            if (allocate(n * sizeof(T), &pointer, alignof(T)) != status::SUCCESS) return nullptr;
+            return static_cast<T*>(pointer);
+        }
+
+        // Current position of the arena, pass it to rollback() to free everything allocated after it
+        size_t mark() const {
+            return head_;
+        }
+
+        void rollback(const size_t marker) {
+            head_ = marker;
+        }
+
+        void clear() {
+            head_ = 0;
+        }
+
+        /**
+         * Returns committed memory after the current position back to the system
+         */
+        void trim() {
+            const size_t keep = (head_ + granularity_ - 1) / granularity_ * granularity_;
+            if (keep >= committed_) return;
+            #ifdef POSIX
+            madvise(data_ + keep, committed_ - keep, MADV_DONTNEED);
+            mprotect(data_ + keep, committed_ - keep, PROT_NONE);
+            #endif
+            committed_ = keep;
+        }
+
+        size_t used() const {
+            return head_;
+        }
+
+        size_t committed() const {
+            return committed_;
+        }
+
+        size_t reserved() const {
+            return reserved_;
+        }
+
+        // The largest amount of bytes which was ever used, useful to pick the size of the arena
+        size_t high_water() const {
+            return high_water_;
+        }
+
+        /**
+         * Frees everything allocated inside of the scope on destruction
+         */
+        struct scope {
+        private:
+            arena* arena_ = nullptr;
+            size_t marker_ = 0;
+
+        public:
+            explicit scope(arena& a): arena_(&a), marker_(a.mark()) {}
+
+            scope(const scope&) =delete;
+            scope& operator=(const scope&) =delete;
+
+            ~scope() {
+                arena_->rollback(marker_);
+            }
+        };
+
+        ~arena() {
+            #ifdef POSIX
+            if (data_ != nullptr) munmap(data_, reserved_);
+            #endif
+        }
+
+    };
+
+    /**
+     * Bump allocator which many threads can use at once. Every thread takes chunks of
+     * the shared range with one atomic fetch-add and then allocates inside of its chunk
+     * through concurrent_arena::local without any synchronization.
+     *
+     * The whole range is mapped up front, the system backs it with physical memory
+     * only when it's touched.
+     */
+    struct concurrent_arena {
+
+        enum struct status {
+            SUCCESS,
+            NOT_ENOUGH_SPACE,
+            MAPPING_FAILED,
+            NOT_IMPLEMENTED,
+        };
+
+    private:
+        u8* data_ = nullptr;
+        size_t size_ = 0;
+        size_t chunk_size_ = 0;
+        // Separate cache line, so threads taking chunks don't slow down readers of other fields
+        alignas(64) std::atomic<size_t> head_{ 0 };
+
+        u8* take_(const size_t n) {
+            const size_t start = head_.fetch_add(n, std::memory_order_relaxed);
+            if (start + n > size_ || start + n < start) return nullptr;
+            return data_ + start;
+        }
+
+    public:
+
+        concurrent_arena() {}
+
+        concurrent_arena(const concurrent_arena&) =delete;
+        concurrent_arena& operator=(const concurrent_arena&) =delete;
+
+        /**
+         * Creates the arena
+         *
+         * @param reserve maximum size of the arena in bytes
+         * @param result created arena (should not be used by other threads during the call)
+         * @param chunk_size amount of bytes every thread takes at once
+         * @return status of the operation
+         */
+        static status create(IN const size_t reserve, OUT concurrent_arena* const result, IN const size_t chunk_size = 64 * KB) {
+            #ifdef POSIX
+            if (reserve == 0) return status::MAPPING_FAILED;
+            void* const memory = ::mmap(nullptr, reserve, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (memory == MAP_FAILED) return status::MAPPING_FAILED;
+
+            result->destroy_();
+            result->data_ = static_cast<u8*>(memory);
+            result->size_ = reserve;
+            result->chunk_size_ = std::max<size_t>(chunk_size, alignof(std::max_align_t));
+            result->head_.store(0, std::memory_order_relaxed);
+            return status::SUCCESS;
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        /**
+         * Frees everything allocated from the arena. Must be called at a synchronization
+         * point when no thread allocates, and all local handles must be reset or recreated
+         * after it.
+         */
+        void reset() {
+            head_.store(0, std::memory_order_relaxed);
+        }
+
+        // Amount of bytes given to threads (including unused parts of their chunks)
+        size_t used() const {
+            return std::min(head_.load(std::memory_order_relaxed), size_);
+        }
+
+        size_t reserved() const {
+            return size_;
+        }
+
+        /**
+         * Handle of a single thread. Should not be shared between threads.
+         */
+        struct local {
+        private:
+            concurrent_arena* arena_ = nullptr;
+            u8* head_ = nullptr;
+            u8* end_ = nullptr;
+
+        public:
+
+            explicit local(concurrent_arena& a): arena_(&a) {}
+
+            /**
+             * Allocates n bytes
+             *
+             * @param n amount of bytes
+             * @param pointer start of the allocated block
+             * @param alignment alignment of the block (power of 2)
+             * @return status of the operation
+             */
+            status allocate(IN const size_t n, OUT void** const pointer, IN const size_t alignment = alignof(std::max_align_t)) {
+                uintptr_t start = (reinterpret_cast<uintptr_t>(head_) + alignment - 1) & ~(alignment - 1);
+                if (head_ == nullptr || start + n > reinterpret_cast<uintptr_t>(end_)) {
+                    // Big allocations get their own range, so the current chunk is not wasted
+                    if (n + alignment > arena_->chunk_size_ / 4) {
+                        u8* const memory = arena_->take_(n + alignment);
+                        if (memory == nullptr) return status::NOT_ENOUGH_SPACE;
+                        start = (reinterpret_cast<uintptr_t>(memory) + alignment - 1) & ~(alignment - 1);
+                        *pointer = reinterpret_cast<void*>(start);
+                        return status::SUCCESS;
+                    }
+
+                    u8* const chunk = arena_->take_(arena_->chunk_size_);
+                    if (chunk == nullptr) return status::NOT_ENOUGH_SPACE;
+                    head_ = chunk;
+                    end_ = chunk + arena_->chunk_size_;
+                    start = (reinterpret_cast<uintptr_t>(head_) + alignment - 1) & ~(alignment - 1);
+                }
+                head_ = reinterpret_cast<u8*>(start + n);
+                *pointer = reinterpret_cast<void*>(start);
+                return status::SUCCESS;
+            }
+
+            /**
+             * Allocates memory for n objects of type T (objects are not constructed)
+             *
+             * @param n amount of objects
+             * @return pointer to the memory or nullptr if there is no space
+             */
+            template <typename T>
+            T* allocate(const size_t n = 1) {
+                void* pointer = nullptr;
+                if (allocate(n * sizeof(T), &pointer, alignof(T)) != status::SUCCESS) return nullptr;
+                return static_cast<T*>(pointer);
+            }
+
+            // Forgets the current chunk, call after concurrent_arena::reset()
+            void reset() {
+                head_ = nullptr;
+                end_ = nullptr;
+            }
+        };
+
+        ~concurrent_arena() {
+            destroy_();
+        }
+
+    private:
+
+        void destroy_() {
+            #ifdef POSIX
+            if (data_ != nullptr) munmap(data_, size_);
+            #endif
+            data_ = nullptr;
         }
 
     };
@@ -2,49 +2,637 @@
 #ifndef PROTO_H
 #define PROTO_H
 
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <functional>
 #include "memory.h"
+#include "system.h"
+#include "bits.h"
+#include "lz.h"
 
 /**
 Simple protocol over TCP/IP that defines the notion
 of messages which can be exchanges between 2 machines over the network.
+
+Every message is sent as a frame:
+  varint  size of the payload
+  u8      type of the message
+  varint  correlation id (0 if the message is not a request or a reply) << 2 | flags
+  u8[]    payload
+
+Compressed payload is the varint size of the original payload followed by the lz block.
+Compression is used only if both sides offered it with offer_compression().
 */
 namespace proto1 {
 
+    // Maximum size of the frame header
+    constexpr size_t HEADER_MAX_SIZE = 2 * bits::VARINT_MAX_SIZE + 1;
+
+    // Flags of the frame which are stored in the lowest bits of the correlation id
+    constexpr u8 FLAG_COMPRESSED = 1;
+    // Message of the protocol itself, it's never returned to the user
+    constexpr u8 FLAG_CONTROL = 2;
+    constexpr u32 FLAG_BITS = 2;
+
+    // Features in the control message which every side sends to offer them
+    constexpr u8 FEATURE_COMPRESSION = 1;
+
+    /**
+     * Message which points directly into the receive buffer of the connection
+     */
+    struct message {
+        u8 type = 0;
+        // Reply has the same id as its request
+        u64 id = 0;
+        // FLAG_* of the frame (connection decompresses the payload before returning the message)
+        u8 flags = 0;
+        const u8* data = nullptr;
+        size_t size = 0;
+    };
+
+    /**
+     * Parses the frame at the beginning of the buffer
+     *
+     * @param data received bytes
+     * @param size amount of received bytes
+     * @param result message pointing into the data
+     * @param frame_size size of the whole frame
+     * @return SUCCESS, WOULD_BLOCK if the frame is not complete yet or INVALID_FORMAT
+     */
+    static sys::status parse_frame(IN const u8* const data,
+                                   IN const size_t size,
+                                   OUT message* const result,
+                                   OUT size_t* const frame_size) {
+        u64 payload_size = 0;
+        const size_t length_size = bits::read_varint(data, size, &payload_size);
+        if (length_size == 0) {
+            return size >= bits::VARINT_MAX_SIZE ? sys::status::INVALID_FORMAT : sys::status::WOULD_BLOCK;
+        }
+        if (size <= length_size) return sys::status::WOULD_BLOCK;
+
+        u64 id = 0;
+        const size_t id_offset = length_size + 1;
+        const size_t id_size = bits::read_varint(data + id_offset, size - id_offset, &id);
+        if (id_size == 0) {
+            return size - id_offset >= bits::VARINT_MAX_SIZE ? sys::status::INVALID_FORMAT : sys::status::WOULD_BLOCK;
+        }
+        const size_t header_size = id_offset + id_size;
+        if (size - header_size < payload_size) return sys::status::WOULD_BLOCK;
+
+        result->type = data[length_size];
+        result->id = id >> FLAG_BITS;
+        result->flags = static_cast<u8>(id & ((1u << FLAG_BITS) - 1));
+        result->data = data + header_size;
+        result->size = payload_size;
+        *frame_size = header_size + payload_size;
+        return sys::status::SUCCESS;
+    }
+
+    /**
+     * Writes the frame header
+     *
+     * @param type type of the message
+     * @param size size of the payload
+     * @param out output buffer of at least HEADER_MAX_SIZE bytes
+     * @param id correlation id (less than 2^62)
+     * @param flags FLAG_* of the frame
+     * @return size of the header
+     */
+    static size_t write_header(IN const u8 type,
+                               IN const size_t size,
+                               OUT u8* const out,
+                               IN const u64 id = 0,
+                               IN const u8 flags = 0) {
+        const size_t length_size = bits::write_varint(size, out);
+        out[length_size] = type;
+        return length_size + 1 + bits::write_varint(id << FLAG_BITS | flags, out + length_size + 1);
+    }
+
+    /**
+     * Counters of the outgoing messages, used to tune the batching
+     */
+    struct statistics {
+        u64 messages = 0;
+        u64 bytes = 0;
+        // Flushes which had something to send
+        u64 flushes = 0;
+        u64 syscalls = 0;
+
+        f64 messages_per_flush() const {
+            return flushes == 0 ? 0.0 : static_cast<f64>(messages) / flushes;
+        }
+
+        f64 bytes_per_syscall() const {
+            return syscalls == 0 ? 0.0 : static_cast<f64>(bytes) / syscalls;
+        }
+    };
+
+    /**
+     * Counters of the compression of one direction of the connection
+     */
+    struct compression_statistics {
+        // Messages which were big enough to be compressed
+        u64 messages = 0;
+        // Of them sent or received compressed
+        u64 compressed = 0;
+        // Payload bytes before compression and after it (the same for messages which weren't compressed)
+        u64 raw_bytes = 0;
+        u64 wire_bytes = 0;
+
+        f64 ratio() const {
+            return wire_bytes == 0 ? 1.0 : static_cast<f64>(raw_bytes) / wire_bytes;
+        }
+    };
+
     struct connection {
-        /* tcp_socket socket*/
 
-        allocator::stack message_buffer{};
+        using clock = std::chrono::steady_clock;
+
+        sys::socket::tcp_socket socket{};
+
+        // Queued messages are sent as soon as they take this many bytes
+        size_t batch_size = 64 * KB;
+        // Queued messages are sent by flush_if_due() when the oldest of them waits this long
+        std::chrono::microseconds batch_delay{ 100 };
+        // Smaller payloads are never compressed
+        size_t compression_threshold = 256;
+
+    private:
+        // Bytes at the beginning of the receive buffer which belong to already returned messages
+        size_t parsed_ = 0;
+        // When the oldest queued message was written
+        clock::time_point first_queued_{};
+        bool has_queued_ = false;
+        statistics statistics_{};
 
-        connection(u8* const buffer, const size_t buffer_size) {
-            message_buffer = allocator::stack{ buffer, buffer_size }; 
+        bool compression_offered_ = false;
+        bool peer_compression_ = false;
+        compression_statistics compressed_out_{};
+        compression_statistics compressed_in_{};
+        vec<u8> compression_buffer_{};
+        // Decompressed payloads of the returned messages, reused after clear_message()
+        vec<vec<u8>> inflated_{};
+        size_t inflated_used_ = 0;
+
+        sys::status handle_control_(const message& m) {
+            if (m.size < 1) return sys::status::INVALID_FORMAT;
+            peer_compression_ = (m.data[0] & FEATURE_COMPRESSION) != 0;
+            return sys::status::SUCCESS;
+        }
+
+        sys::status inflate_(message* const m) {
+            u64 original_size = 0;
+            const size_t length_size = bits::read_varint(m->data, m->size, &original_size);
+            // Format can't compress better than 1 to 255, so anything bigger is garbage
+            if (length_size == 0 || original_size > (m->size - length_size) * 255) return sys::status::INVALID_FORMAT;
+
+            if (inflated_used_ == inflated_.size()) inflated_.emplace_back();
+            vec<u8>& buffer = inflated_[inflated_used_++];
+            buffer.resize(original_size);
+            if (!lz::decompress(m->data + length_size, m->size - length_size, buffer.data(), buffer.size())) {
+                return sys::status::INVALID_FORMAT;
+            }
+            compressed_in_.messages += 1;
+            compressed_in_.compressed += 1;
+            compressed_in_.raw_bytes += original_size;
+            compressed_in_.wire_bytes += m->size;
+            m->data = buffer.data();
+            m->size = buffer.size();
+            m->flags &= ~FLAG_COMPRESSED;
+            return sys::status::SUCCESS;
+        }
+
+        sys::status begin_frame_(const u8 type, const size_t size, u8** const payload, const u64 id, const u8 flags) {
+            u8 header[HEADER_MAX_SIZE];
+            const size_t header_size = write_header(type, size, header, id, flags);
+            u8* frame = nullptr;
+            const sys::status s = socket.outgoing_buffer.append(header_size + size, &frame);
+            if (s != sys::status::SUCCESS) return s;
+            std::memcpy(frame, header, header_size);
+            *payload = frame + header_size;
+
+            if (!has_queued_) {
+                first_queued_ = clock::now();
+                has_queued_ = true;
+            }
+            statistics_.messages += 1;
+            return sys::status::SUCCESS;
+        }
+
+        sys::status write_frame_(const u8 type, const void* const data, const size_t size, const u64 id, const u8 flags) {
+            u8* payload = nullptr;
+            const sys::status s = begin_frame_(type, size, &payload, id, flags);
+            if (s != sys::status::SUCCESS) return s;
+            if (size != 0) std::memcpy(payload, data, size);
+            return end_message();
+        }
+
+        sys::status write_control_(const void* const data, const size_t size) {
+            const sys::status s = write_frame_(0, data, size, 0, FLAG_CONTROL);
+            return s == sys::status::WOULD_BLOCK ? sys::status::SUCCESS : s;
         }
 
-        // Call clear_message() after this call, otherwise
-        // the buffer for incoming messages will be full and will not be
-        // able to recieve any new message from the TCP socket
-        const u8* read_message() {
-            return message_buffer.data;
+    public:
+
+        connection() {}
+
+        explicit connection(sys::socket::tcp_socket s): socket(std::move(s)) {
+            // Messages are batched by the connection, waiting in the kernel only adds latency
+            socket.set_no_delay(true);
         }
 
-        void write_message(const u8* const message) {}
+        /**
+         * Gets the next complete message. Can be called several times to get all
+         * received messages, they stay valid until clear_message().
+         *
+         * @param result message pointing into the receive buffer
+         * @return SUCCESS, WOULD_BLOCK if there are no complete messages or INVALID_FORMAT
+         */
+        sys::status read_message(OUT message* const result) {
+            allocator::ring& buffer = socket.incoming_buffer;
+            while (true) {
+                size_t frame_size = 0;
+                const sys::status s = parse_frame(buffer.read_ptr() + parsed_, buffer.readable() - parsed_, result, &frame_size);
+                if (s == sys::status::WOULD_BLOCK && buffer.writable() == 0 && parsed_ == 0) {
+                    // Frame is bigger than the buffer, so it can never be received
+                    return sys::status::INVALID_FORMAT;
+                }
+                if (s != sys::status::SUCCESS) return s;
+                parsed_ += frame_size;
+
+                if (result->flags & FLAG_CONTROL) {
+                    const sys::status control_status = handle_control_(*result);
+                    if (control_status != sys::status::SUCCESS) return control_status;
+                    continue;
+                }
+                if (result->flags & FLAG_COMPRESSED) return inflate_(result);
+                if (result->size >= compression_threshold) {
+                    compressed_in_.messages += 1;
+                    compressed_in_.raw_bytes += result->size;
+                    compressed_in_.wire_bytes += result->size;
+                }
+                return sys::status::SUCCESS;
+            }
+        }
+
+        /**
+         * Tells the other side that this side can compress messages. Compression is used
+         * once both sides offered it. Both sides can always read compressed messages.
+         *
+         * @return status of the operation
+         */
+        sys::status offer_compression() {
+            compression_offered_ = true;
+            const u8 features = FEATURE_COMPRESSION;
+            return write_control_(&features, sizeof(features));
+        }
+
+        /**
+         * @param size size of the payload
+         * @return true if the payload of this size is going to be compressed
+         */
+        bool compresses(const size_t size) const {
+            return compression_offered_ && peer_compression_ && size >= compression_threshold;
+        }
+
+        const compression_statistics& compression_sent() const {
+            return compressed_out_;
+        }
+
+        const compression_statistics& compression_received() const {
+            return compressed_in_;
+        }
 
+        /**
+         * Queues the message. It's sent when the batch is full, on flush()
+         * or by flush_if_due() after batch_delay.
+         *
+         * @param type type of the message
+         * @param data payload
+         * @param size size of the payload
+         * @param id correlation id
+         * @return status of the operation (WOULD_BLOCK only means that the batch is not sent yet)
+         */
+        sys::status write_message(IN const u8 type, IN const void* const data, IN const size_t size, IN const u64 id = 0) {
+            if (compresses(size)) {
+                compressed_out_.messages += 1;
+                compressed_out_.raw_bytes += size;
+                compression_buffer_.resize(bits::VARINT_MAX_SIZE + lz::max_compressed_size(size));
+                const size_t length_size = bits::write_varint(size, compression_buffer_.data());
+                const size_t compressed_size = lz::compress(static_cast<const u8*>(data), size,
+                                                            compression_buffer_.data() + length_size,
+                                                            compression_buffer_.size() - length_size);
+                // Incompressible payloads are sent as is
+                if (compressed_size != 0 && length_size + compressed_size < size) {
+                    compressed_out_.compressed += 1;
+                    compressed_out_.wire_bytes += length_size + compressed_size;
+                    return write_frame_(type, compression_buffer_.data(), length_size + compressed_size, id, FLAG_COMPRESSED);
+                }
+                compressed_out_.wire_bytes += size;
+            }
+            return write_frame_(type, data, size, id, 0);
+        }
+
+        /**
+         * Queues the header of the message and reserves space for the payload, so it can be
+         * written directly into the send buffer. Should be followed by end_message().
+         *
+         * @param type type of the message
+         * @param size size of the payload
+         * @param payload space for the payload (valid until the next write)
+         * @param id correlation id
+         * @return status of the operation
+         */
+        sys::status begin_message(IN const u8 type, IN const size_t size, OUT u8** const payload, IN const u64 id = 0) {
+            return begin_frame_(type, size, payload, id, 0);
+        }
+
+        /**
+         * Finishes the message started by begin_message(), sends the batch if it's full
+         *
+         * @return status of the operation (WOULD_BLOCK only means that the batch is not sent yet)
+         */
+        sys::status end_message() {
+            if (socket.outgoing_buffer.queued() >= batch_size) return flush();
+            return sys::status::SUCCESS;
+        }
+
+        /**
+         * Sends all queued messages
+         *
+         * @return SUCCESS, WOULD_BLOCK if the socket is full (call again when it's writable) or error
+         */
+        sys::status flush() {
+            if (socket.outgoing_buffer.is_empty()) return sys::status::SUCCESS;
+            const size_t queued = socket.outgoing_buffer.queued();
+            u64 syscalls = 0;
+            #ifdef POSIX
+            const sys::status s = socket.outgoing_buffer.flush(socket.socket_fd, &syscalls);
+            #else
+            const sys::status s = sys::status::NOT_IMPLEMENTED;
+            #endif
+            statistics_.flushes += 1;
+            statistics_.syscalls += syscalls;
+            statistics_.bytes += queued - socket.outgoing_buffer.queued();
+            // Deadline is restarted for the rest, the socket will report when it's writable
+            if (s == sys::status::SUCCESS) has_queued_ = false;
+            else first_queued_ = clock::now();
+            return s;
+        }
+
+        /**
+         * Sends queued messages if the oldest of them waits longer than batch_delay
+         *
+         * @return status of the flush, SUCCESS if it's not needed
+         */
+        sys::status flush_if_due() {
+            if (!has_queued_ || clock::now() < flush_deadline()) return sys::status::SUCCESS;
+            return flush();
+        }
+
+        /**
+         * @return time when queued messages should be sent (can be used for a timer in the event loop)
+         */
+        clock::time_point flush_deadline() const {
+            return has_queued_ ? first_queued_ + batch_delay : clock::time_point::max();
+        }
+
+        const statistics& sent() const {
+            return statistics_;
+        }
+
+        // Frees the space of all messages returned by read_message()
         void clear_message() {
-            message_buffer.clear();
+            socket.clear(parsed_);
+            parsed_ = 0;
+            inflated_used_ = 0;
+        }
+
+        /**
+         * Reads available data from the socket
+         *
+         * @param state SUCCESS while the connection is open, CONNECTION_CLOSED or error otherwise
+         *              (messages received before that can still be read)
+         * @return true if there is at least one complete message
+         */
+        bool poll(OUT sys::status* const state = nullptr) {
+            socket.poll(state);
+            message m{};
+            size_t frame_size = 0;
+            allocator::ring& buffer = socket.incoming_buffer;
+            return parse_frame(buffer.read_ptr() + parsed_, buffer.readable() - parsed_, &m, &frame_size) == sys::status::SUCCESS;
         }
 
-        bool poll() {
-            if (!message_buffer.is_empty()) {
-                return true;
+    };
+
+    /**
+     * Coroutine which starts right away and destroys itself when it's finished.
+     * Used for request handlers which co_await replies.
+     */
+    struct task {
+        struct promise_type {
+            task get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+    struct reply {
+        sys::status status = sys::status::SUCCESS;
+        // Points into the receive buffer (or into the awaiter if the reply arrived before co_await),
+        // valid until the coroutine is suspended again
+        message content{};
+    };
+
+    /**
+     * Many requests in flight over a single connection. Every request gets a unique
+     * correlation id and the coroutine which awaits it is resumed when the reply
+     * with the same id arrives, so replies can come in any order. A reply which arrives
+     * before its request is awaited is kept until co_await.
+     */
+    struct multiplexer {
+
+        // Called for every message which is not a reply to our request (like requests of the other side)
+        using handler = std::function<void(const message&)>;
+
+        /**
+         * Result of request(), co_await it to get the reply
+         */
+        struct awaiter {
+            multiplexer* owner = nullptr;
+            u64 id = 0;
+            reply result{};
+            // Copy of the payload if the reply arrived before co_await
+            vec<u8> payload{};
+
+            // Request which failed to be queued or already has the reply completes right away
+            bool await_ready() {
+                return result.status != sys::status::SUCCESS || owner->take_arrived_(this);
             }
 
-            return false;
+            void await_suspend(const std::coroutine_handle<> handle) {
+                waiting& w = owner->pending_[id];
+                w.handle = handle;
+                w.result = &result;
+            }
+
+            reply await_resume() const {
+                return result;
+            }
+        };
+
+    private:
+        struct waiting {
+            // Set when the request is awaited
+            std::coroutine_handle<> handle{};
+            reply* result = nullptr;
+            // Reply which arrived before the request was awaited (receive buffer is reused, so the payload is copied)
+            bool arrived = false;
+            reply early{};
+            vec<u8> payload{};
+        };
+
+        connection* connection_ = nullptr;
+        handler handler_{};
+        umap<u64, waiting> pending_{};
+        u64 next_id_ = 1;
+
+    public:
+
+        explicit multiplexer(connection& c, handler h = nullptr): connection_(&c), handler_(std::move(h)) {}
 
-            // 1. Take buffer of the socket
-            // 2. Scan for a complete message
-            // 3. If message is present copy to current_message_buffer
-            // 4. Set message_is_present = true
+        multiplexer(const multiplexer&) =delete;
+        multiplexer& operator=(const multiplexer&) =delete;
+
+        /**
+         * Queues the request. Every request should be awaited exactly once, requests
+         * can be awaited in any order.
+         *
+         * @param type type of the message
+         * @param data payload
+         * @param size size of the payload
+         * @return awaitable reply
+         */
+        awaiter request(IN const u8 type, IN const void* const data, IN const size_t size) {
+            awaiter a{ .owner = this, .id = next_id_++ };
+            const sys::status s = connection_->write_message(type, data, size, a.id);
+            // WOULD_BLOCK means that the request is queued, the rest is sent when the socket is writable
+            if (s != sys::status::SUCCESS && s != sys::status::WOULD_BLOCK) a.result.status = s;
+            else pending_.emplace(a.id, waiting{});
+            return a;
+        }
+
+        /**
+         * Replies to the request of the other side
+         *
+         * @param request received request
+         * @param type type of the reply
+         * @param data payload
+         * @param size size of the payload
+         * @return status of the operation
+         */
+        sys::status respond(IN const message& request, IN const u8 type, IN const void* const data, IN const size_t size) {
+            return connection_->write_message(type, data, size, request.id);
         }
 
+        /**
+         * Reads the socket, resumes coroutines waiting for received replies and
+         * sends queued messages. Should be called when the socket is readable
+         * (READABLE in the event_loop).
+         *
+         * @return status of the connection: INVALID_FORMAT if the other side sent garbage,
+         *         CONNECTION_CLOSED or error if the connection is gone (waiting requests are failed with it)
+         */
+        sys::status dispatch() {
+            sys::status s = sys::status::SUCCESS;
+            sys::status socket_status = sys::status::SUCCESS;
+            bool was_full = false;
+            do {
+                connection_->poll(&socket_status);
+                message m{};
+                while ((s = connection_->read_message(&m)) == sys::status::SUCCESS) {
+                    const auto found = m.id == 0 ? pending_.end() : pending_.find(m.id);
+                    if (found == pending_.end()) {
+                        if (handler_) handler_(m);
+                        continue;
+                    }
+                    waiting& w = found->second;
+                    if (!w.handle) {
+                        w.payload.assign(m.data, m.data + m.size);
+                        w.early.content = m;
+                        w.early.content.data = w.payload.data();
+                        w.arrived = true;
+                        continue;
+                    }
+                    const std::coroutine_handle<> handle = w.handle;
+                    w.result->content = m;
+                    pending_.erase(found);
+                    handle.resume();
+                }
+                // Full buffer could leave data in the socket, which won't be reported again
+                was_full = connection_->socket.incoming_buffer.writable() == 0;
+                connection_->clear_message();
+            } while (s == sys::status::WOULD_BLOCK && was_full);
+            if (s != sys::status::WOULD_BLOCK) return s;
+            if (socket_status != sys::status::SUCCESS) {
+                // Replies can't arrive anymore
+                fail_all(socket_status);
+                return socket_status;
+            }
+
+            // Everything produced by handlers and resumed coroutines is sent together
+            const sys::status flush_status = connection_->flush();
+            return flush_status == sys::status::WOULD_BLOCK ? sys::status::SUCCESS : flush_status;
+        }
+
+        /**
+         * Resumes every waiting coroutine with the error, for example when the connection is closed
+         *
+         * @param error status returned to the coroutines
+         */
+        void fail_all(IN const sys::status error) {
+            umap<u64, waiting> failed{};
+            failed.swap(pending_);
+            // Requests which are not awaited yet get the error (or the reply they already have) on co_await
+            for (auto& [id, w] : failed) {
+                if (w.handle) continue;
+                if (!w.arrived) w.early.status = error;
+                w.arrived = true;
+                pending_.emplace(id, std::move(w));
+            }
+            for (auto& [id, w] : failed) {
+                if (!w.handle) continue;
+                w.result->status = error;
+                w.handle.resume();
+            }
+        }
+
+        // Amount of requests waiting for replies
+        size_t in_flight() const {
+            return std::count_if(pending_.begin(), pending_.end(), [](const auto& p) { return !p.second.arrived; });
+        }
+
+        ~multiplexer() {
+            // Resumed coroutines could use the multiplexer which is being destroyed, so they are destroyed instead
+            for (auto& [id, w] : pending_) {
+                if (w.handle) w.handle.destroy();
+            }
+        }
+
+    private:
+
+        bool take_arrived_(awaiter* const a) {
+            const auto found = pending_.find(a->id);
+            if (found == pending_.end() || !found->second.arrived) return false;
+            a->result = found->second.early;
+            // Moved buffer keeps its address, so the content still points to the payload
+            a->payload = std::move(found->second.payload);
+            pending_.erase(found);
+            return true;
+        }
     };
 
 }
@@ -0,0 +1,264 @@
+#ifndef UTILITIES_PROTO_SCHEMA_H
+#define UTILITIES_PROTO_SCHEMA_H
+
+#include <iterator>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "types.h"
+#include "markers.h"
+#include "bits.h"
+#include "proto.h"
+#include "complex/collections.h"
+
+/**
+Flat messages described by a compile-time schema. Payload is read in place
+from the receive buffer and written directly into the send buffer.
+
+Layout of the payload (little-endian, no padding):
+  fixed part   scalar fields in the order of declaration,
+               u32 offset + u32 count for every array field (offset table)
+  tail         elements of the arrays
+
+Example:
+  using update = proto1::schema<u32, f32, f32, proto1::array<u8>>;
+  enum update_field { ID, X, Y, NAME };
+
+  proto1::write_flat<update>(connection, TYPE, 0, id, x, y, name);
+
+  proto1::flat_view<update> v{};
+  if (proto1::flat_view<update>::open(message, &v) == sys::status::SUCCESS) v.get<X>();
+*/
+namespace proto1 {
+
+    /**
+     * Field with variable amount of elements
+     */
+    template <typename T>
+    struct array {
+        static_assert(std::is_arithmetic_v<T>, "only arrays of numbers are supported");
+        using element = T;
+    };
+
+    template <typename F>
+    struct field_traits {
+        static_assert(std::is_arithmetic_v<F>, "field should be a number or an array");
+        static constexpr bool IS_ARRAY = false;
+        static constexpr size_t SIZE = sizeof(F);
+    };
+
+    template <typename T>
+    struct field_traits<array<T>> {
+        static constexpr bool IS_ARRAY = true;
+        // Entry in the offset table
+        static constexpr size_t SIZE = 2 * sizeof(u32);
+    };
+
+    template <typename... F>
+    struct schema {
+        static constexpr size_t COUNT = sizeof...(F);
+
+        // Offset of every field in the fixed part, the last one is the size of the fixed part
+        static constexpr arr<size_t, COUNT + 1> OFFSETS = []() {
+            constexpr arr<size_t, COUNT> sizes{ field_traits<F>::SIZE... };
+            arr<size_t, COUNT + 1> offsets{};
+            for (size_t i = 0; i < COUNT; i++) offsets[i + 1] = offsets[i] + sizes[i];
+            return offsets;
+        }();
+
+        static constexpr size_t FIXED_SIZE = OFFSETS[COUNT];
+
+        template <size_t I>
+        using field = std::tuple_element_t<I, std::tuple<F...>>;
+    };
+
+    /**
+     * Elements of an array field inside of the message
+     */
+    template <typename T>
+    struct array_view {
+        const u8* data = nullptr;
+        u32 count = 0;
+
+        u32 size() const {
+            return count;
+        }
+
+        bool empty() const {
+            return count == 0;
+        }
+
+        T operator[](const u32 index) const {
+            return bits::load_le<T>(data + index * sizeof(T));
+        }
+
+        std::span<const u8> bytes() const {
+            return { data, count * sizeof(T) };
+        }
+
+        std::string_view as_string() const requires (sizeof(T) == 1) {
+            return { reinterpret_cast<const char*>(data), count };
+        }
+    };
+
+    /**
+     * Read-only access to the message in place. All offsets are validated once in open(),
+     * after that every field is a single load from the buffer.
+     */
+    template <typename S>
+    struct flat_view {
+    private:
+        const u8* data_ = nullptr;
+        size_t size_ = 0;
+
+        template <size_t I>
+        bool valid_array_() const {
+            using F = typename S::template field<I>;
+            if constexpr (field_traits<F>::IS_ARRAY) {
+                const u64 offset = bits::load_le<u32>(data_ + S::OFFSETS[I]);
+                const u64 count = bits::load_le<u32>(data_ + S::OFFSETS[I] + sizeof(u32));
+                return offset >= S::FIXED_SIZE && offset + count * sizeof(typename F::element) <= size_;
+            } else {
+                return true;
+            }
+        }
+
+    public:
+
+        /**
+         * Validates the payload
+         *
+         * @param data payload
+         * @param size size of the payload
+         * @param result view of the payload
+         * @return SUCCESS or INVALID_FORMAT if the payload doesn't match the schema
+         */
+        static sys::status open(IN const u8* const data, IN const size_t size, OUT flat_view* const result) {
+            if (size < S::FIXED_SIZE) return sys::status::INVALID_FORMAT;
+            flat_view v{};
+            v.data_ = data;
+            v.size_ = size;
+            const bool valid = [&]<size_t... I>(std::index_sequence<I...>) {
+                return (v.template valid_array_<I>() && ...);
+            }(std::make_index_sequence<S::COUNT>{});
+            if (!valid) return sys::status::INVALID_FORMAT;
+            *result = v;
+            return sys::status::SUCCESS;
+        }
+
+        static sys::status open(IN const message& m, OUT flat_view* const result) {
+            return open(m.data, m.size, result);
+        }
+
+        /**
+         * @tparam I index of the field
+         * @return value of the scalar field or array_view of the array field
+         */
+        template <size_t I>
+        auto get() const {
+            using F = typename S::template field<I>;
+            if constexpr (field_traits<F>::IS_ARRAY) {
+                const u32 offset = bits::load_le<u32>(data_ + S::OFFSETS[I]);
+                const u32 count = bits::load_le<u32>(data_ + S::OFFSETS[I] + sizeof(u32));
+                return array_view<typename F::element>{ data_ + offset, count };
+            } else {
+                return bits::load_le<F>(data_ + S::OFFSETS[I]);
+            }
+        }
+
+        size_t size() const {
+            return size_;
+        }
+    };
+
+    // Bytes of the array value (vec, span, string or anything with std::data and std::size)
+    template <typename F, typename V>
+    size_t flat_extra_size_(const V& value) {
+        if constexpr (field_traits<F>::IS_ARRAY) {
+            return std::size(value) * sizeof(typename F::element);
+        } else {
+            return 0;
+        }
+    }
+
+    template <typename F, typename V>
+    void flat_store_(const V& value, u8* const out, const size_t field_offset, size_t& tail) {
+        if constexpr (field_traits<F>::IS_ARRAY) {
+            using E = typename F::element;
+            using A = std::remove_cv_t<std::remove_reference_t<decltype(*std::data(value))>>;
+            static_assert(sizeof(A) == sizeof(E) && std::is_arithmetic_v<A>, "array value doesn't match the field");
+            const size_t count = std::size(value);
+            bits::store_le<u32>(static_cast<u32>(tail), out + field_offset);
+            bits::store_le<u32>(static_cast<u32>(count), out + field_offset + sizeof(u32));
+            const A* const elements = std::data(value);
+            if constexpr (std::endian::native == std::endian::little) {
+                if (count != 0) std::memcpy(out + tail, elements, count * sizeof(E));
+            } else {
+                for (size_t i = 0; i < count; i++) bits::store_le<E>(static_cast<E>(elements[i]), out + tail + i * sizeof(E));
+            }
+            tail += count * sizeof(E);
+        } else {
+            bits::store_le<F>(static_cast<F>(value), out + field_offset);
+        }
+    }
+
+    /**
+     * @param values values of all fields in the order of the schema
+     * @return size of the encoded payload
+     */
+    template <typename S, typename... V>
+    size_t encoded_size(const V&... values) {
+        static_assert(sizeof...(V) == S::COUNT, "value should be provided for every field");
+        return [&]<size_t... I>(std::index_sequence<I...>) {
+            return S::FIXED_SIZE + (flat_extra_size_<typename S::template field<I>>(values) + ... + 0);
+        }(std::make_index_sequence<S::COUNT>{});
+    }
+
+    /**
+     * Encodes the payload
+     *
+     * @param out output buffer of at least encoded_size() bytes
+     * @param values values of all fields in the order of the schema
+     * @return size of the encoded payload
+     */
+    template <typename S, typename... V>
+    size_t encode(OUT u8* const out, IN const V&... values) {
+        static_assert(sizeof...(V) == S::COUNT, "value should be provided for every field");
+        size_t tail = S::FIXED_SIZE;
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            (flat_store_<typename S::template field<I>>(values, out, S::OFFSETS[I], tail), ...);
+        }(std::make_index_sequence<S::COUNT>{});
+        return tail;
+    }
+
+    /**
+     * Encodes the message directly into the send buffer of the connection
+     *
+     * @param c connection
+     * @param type type of the message
+     * @param id correlation id
+     * @param values values of all fields in the order of the schema
+     * @return status of the operation (see connection::write_message())
+     */
+    template <typename S, typename... V>
+    sys::status write_flat(connection& c, IN const u8 type, IN const u64 id, IN const V&... values) {
+        const size_t size = encoded_size<S>(values...);
+        if (size > UINT32_MAX) return sys::status::INVALID_ARGUMENT;
+        if (c.compresses(size)) {
+            // Compressed message can't be encoded in place, because its size is not known yet
+            vec<u8> buffer(size);
+            encode<S>(buffer.data(), values...);
+            return c.write_message(type, buffer.data(), size, id);
+        }
+        u8* payload = nullptr;
+        const sys::status s = c.begin_message(type, size, &payload, id);
+        if (s != sys::status::SUCCESS) return s;
+        encode<S>(payload, values...);
+        return c.end_message();
+    }
+
+}
+
+#endif //UTILITIES_PROTO_SCHEMA_H
@@ -0,0 +1,286 @@
+#ifndef UTILITIES_STREAM_H
+#define UTILITIES_STREAM_H
+
+#include <cstring>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <span>
+#include <string_view>
+#include "complex/collections.h"
+#include "types.h"
+#include "markers.h"
+#include "system.h"
+
+#ifdef POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Streaming reading of files which don't fit into memory.
+ */
+namespace sys::file {
+
+    /**
+     * Reads the file in fixed-size chunks. With readahead enabled a background thread
+     * reads the next chunk while the current one is processed (double buffering),
+     * so memory usage is always 2 chunks no matter how big the file is.
+     */
+    struct chunk_reader {
+    private:
+        #ifdef POSIX
+        fd_t fd_ = -1;
+        #endif
+        size_t chunk_size_ = 0;
+        bool readahead_ = false;
+        vec<u8> buffers_[2]{};
+        // Buffer which is handed out to the user
+        u32 current_ = 1;
+        bool started_ = false;
+        // Last handed out chunk was not full, so there is nothing left to read
+        bool end_ = false;
+
+        std::mutex mutex_{};
+        std::condition_variable changed_{};
+        std::thread thread_{};
+        // Everything below is protected by the mutex
+        i32 to_fill_ = -1;
+        bool ready_[2]{};
+        size_t sizes_[2]{};
+        status error_ = status::SUCCESS;
+        bool stop_ = false;
+
+        // Reads until the buffer is full or the file ends
+        status fill_(const u32 buffer, OUT size_t* const size) {
+            #ifdef POSIX
+            u8* const data = buffers_[buffer].data();
+            size_t filled = 0;
+            while (filled < chunk_size_) {
+                const ssize_t r = ::read(fd_, data + filled, chunk_size_ - filled);
+                if (r == -1 && errno == EINTR) continue;
+                if (r == -1) return process_error();
+                if (r == 0) break;
+                filled += r;
+            }
+            *size = filled;
+            return status::SUCCESS;
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        void work_() {
+            std::unique_lock<std::mutex> lock{ mutex_ };
+            while (true) {
+                changed_.wait(lock, [&]() { return stop_ || to_fill_ != -1; });
+                if (stop_) return;
+                const u32 buffer = to_fill_;
+
+                lock.unlock();
+                size_t size = 0;
+                const status s = fill_(buffer, &size);
+                lock.lock();
+
+                sizes_[buffer] = size;
+                if (s != status::SUCCESS) error_ = s;
+                ready_[buffer] = true;
+                to_fill_ = -1;
+                changed_.notify_all();
+            }
+        }
+
+        void request_fill_locked_(const u32 buffer) {
+            ready_[buffer] = false;
+            to_fill_ = buffer;
+        }
+
+    public:
+
+        chunk_reader() {}
+
+        chunk_reader(const chunk_reader&) =delete;
+        chunk_reader& operator=(const chunk_reader&) =delete;
+
+        /**
+         * Opens the file for streaming
+         *
+         * @param path path to the file
+         * @param result reader to initialize (should not be initialized already)
+         * @param chunk_size size of every chunk in bytes
+         * @param readahead read the next chunk on a background thread
+         * @return status of the operation
+         */
+        static status open(IN const char* const path,
+                           OUT chunk_reader* const result,
+                           IN const size_t chunk_size = 4 * MB,
+                           IN const bool readahead = true) {
+            #ifdef POSIX
+            if (chunk_size == 0) return status::INVALID_ARGUMENT;
+            const fd_t fd = ::open(path, O_RDONLY | O_CLOEXEC);
+            if (fd == -1) return process_error();
+
+            #ifdef POSIX_FADV_SEQUENTIAL
+            // Lets the kernel use bigger readahead for this file
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            #endif
+
+            result->fd_ = fd;
+            result->chunk_size_ = chunk_size;
+            result->readahead_ = readahead;
+            result->buffers_[0].resize(chunk_size);
+            if (readahead) {
+                result->buffers_[1].resize(chunk_size);
+                // Start reading the first chunk right away
+                result->request_fill_locked_(0);
+                result->thread_ = std::thread([result]() { result->work_(); });
+            }
+            return status::SUCCESS;
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        /**
+         * Gets the next chunk of the file. Data of the previous chunk is not valid after this call.
+         *
+         * @param chunk next chunk (empty if the end of the file is reached)
+         * @return status of the operation
+         */
+        status next(OUT std::span<const u8>* const chunk) {
+            if (end_) {
+                *chunk = {};
+                return status::SUCCESS;
+            }
+            if (!readahead_) {
+                #if defined(POSIX) && defined(POSIX_FADV_WILLNEED)
+                const off_t position = lseek(fd_, 0, SEEK_CUR);
+                if (position != -1) posix_fadvise(fd_, position + chunk_size_, chunk_size_, POSIX_FADV_WILLNEED);
+                #endif
+                size_t size = 0;
+                const status s = fill_(0, &size);
+                if (s != status::SUCCESS) return s;
+                end_ = size < chunk_size_;
+                *chunk = { buffers_[0].data(), size };
+                return status::SUCCESS;
+            }
+
+            std::unique_lock<std::mutex> lock{ mutex_ };
+            const u32 next_buffer = started_ ? current_ ^ 1 : 0;
+            changed_.wait(lock, [&]() { return ready_[next_buffer]; });
+            if (error_ != status::SUCCESS) return error_;
+
+            // The user is done with the previous buffer, so it can be filled with the chunk after this one
+            started_ = true;
+            current_ = next_buffer;
+            const size_t size = sizes_[current_];
+            end_ = size < chunk_size_;
+            if (!end_) {
+                request_fill_locked_(current_ ^ 1);
+                changed_.notify_all();
+            }
+            *chunk = { buffers_[current_].data(), size };
+            return status::SUCCESS;
+        }
+
+        size_t chunk_size() const {
+            return chunk_size_;
+        }
+
+        ~chunk_reader() {
+            {
+                std::lock_guard<std::mutex> lock{ mutex_ };
+                stop_ = true;
+            }
+            changed_.notify_all();
+            if (thread_.joinable()) thread_.join();
+            #ifdef POSIX
+            if (fd_ != -1) close(fd_);
+            #endif
+        }
+    };
+
+    /**
+     * Splits the stream of chunks into records separated by a delimiter (lines by default).
+     * Records are returned as views into the chunk. Only a record which crosses the
+     * border between 2 chunks is copied into an internal buffer.
+     */
+    struct record_reader {
+    private:
+        chunk_reader* reader_ = nullptr;
+        char delimiter_ = '\n';
+        std::span<const u8> chunk_{};
+        size_t position_ = 0;
+        // Beginning of the record which started in one of the previous chunks
+        str carry_{};
+        // Carry was returned to the user and should be cleared on the next call
+        bool carry_returned_ = false;
+        bool end_ = false;
+        status status_ = status::SUCCESS;
+
+    public:
+
+        explicit record_reader(chunk_reader& reader, const char delimiter = '\n'): reader_(&reader), delimiter_(delimiter) {}
+
+        /**
+         * Gets the next record without the delimiter. The view is valid until the next call.
+         * The last record doesn't need to end with the delimiter.
+         *
+         * @param record next record
+         * @return true if there is a record, false at the end of the file or on error
+         */
+        bool next(OUT std::string_view* const record) {
+            if (carry_returned_) {
+                carry_.clear();
+                carry_returned_ = false;
+            }
+
+            while (true) {
+                if (position_ < chunk_.size()) {
+                    const char* const begin = reinterpret_cast<const char*>(chunk_.data()) + position_;
+                    const size_t left = chunk_.size() - position_;
+                    const void* const found = std::memchr(begin, delimiter_, left);
+
+                    if (found == nullptr) {
+                        // Chunk is going to be replaced, so the tail has to be copied
+                        carry_.append(begin, left);
+                        position_ = chunk_.size();
+                    } else {
+                        const size_t length = static_cast<const char*>(found) - begin;
+                        position_ += length + 1;
+                        if (carry_.empty()) {
+                            *record = std::string_view{ begin, length };
+                        } else {
+                            carry_.append(begin, length);
+                            *record = carry_;
+                            carry_returned_ = true;
+                        }
+                        return true;
+                    }
+                }
+
+                if (end_) return false;
+                status_ = reader_->next(&chunk_);
+                position_ = 0;
+                if (status_ != status::SUCCESS || chunk_.empty()) {
+                    end_ = true;
+                    chunk_ = {};
+                    if (status_ != status::SUCCESS || carry_.empty()) return false;
+                    *record = carry_;
+                    carry_returned_ = true;
+                    return true;
+                }
+            }
+        }
+
+        /**
+         * @return status of the chunk reading (next() returns false on error as well)
+         */
+        status error() const {
+            return status_;
+        }
+    };
+
+}
+
+#endif //UTILITIES_STREAM_H
@@ -1,6 +1,12 @@
 #ifndef UTILITIES_SYSTEM_H
 #define UTILITIES_SYSTEM_H
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <span>
 #include "complex/collections.h"
 #include "types.h"
 #include "markers.h"
@@ -9,9 +15,23 @@
 #ifdef POSIX
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <fcntl.h>
 #include <netdb.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/uio.h>
+#endif
+
+#if defined(POSIX) && defined(__linux__)
+#define UTILITIES_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <linux/errqueue.h>
+#include <netinet/udp.h>
 #endif
 
 namespace sys {
@@ -21,7 +41,15 @@ namespace sys {
         ACCESS_DENIED,
         FILE_NOT_FOUND,
         CONNECTION_FAILED,
+        // The other side closed the connection
+        CONNECTION_CLOSED,
         RESOLVE_FAILED,
+        INVALID_FORMAT,
+        INVALID_ARGUMENT,
+        NOT_ENOUGH_SPACE,
+        // Non-blocking operation can't be completed right now, retry when the descriptor is ready
+        WOULD_BLOCK,
+        ADDRESS_IN_USE,
         UNKNOWN_ERROR,
         NOT_IMPLEMENTED,
     };
@@ -29,48 +57,425 @@ namespace sys {
 
     namespace socket {
 
+        #ifdef POSIX
+        static status process_error_() {
+            switch (errno) {
+                case EAGAIN: return status::WOULD_BLOCK;
+                case EACCES: return status::ACCESS_DENIED;
+                case ENOENT: return status::FILE_NOT_FOUND;
+                case EADDRINUSE: return status::ADDRESS_IN_USE;
+                case EMSGSIZE: return status::INVALID_ARGUMENT;
+                case ECONNREFUSED:
+                case ECONNRESET:
+                case ENETUNREACH:
+                case EHOSTUNREACH:
+                case ETIMEDOUT: return status::CONNECTION_FAILED;
+            }
+            return status::UNKNOWN_ERROR;
+        }
+
+        // Creates non-blocking socket which is not inherited by child processes
+        static fd_t open_(const addrinfo* const address) {
+            #ifdef SOCK_NONBLOCK
+            return ::socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+            #else
+            const fd_t fd = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (fd == -1) return -1;
+            const i32 flags = fcntl(fd, F_GETFL);
+            if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+                close(fd);
+                return -1;
+            }
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            return fd;
+            #endif
+        }
+
+        static status resolve_(const char* const host,
+                               const u16 port,
+                               const bool passive,
+                               OUT addrinfo** const result,
+                               const i32 type = SOCK_STREAM) {
+            addrinfo hints{};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = type;
+            hints.ai_flags = passive ? AI_PASSIVE : 0;
+            const str service = std::to_string(port);
+            if (getaddrinfo(host, service.c_str(), &hints, result) != 0) return status::RESOLVE_FAILED;
+            return status::SUCCESS;
+        }
+
+        static u16 port_(const sockaddr_storage& address) {
+            if (address.ss_family == AF_INET) return ntohs(reinterpret_cast<const sockaddr_in*>(&address)->sin_port);
+            if (address.ss_family == AF_INET6) return ntohs(reinterpret_cast<const sockaddr_in6*>(&address)->sin6_port);
+            return 0;
+        }
+        #endif
+
+        /**
+         * Queue of outgoing data of a socket. Queued buffers are sent with as few
+         * sendmsg calls as possible (up to IOV_LIMIT buffers per call). Written
+         * bytes are removed from the queue, the rest waits for the next flush.
+         */
+        struct outgoing_queue {
+
+            static constexpr u32 IOV_LIMIT = 64;
+            // Small copied writes are merged into one buffer up to this size
+            static constexpr size_t MERGE_LIMIT = 64 * KB;
+
+        private:
+            enum struct kind : u8 {
+                COPIED,
+                REFERENCED,
+                ZEROCOPY,
+            };
+
+            struct segment {
+                vec<u8> copy{};
+                const u8* data = nullptr;
+                size_t size = 0;
+                size_t sent = 0;
+                u64 id = 0;
+                kind type = kind::COPIED;
+
+                const u8* bytes() const {
+                    return type == kind::COPIED ? copy.data() : data;
+                }
+            };
+
+            std::deque<segment> segments_{};
+            size_t queued_ = 0;
+            vec<u64> completed_{};
+            bool zerocopy_ = false;
+
+            // Every successful MSG_ZEROCOPY call gets the next sequence number from the kernel,
+            // notifications report ranges of numbers which buffers are not used anymore
+            u32 zerocopy_calls_ = 0;
+            u32 zerocopy_done_ = 0;
+            vec<pair<u32, u32>> zerocopy_ranges_{};
+            // Fully sent zero-copy buffers waiting for notification: last sequence number and id
+            std::deque<pair<u32, u64>> zerocopy_pending_{};
+
+            void advance_(size_t bytes) {
+                queued_ -= bytes;
+                while (bytes != 0) {
+                    segment& front = segments_.front();
+                    const size_t taken = std::min(bytes, front.size - front.sent);
+                    front.sent += taken;
+                    bytes -= taken;
+                    if (front.sent != front.size) break;
+
+                    // Zero-copy buffer is free when the last call (which could use any part of it) completes
+                    if (front.type == kind::ZEROCOPY && zerocopy_calls_ != 0) {
+                        zerocopy_pending_.emplace_back(zerocopy_calls_ - 1, front.id);
+                    } else if (front.type != kind::COPIED) {
+                        completed_.emplace_back(front.id);
+                    }
+                    segments_.pop_front();
+                }
+            }
+
+            void release_zerocopy_() {
+                std::sort(zerocopy_ranges_.begin(), zerocopy_ranges_.end());
+                size_t merged = 0;
+                for (; merged < zerocopy_ranges_.size() && zerocopy_ranges_[merged].first <= zerocopy_done_; merged++) {
+                    zerocopy_done_ = std::max(zerocopy_done_, zerocopy_ranges_[merged].second + 1);
+                }
+                zerocopy_ranges_.erase(zerocopy_ranges_.begin(), zerocopy_ranges_.begin() + merged);
+
+                while (!zerocopy_pending_.empty() && zerocopy_pending_.front().first < zerocopy_done_) {
+                    completed_.emplace_back(zerocopy_pending_.front().second);
+                    zerocopy_pending_.pop_front();
+                }
+            }
+
+        public:
+
+            // Maximum amount of queued bytes, writes above it return NOT_ENOUGH_SPACE
+            size_t limit = 64 * MB;
+
+            /**
+             * Copies the data into the queue
+             *
+             * @param data bytes to send
+             * @param size amount of bytes
+             * @return SUCCESS or NOT_ENOUGH_SPACE if the queue is over the limit
+             */
+            status write(IN const void* const data, IN const size_t size) {
+                u8* destination = nullptr;
+                const status s = append(size, &destination);
+                if (s == status::SUCCESS && size != 0) std::memcpy(destination, data, size);
+                return s;
+            }
+
+            /**
+             * Reserves space at the end of the queue, so the data can be written there directly
+             *
+             * @param size amount of bytes
+             * @param data reserved space (valid until the next change of the queue)
+             * @return SUCCESS or NOT_ENOUGH_SPACE if the queue is over the limit
+             */
+            status append(IN const size_t size, OUT u8** const data) {
+                if (size == 0) return status::SUCCESS;
+                if (queued_ + size > limit) return status::NOT_ENOUGH_SPACE;
+                if (segments_.empty() || segments_.back().type != kind::COPIED || segments_.back().size + size > MERGE_LIMIT) {
+                    segments_.emplace_back();
+                }
+                segment& back = segments_.back();
+                back.copy.resize(back.size + size);
+                *data = back.copy.data() + back.size;
+                back.size += size;
+                queued_ += size;
+                return status::SUCCESS;
+            }
+
+            /**
+             * Queues the data without copying. The buffer should stay unchanged until its id is
+             * returned by take_completed(). Sent with MSG_ZEROCOPY if it's enabled.
+             *
+             * @param data bytes to send
+             * @param size amount of bytes
+             * @param id id which is reported when the buffer can be reused
+             * @return SUCCESS or NOT_ENOUGH_SPACE if the queue is over the limit
+             */
+            status write_zerocopy(IN const void* const data, IN const size_t size, IN const u64 id) {
+                if (queued_ + size > limit) return status::NOT_ENOUGH_SPACE;
+                if (size == 0) {
+                    completed_.emplace_back(id);
+                    return status::SUCCESS;
+                }
+                segments_.emplace_back(segment{
+                    .data = static_cast<const u8*>(data),
+                    .size = size,
+                    .id = id,
+                    .type = zerocopy_ ? kind::ZEROCOPY : kind::REFERENCED });
+                queued_ += size;
+                return status::SUCCESS;
+            }
+
+            /**
+             * Sends queued data until everything is sent or the socket is full
+             *
+             * @param fd socket
+             * @param syscalls amount of performed sendmsg calls is added here
+             * @return SUCCESS if the queue is empty, WOULD_BLOCK if the socket is full, error otherwise
+             */
+            status flush(IN const fd_t fd, OUT u64* const syscalls = nullptr) {
+                #ifdef POSIX
+                iovec vectors[IOV_LIMIT];
+                bool zerocopy_failed = false;
+                while (!segments_.empty()) {
+                    msghdr message{};
+                    message.msg_iov = vectors;
+                    i32 flags = 0;
+                    #ifdef MSG_NOSIGNAL
+                    flags |= MSG_NOSIGNAL;
+                    #endif
+
+                    // Zero-copy buffers are sent one per call, so every call maps to a single buffer
+                    const segment& front = segments_.front();
+                    const bool zerocopy_call = front.type == kind::ZEROCOPY && !zerocopy_failed;
+                    if (zerocopy_call) {
+                        #ifdef MSG_ZEROCOPY
+                        flags |= MSG_ZEROCOPY;
+                        #endif
+                        vectors[0] = { const_cast<u8*>(front.bytes()) + front.sent, front.size - front.sent };
+                        message.msg_iovlen = 1;
+                    } else {
+                        u32 count = 0;
+                        for (const segment& s : segments_) {
+                            if (count == IOV_LIMIT || (count != 0 && s.type == kind::ZEROCOPY)) break;
+                            vectors[count++] = { const_cast<u8*>(s.bytes()) + s.sent, s.size - s.sent };
+                        }
+                        message.msg_iovlen = count;
+                    }
+
+                    const ssize_t written = sendmsg(fd, &message, flags);
+                    if (syscalls != nullptr) *syscalls += 1;
+                    if (written == -1) {
+                        if (errno == EINTR) continue;
+                        // Out of memory for pinned pages, this buffer is sent as a regular one
+                        if (errno == ENOBUFS && zerocopy_call) {
+                            zerocopy_failed = true;
+                            continue;
+                        }
+                        return process_error_();
+                    }
+                    if (zerocopy_call) zerocopy_calls_ += 1;
+                    zerocopy_failed = false;
+                    advance_(written);
+                }
+                return status::SUCCESS;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            /**
+             * Turns on MSG_ZEROCOPY for buffers queued by write_zerocopy (Linux only).
+             * Completions are reported through the error queue of the socket (ERROR event in the event_loop).
+             *
+             * @param fd socket
+             * @return status of the operation, NOT_IMPLEMENTED if the system doesn't support it
+             */
+            status enable_zerocopy(IN const fd_t fd) {
+                #if defined(UTILITIES_EPOLL) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+                const i32 enable = 1;
+                if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) != 0) return status::NOT_IMPLEMENTED;
+                zerocopy_ = true;
+                return status::SUCCESS;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            /**
+             * Reads zero-copy notifications from the error queue of the socket
+             *
+             * @param fd socket
+             * @return status of the operation
+             */
+            status read_notifications(IN const fd_t fd) {
+                #if defined(UTILITIES_EPOLL) && defined(SO_EE_ORIGIN_ZEROCOPY)
+                if (!zerocopy_) return status::SUCCESS;
+                while (true) {
+                    u8 control[128];
+                    msghdr message{};
+                    message.msg_control = control;
+                    message.msg_controllen = sizeof(control);
+                    if (recvmsg(fd, &message, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+                        if (errno == EINTR) continue;
+                        if (errno == EAGAIN) break;
+                        return process_error_();
+                    }
+                    for (cmsghdr* c = CMSG_FIRSTHDR(&message); c != nullptr; c = CMSG_NXTHDR(&message, c)) {
+                        const bool ip = (c->cmsg_level == SOL_IP && c->cmsg_type == IP_RECVERR)
+                            || (c->cmsg_level == SOL_IPV6 && c->cmsg_type == IPV6_RECVERR);
+                        if (!ip) continue;
+                        sock_extended_err error{};
+                        std::memcpy(&error, CMSG_DATA(c), sizeof(error));
+                        if (error.ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+                        zerocopy_ranges_.emplace_back(error.ee_info, error.ee_data);
+                    }
+                }
+                release_zerocopy_();
+                #endif
+                return status::SUCCESS;
+            }
+
+            /**
+             * Moves ids of buffers from write_zerocopy which are not used by the system anymore
+             *
+             * @param ids ids are appended here
+             */
+            void take_completed(OUT vec<u64>* const ids) {
+                ids->insert(ids->end(), completed_.begin(), completed_.end());
+                completed_.clear();
+            }
+
+            size_t queued() const {
+                return queued_;
+            }
+
+            bool is_empty() const {
+                return segments_.empty();
+            }
+
+            // Zero-copy buffers which are sent, but still can be used by the system
+            size_t pending_zerocopy() const {
+                return zerocopy_pending_.size();
+            }
+        };
+
         struct tcp_socket {
 
             #ifdef POSIX
-            fd_t socket_fd{};
+            fd_t socket_fd = -1;
             #endif
 
-            allocator::stack incoming_buffer{};
+            allocator::ring incoming_buffer{};
+            outgoing_queue outgoing_buffer{};
 
-            static status create(
-                IN void* buffer, 
-                IN const size_t buffer_size, 
-                OUT tcp_socket* const socket) {
+            // False while the connection is being established, see finish_connect()
+            bool connected = false;
+
+            tcp_socket() {}
+
+            tcp_socket(const tcp_socket&) =delete;
+            tcp_socket& operator=(const tcp_socket&) =delete;
 
-                allocator::stack incoming_buffer{ buffer, buffer_size };
+            tcp_socket(tcp_socket&& other) noexcept {
+                #ifdef POSIX
+                std::swap(socket_fd, other.socket_fd);
+                #endif
+                incoming_buffer.swap(other.incoming_buffer);
+                std::swap(outgoing_buffer, other.outgoing_buffer);
+                std::swap(connected, other.connected);
+            }
 
+            tcp_socket& operator=(tcp_socket&& other) noexcept {
                 #ifdef POSIX
-                const fd_t socket_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+                std::swap(socket_fd, other.socket_fd);
+                #endif
+                incoming_buffer.swap(other.incoming_buffer);
+                std::swap(outgoing_buffer, other.outgoing_buffer);
+                std::swap(connected, other.connected);
+                return *this;
+            }
+
+            /**
+             * Starts connecting to the host without blocking. The socket is usable after
+             * finish_connect() returns SUCCESS (or when it becomes writable in the event_loop).
+             *
+             * @param host name or address of the host
+             * @param port port of the host
+             * @param buffer_size size of the buffer for incoming data
+             * @param socket socket which is connecting
+             * @return status of the operation
+             */
+            static status create(
+                IN const char* const host,
+                IN const u16 port,
+                IN const size_t buffer_size,
+                OUT tcp_socket* const socket) {
 
-                // Set to non blocking IO
-                i32 status = fcntl(socket_fd, F_GETFL);
-                if (status == -1) return status::UNKNOWN_ERROR;
-                status |= O_NONBLOCK;
-                const i32 fset_r = fcntl(socket_fd, F_SETFL, status);
-                if (fset_r == -1) return status::UNKNOWN_ERROR;
+                allocator::ring incoming_buffer{};
+                if (allocator::ring::create(buffer_size, &incoming_buffer) != allocator::ring::status::SUCCESS) {
+                    return status::UNKNOWN_ERROR;
+                }
 
-                // Resolve IP address
+                #ifdef POSIX
                 addrinfo* address_info = nullptr;
-                const i32 getaddr_r = getaddrinfo("www.google.com", "80", NULL, &address_info);
-                if (getaddr_r != 0) return status::RESOLVE_FAILED;
+                const status resolve_status = resolve_(host, port, false, &address_info);
+                if (resolve_status != status::SUCCESS) return resolve_status;
 
-                // Connect to the IP address
-                const i32 connect_r = connect(
-                    socket_fd, 
-                    address_info->ai_addr, 
-                    address_info->ai_addrlen);
-                if (connect_r != 0) return status::CONNECTION_FAILED;
+                // Try every resolved address until one of them accepts the connection attempt
+                status result = status::CONNECTION_FAILED;
+                for (const addrinfo* address = address_info; address != nullptr; address = address->ai_next) {
+                    const fd_t socket_fd = open_(address);
+                    if (socket_fd == -1) {
+                        result = process_error_();
+                        continue;
+                    }
 
-                freeaddrinfo(address_info);
+                    // Non-blocking connect returns EINPROGRESS while the handshake is in flight
+                    const i32 connect_r = connect(socket_fd, address->ai_addr, address->ai_addrlen);
+                    if (connect_r != 0 && errno != EINPROGRESS) {
+                        result = process_error_();
+                        close(socket_fd);
+                        continue;
+                    }
 
-                socket->socket_fd = socket_fd;
-                socket->incoming_buffer = incoming_buffer;
-                return status::SUCCESS;
+                    tcp_socket s{};
+                    s.socket_fd = socket_fd;
+                    s.incoming_buffer = std::move(incoming_buffer);
+                    s.connected = connect_r == 0;
+                    *socket = std::move(s);
+                    result = status::SUCCESS;
+                    break;
+                }
+                freeaddrinfo(address_info);
+                return result;
 
                 #else // POSIX
 
@@ -79,37 +484,150 @@ namespace sys {
                 #endif
             }
 
+            /**
+             * Checks if the connection is established
+             *
+             * @param timeout time to wait in milliseconds (0 to only check, -1 to wait until it's done)
+             * @return SUCCESS if connected, WOULD_BLOCK if it's still in progress, error otherwise
+             */
+            status finish_connect(IN const i32 timeout = 0) {
+                #ifdef POSIX
+                if (connected) return status::SUCCESS;
+                pollfd descriptor{ .fd = socket_fd, .events = POLLOUT, .revents = 0 };
+                i32 ready = 0;
+                do {
+                    ready = ::poll(&descriptor, 1, timeout);
+                } while (ready == -1 && errno == EINTR);
+                if (ready == -1) return process_error_();
+                if (ready == 0) return status::WOULD_BLOCK;
+
+                i32 error = 0;
+                socklen_t length = sizeof(error);
+                if (getsockopt(socket_fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0) return process_error_();
+                if (error != 0) {
+                    errno = error;
+                    const status s = process_error_();
+                    return s == status::UNKNOWN_ERROR ? status::CONNECTION_FAILED : s;
+                }
+                connected = true;
+                return status::SUCCESS;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
             // Call clear() after this call, otherwise incoming_buffer in the tcp_socket
             // will become full and will be unable to recieve new data
             size_t read(OUT u8** buffer) {
-                *buffer = incoming_buffer.data;
-                return incoming_buffer.head;
+                *buffer = incoming_buffer.read_ptr();
+                return incoming_buffer.readable();
             }
 
             void clear(const size_t bytes_read) {
-                incoming_buffer.clear_start(bytes_read);
+                incoming_buffer.consume(bytes_read);
+            }
+
+            /**
+             * Queues a copy of the data. Nothing is sent until flush()
+             *
+             * @param data bytes to send
+             * @param size amount of bytes
+             * @return SUCCESS or NOT_ENOUGH_SPACE if too much data is waiting to be sent
+             */
+            status write(IN const void* const data, IN const size_t size) {
+                return outgoing_buffer.write(data, size);
+            }
+
+            /**
+             * Queues the data without copying, see outgoing_queue::write_zerocopy()
+             */
+            status write_zerocopy(IN const void* const data, IN const size_t size, IN const u64 id) {
+                return outgoing_buffer.write_zerocopy(data, size, id);
+            }
+
+            /**
+             * Sends queued data. On WOULD_BLOCK call it again when the socket is writable.
+             *
+             * @return SUCCESS if everything is sent, WOULD_BLOCK if the socket is full, error otherwise
+             */
+            status flush() {
+                #ifdef POSIX
+                return outgoing_buffer.flush(socket_fd);
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            /**
+             * Turns off Nagle's algorithm, so small writes are sent right away instead of
+             * waiting for acknowledgements. Useful when writes are already batched.
+             *
+             * @param enable true to send without delay
+             * @return status of the operation
+             */
+            status set_no_delay(IN const bool enable) {
+                #ifdef POSIX
+                const i32 value = enable ? 1 : 0;
+                if (setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value)) != 0) return process_error_();
+                return status::SUCCESS;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
             }
 
-            void write(const void* const data) {}
+            status enable_zerocopy() {
+                #ifdef POSIX
+                return outgoing_buffer.enable_zerocopy(socket_fd);
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
 
-            bool poll() {
+            /**
+             * Gets ids of buffers from write_zerocopy() which can be reused
+             *
+             * @param ids ids are appended here
+             * @return status of the operation
+             */
+            status completed(OUT vec<u64>* const ids) {
                 #ifdef POSIX
+                const status s = outgoing_buffer.read_notifications(socket_fd);
+                outgoing_buffer.take_completed(ids);
+                return s;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
 
-                // make buffer for incoming data
-                void* read_buffer = nullptr;
-                incoming_buffer.allocate(1 * KB, &read_buffer);
+            /**
+             * Reads available data into the incoming buffer
+             *
+             * @param state SUCCESS while the connection is open, CONNECTION_CLOSED if the other side
+             *              closed it, or the error of the socket (data read before that is still in the buffer)
+             * @return true if the incoming buffer has data
+             */
+            bool poll(OUT status* const state = nullptr) {
+                if (state != nullptr) *state = status::SUCCESS;
+                #ifdef POSIX
 
-                // Read data
-                const size_t bytes_read = ::read(socket_fd, &read_buffer, 1 * KB);
-                if (bytes_read == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-                    // clear all allocated space
-                    incoming_buffer.free(1 * KB);
-                } else if (bytes_read != -1) {
-                    // clear free space
-                    incoming_buffer.free(1 * KB - bytes_read);
-                } else {
-                    // some other error happened
-                    incoming_buffer.free(1 * KB);
+                // Read directly into the free space of the ring buffer until the socket is drained,
+                // so it works with edge-triggered notifications of the event_loop. If the buffer
+                // becomes full, poll() should be called again after clear()
+                while (incoming_buffer.writable() != 0) {
+                    const ssize_t bytes_read = ::read(
+                        socket_fd,
+                        incoming_buffer.write_ptr(),
+                        incoming_buffer.writable());
+                    if (bytes_read == -1 && errno == EINTR) continue;
+                    if (bytes_read == 0) {
+                        if (state != nullptr) *state = status::CONNECTION_CLOSED;
+                        break;
+                    }
+                    if (bytes_read == -1) {
+                        if (state != nullptr && errno != EAGAIN && errno != EWOULDBLOCK) *state = process_error_();
+                        break;
+                    }
+                    incoming_buffer.commit(bytes_read);
                 }
                 #endif
 
@@ -120,57 +638,1695 @@ namespace sys {
 
             ~tcp_socket() {
                 #ifdef POSIX
-                close(socket_fd);
+                if (socket_fd != -1) close(socket_fd);
                 #endif
             }
 
         };
 
-    }
-
+        /**
+         * Listening socket which accepts incoming TCP connections without blocking
+         */
+        struct tcp_acceptor {
 
-    namespace file {
-    
-        static status process_error() {
             #ifdef POSIX
-            switch (errno) {
-                case EACCES: return status::ACCESS_DENIED;
-                case ENOENT: return status::FILE_NOT_FOUND;
-            }
-            return status::UNKNOWN_ERROR;
-            #else
-            return status::NOT_IMPLEMENTED;
+            fd_t socket_fd = -1;
             #endif
-        }
 
-        static status get_size(IN const char* const path, OUT size_t* size) {
-            #ifdef POSIX
-            struct stat stat_buf{};
-            const int status = stat(path, &stat_buf);
-            if (status != 0) {
-                return process_error();
+            tcp_acceptor() {}
+
+            tcp_acceptor(const tcp_acceptor&) =delete;
+            tcp_acceptor& operator=(const tcp_acceptor&) =delete;
+
+            tcp_acceptor(tcp_acceptor&& other) noexcept {
+                #ifdef POSIX
+                std::swap(socket_fd, other.socket_fd);
+                #endif
             }
 
-            *size = stat_buf.st_size;
+            tcp_acceptor& operator=(tcp_acceptor&& other) noexcept {
+                #ifdef POSIX
+                std::swap(socket_fd, other.socket_fd);
+                #endif
+                return *this;
+            }
+
+            /**
+             * Starts listening for connections
+             *
+             * @param host address to listen on (nullptr for all addresses)
+             * @param port port to listen on (0 to pick any free port, see port())
+             * @param result listening socket
+             * @param reuse_port allow other sockets with reuse_port to listen on the same port,
+             *                   so the system spreads incoming connections between them (SO_REUSEPORT)
+             * @param backlog maximum amount of connections waiting for accept()
+             * @return status of the operation
+             */
+            static status listen(IN const char* const host,
+                                 IN const u16 port,
+                                 OUT tcp_acceptor* const result,
+                                 IN const bool reuse_port = false,
+                                 IN const i32 backlog = SOMAXCONN) {
+                #ifdef POSIX
+                #ifndef SO_REUSEPORT
+                if (reuse_port) return status::NOT_IMPLEMENTED;
+                #endif
+
+                addrinfo* address_info = nullptr;
+                const status resolve_status = resolve_(host, port, true, &address_info);
+                if (resolve_status != status::SUCCESS) return resolve_status;
+
+                status result_status = status::UNKNOWN_ERROR;
+                for (const addrinfo* address = address_info; address != nullptr; address = address->ai_next) {
+                    const fd_t socket_fd = open_(address);
+                    if (socket_fd == -1) {
+                        result_status = process_error_();
+                        continue;
+                    }
+
+                    const i32 enable = 1;
+                    setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+                    #ifdef SO_REUSEPORT
+                    if (reuse_port) setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+                    #endif
+
+                    if (bind(socket_fd, address->ai_addr, address->ai_addrlen) != 0 || ::listen(socket_fd, backlog) != 0) {
+                        result_status = process_error_();
+                        close(socket_fd);
+                        continue;
+                    }
+
+                    tcp_acceptor a{};
+                    a.socket_fd = socket_fd;
+                    *result = std::move(a);
+                    result_status = status::SUCCESS;
+                    break;
+                }
+                freeaddrinfo(address_info);
+                return result_status;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            /**
+             * Accepts one pending connection
+             *
+             * @param buffer_size size of the buffer for incoming data of the connection
+             * @param socket accepted connection
+             * @return SUCCESS, WOULD_BLOCK if there are no pending connections, or error
+             */
+            status accept(IN const size_t buffer_size, OUT tcp_socket* const socket) {
+                #ifdef POSIX
+                fd_t accepted = -1;
+                do {
+                    #if defined(__linux__)
+                    accepted = ::accept4(socket_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    #else
+                    accepted = ::accept(socket_fd, nullptr, nullptr);
+                    if (accepted != -1) fcntl(accepted, F_SETFL, fcntl(accepted, F_GETFL) | O_NONBLOCK);
+                    #endif
+                } while (accepted == -1 && (errno == EINTR || errno == ECONNABORTED));
+                if (accepted == -1) return process_error_();
+
+                tcp_socket s{};
+                s.socket_fd = accepted;
+                s.connected = true;
+                if (allocator::ring::create(buffer_size, &s.incoming_buffer) != allocator::ring::status::SUCCESS) {
+                    return status::UNKNOWN_ERROR;
+                }
+                *socket = std::move(s);
+                return status::SUCCESS;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            /**
+             * @return port the socket is listening on (0 on error)
+             */
+            u16 port() const {
+                #ifdef POSIX
+                sockaddr_storage address{};
+                socklen_t length = sizeof(address);
+                if (getsockname(socket_fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) return 0;
+                return port_(address);
+                #else
+                return 0;
+                #endif
+            }
+
+            ~tcp_acceptor() {
+                #ifdef POSIX
+                if (socket_fd != -1) close(socket_fd);
+                #endif
+            }
+        };
+
+        /**
+         * Creates several listening sockets on the same port (one per thread or core),
+         * the system balances incoming connections between them.
+         *
+         * @param host address to listen on (nullptr for all addresses)
+         * @param port port to listen on (0 to pick any free port)
+         * @param shards amount of listening sockets
+         * @param result listening sockets
+         * @return status of the operation
+         */
+        static status listen_sharded(IN const char* const host,
+                                     IN u16 port,
+                                     IN const u32 shards,
+                                     OUT vec<tcp_acceptor>* const result) {
+            if (shards == 0) return status::INVALID_ARGUMENT;
+            vec<tcp_acceptor> acceptors(shards);
+            for (auto& acceptor : acceptors) {
+                const status s = tcp_acceptor::listen(host, port, &acceptor, true);
+                if (s != status::SUCCESS) return s;
+                // Others have to use the same port if the first one picked it
+                port = acceptor.port();
+            }
+            *result = std::move(acceptors);
             return status::SUCCESS;
-            #else
-            return status::NOT_IMPLEMENTED;
-            #endif
         }
 
-        static status read(IN const char* const path, IN size_t bytes_to_read, OUT void* const data) {
+        /**
+         * Sends a file (or a part of it) to a socket without copying it into user space.
+         * Data queued in the socket before the transfer is sent first.
+         */
+        struct file_transfer {
+
+            enum struct method {
+                // sendfile(): file pages go to the socket directly (Linux)
+                SENDFILE,
+                // splice() through a pipe (Linux)
+                SPLICE,
+                // pread() into the outgoing queue of the socket, works everywhere
+                COPY,
+            };
+
+            static constexpr size_t COPY_CHUNK = 64 * KB;
+
+        private:
             #ifdef POSIX
-            const fd_t fd = open(path, O_RDONLY);
-            if (fd == -1) {
-                return process_error();
+            fd_t file_fd_ = -1;
+            fd_t pipe_[2]{ -1, -1 };
+            #endif
+            method method_ = method::SENDFILE;
+            u64 offset_ = 0;
+            u64 remaining_ = 0;
+            // Bytes which are read into the pipe but not yet written to the socket
+            size_t in_pipe_ = 0;
+            // Bytes which are copied into the outgoing queue of the socket but not yet sent
+            size_t in_queue_ = 0;
+            vec<u8> chunk_{};
+
+            void close_() {
+                #ifdef POSIX
+                if (file_fd_ != -1) close(file_fd_);
+                if (pipe_[0] != -1) close(pipe_[0]);
+                if (pipe_[1] != -1) close(pipe_[1]);
+                file_fd_ = -1;
+                pipe_[0] = pipe_[1] = -1;
+                #endif
             }
 
-            const size_t bytes_read = ::read(fd, data, bytes_to_read);
-            if (bytes_read != bytes_to_read) {
-                return status::UNKNOWN_ERROR;
+            status send_file_(const fd_t socket_fd, u64* const sent) {
+                #ifdef UTILITIES_EPOLL
+                while (remaining_ != 0) {
+                    off_t offset = offset_;
+                    const ssize_t written = sendfile(socket_fd, file_fd_, &offset, std::min<u64>(remaining_, 1 * GB));
+                    if (written == -1) {
+                        if (errno == EINTR) continue;
+                        return process_error_();
+                    }
+                    // File is shorter than expected
+                    if (written == 0) return status::UNKNOWN_ERROR;
+                    offset_ += written;
+                    remaining_ -= written;
+                    *sent += written;
+                }
+                return status::SUCCESS;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
             }
-            close(fd);
 
+            status splice_(const fd_t socket_fd, u64* const sent) {
+                #ifdef UTILITIES_EPOLL
+                while (remaining_ != 0 || in_pipe_ != 0) {
+                    if (in_pipe_ == 0) {
+                        loff_t offset = offset_;
+                        const ssize_t read = splice(file_fd_, &offset, pipe_[1], nullptr,
+                                                    std::min<u64>(remaining_, 1 * MB), SPLICE_F_MOVE);
+                        if (read == -1) {
+                            if (errno == EINTR) continue;
+                            return process_error_();
+                        }
+                        if (read == 0) return status::UNKNOWN_ERROR;
+                        offset_ += read;
+                        remaining_ -= read;
+                        in_pipe_ = read;
+                    }
+
+                    const ssize_t written = splice(pipe_[0], nullptr, socket_fd, nullptr, in_pipe_,
+                                                   SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE);
+                    if (written == -1) {
+                        if (errno == EINTR) continue;
+                        return process_error_();
+                    }
+                    in_pipe_ -= written;
+                    *sent += written;
+                }
+                return status::SUCCESS;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            status flush_copied_(tcp_socket& socket, u64* const sent) {
+                const status s = socket.flush();
+                // Copied bytes are the last ones in the queue, so only the part still in the queue is not sent
+                const size_t left = std::min(in_queue_, socket.outgoing_buffer.queued());
+                *sent += in_queue_ - left;
+                in_queue_ = left;
+                return s;
+            }
+
+            status copy_(tcp_socket& socket, u64* const sent) {
+                #ifdef POSIX
+                while (true) {
+                    const status flush_status = flush_copied_(socket, sent);
+                    if (flush_status != status::SUCCESS || remaining_ == 0) return flush_status;
+
+                    // Chunk which doesn't fit into the queue would be lost
+                    const outgoing_queue& queue = socket.outgoing_buffer;
+                    const size_t space = queue.limit - std::min(queue.limit, queue.queued());
+                    const size_t size = std::min<u64>({ remaining_, COPY_CHUNK, space });
+                    if (size == 0) return status::NOT_ENOUGH_SPACE;
+                    chunk_.resize(size);
+                    const ssize_t read = pread(file_fd_, chunk_.data(), size, offset_);
+                    if (read == -1) {
+                        if (errno == EINTR) continue;
+                        return process_error_();
+                    }
+                    if (read == 0) return status::UNKNOWN_ERROR;
+                    const status write_status = socket.write(chunk_.data(), read);
+                    if (write_status != status::SUCCESS) return write_status;
+                    offset_ += read;
+                    remaining_ -= read;
+                    in_queue_ += read;
+                }
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+        public:
+
+            file_transfer() {}
+
+            file_transfer(const file_transfer&) =delete;
+            file_transfer& operator=(const file_transfer&) =delete;
+
+            file_transfer(file_transfer&& other) noexcept {
+                *this = std::move(other);
+            }
+
+            file_transfer& operator=(file_transfer&& other) noexcept {
+                #ifdef POSIX
+                std::swap(file_fd_, other.file_fd_);
+                std::swap(pipe_, other.pipe_);
+                #endif
+                std::swap(method_, other.method_);
+                std::swap(offset_, other.offset_);
+                std::swap(remaining_, other.remaining_);
+                std::swap(in_pipe_, other.in_pipe_);
+                std::swap(in_queue_, other.in_queue_);
+                std::swap(chunk_, other.chunk_);
+                return *this;
+            }
+
+            /**
+             * Opens the file for the transfer
+             *
+             * @param path path to the file
+             * @param result transfer
+             * @param offset first byte to send
+             * @param length amount of bytes to send (cut at the end of the file)
+             * @param m how the data is moved to the socket (COPY is used if others are not supported)
+             * @return status of the operation
+             */
+            static status open(IN const char* const path,
+                               OUT file_transfer* const result,
+                               IN const u64 offset = 0,
+                               IN const u64 length = UINT64_MAX,
+                               IN method m = method::SENDFILE) {
+                #ifdef POSIX
+                #ifndef UTILITIES_EPOLL
+                m = method::COPY;
+                #endif
+                file_transfer t{};
+                t.file_fd_ = ::open(path, O_RDONLY | O_CLOEXEC);
+                if (t.file_fd_ == -1) return process_error_();
+
+                struct stat stat_buf{};
+                if (fstat(t.file_fd_, &stat_buf) != 0) return process_error_();
+                const u64 size = stat_buf.st_size;
+                if (offset > size) return status::INVALID_ARGUMENT;
+
+                #ifdef UTILITIES_EPOLL
+                if (m == method::SPLICE && pipe2(t.pipe_, O_CLOEXEC) != 0) return process_error_();
+                #endif
+
+                t.method_ = m;
+                t.offset_ = offset;
+                t.remaining_ = std::min(length, size - offset);
+                *result = std::move(t);
+                return status::SUCCESS;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            /**
+             * Sends as much as the socket accepts. On WOULD_BLOCK call it again
+             * when the socket is writable (WRITABLE event of the event_loop).
+             *
+             * @param socket connected non-blocking socket
+             * @param sent amount of bytes of the file passed to the kernel is added here
+             * @return SUCCESS when everything is sent, WOULD_BLOCK if the socket is full, error otherwise
+             */
+            status send(IN tcp_socket& socket, OUT u64* const sent = nullptr) {
+                #ifdef POSIX
+                u64 sent_bytes = 0;
+                status result = status::SUCCESS;
+                if (method_ == method::COPY) {
+                    result = copy_(socket, &sent_bytes);
+                } else {
+                    // Previously queued data should arrive first
+                    result = socket.flush();
+                    if (result == status::SUCCESS) {
+                        result = method_ == method::SENDFILE
+                            ? send_file_(socket.socket_fd, &sent_bytes)
+                            : splice_(socket.socket_fd, &sent_bytes);
+                    }
+                }
+                if (sent != nullptr) *sent += sent_bytes;
+                if (result == status::SUCCESS && is_done()) close_();
+                return result;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            bool is_done() const {
+                return remaining() == 0;
+            }
+
+            // Bytes of the file which are not passed to the kernel yet
+            u64 remaining() const {
+                return remaining_ + in_pipe_ + in_queue_;
+            }
+
+            ~file_transfer() {
+                close_();
+            }
+        };
+
+        /**
+         * Address of the sender or the receiver of a datagram
+         */
+        struct endpoint {
+            #ifdef POSIX
+            sockaddr_storage address{};
+            socklen_t length = 0;
+            #endif
+
+            /**
+             * @param host name or address of the host
+             * @param port port
+             * @param result the first resolved address
+             * @return status of the operation
+             */
+            static status resolve(IN const char* const host, IN const u16 port, OUT endpoint* const result) {
+                #ifdef POSIX
+                addrinfo* address_info = nullptr;
+                const status s = resolve_(host, port, false, &address_info, SOCK_DGRAM);
+                if (s != status::SUCCESS) return s;
+                std::memcpy(&result->address, address_info->ai_addr, address_info->ai_addrlen);
+                result->length = address_info->ai_addrlen;
+                freeaddrinfo(address_info);
+                return status::SUCCESS;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            u16 port() const {
+                #ifdef POSIX
+                return port_(address);
+                #else
+                return 0;
+                #endif
+            }
+        };
+
+        /**
+         * Preallocated buffers for a batch of datagrams. All packets live in one slab
+         * split into slots of packet_size bytes, so receiving or sending doesn't allocate.
+         */
+        struct packet_batch {
+        private:
+            vec<u8> slab_{};
+            size_t packet_size_ = 0;
+            u32 capacity_ = 0;
+            u32 count_ = 0;
+            // The first packet which is not sent yet
+            u32 sent_ = 0;
+            vec<u32> sizes_{};
+            // Size of datagrams in a packet coalesced by GRO or split by GSO (0 for a single datagram)
+            vec<u16> segments_{};
+            vec<endpoint> endpoints_{};
+            #ifdef UTILITIES_EPOLL
+            // Space for the UDP_GRO or UDP_SEGMENT control message of every packet
+            static constexpr size_t CONTROL_WORDS = (CMSG_SPACE(sizeof(i32)) + sizeof(u64) - 1) / sizeof(u64);
+            vec<u64> control_{};
+            vec<iovec> iovecs_{};
+            vec<mmsghdr> headers_{};
+            #endif
+
+            friend struct udp_socket;
+
+            u8* slot_(const u32 index) {
+                return slab_.data() + index * packet_size_;
+            }
+
+        public:
+
+            // Maximum amount of datagrams in one packet split by GSO (UDP_MAX_SEGMENTS of the kernel)
+            static constexpr u32 MAX_SEGMENTS = 64;
+
+            /**
+             * @param capacity maximum amount of packets in the batch
+             * @param packet_size size of every slot (64 KB to receive packets coalesced by GRO)
+             * @param result batch to initialize
+             * @return status of the operation
+             */
+            static status create(IN const u32 capacity, IN const size_t packet_size, OUT packet_batch* const result) {
+                if (capacity == 0 || packet_size == 0 || packet_size > 64 * KB) return status::INVALID_ARGUMENT;
+                packet_batch b{};
+                b.slab_.resize(capacity * packet_size);
+                b.packet_size_ = packet_size;
+                b.capacity_ = capacity;
+                b.sizes_.resize(capacity);
+                b.segments_.resize(capacity);
+                b.endpoints_.resize(capacity);
+                #ifdef UTILITIES_EPOLL
+                b.control_.resize(capacity * CONTROL_WORDS);
+                b.iovecs_.resize(capacity);
+                b.headers_.resize(capacity);
+                #endif
+                *result = std::move(b);
+                return status::SUCCESS;
+            }
+
+            /**
+             * Copies the packet into the batch
+             *
+             * @param data payload
+             * @param size size of the payload (at most packet_size())
+             * @param to receiver (nullptr for the connected socket)
+             * @param segment_size split the packet into datagrams of this size by GSO (0 to send one datagram)
+             * @return false if the batch is full, the packet doesn't fit into the slot
+             *         or can't be split (more than MAX_SEGMENTS datagrams, no GSO on Linux)
+             */
+            bool add(IN const void* const data,
+                     IN const size_t size,
+                     IN const endpoint* const to = nullptr,
+                     IN const u16 segment_size = 0) {
+                if (count_ == capacity_ || size > packet_size_) return false;
+                if (segment_size != 0 && segment_size < size) {
+                    // Kernel rejects the whole sendmmsg() call with such a packet, so it never leaves the batch
+                    if ((size + segment_size - 1) / segment_size > MAX_SEGMENTS) return false;
+                    #if defined(UTILITIES_EPOLL) && !defined(UDP_SEGMENT)
+                    return false;
+                    #endif
+                }
+                if (size != 0) std::memcpy(slot_(count_), data, size);
+                sizes_[count_] = static_cast<u32>(size);
+                segments_[count_] = segment_size < size ? segment_size : 0;
+                endpoints_[count_] = to == nullptr ? endpoint{} : *to;
+                count_ += 1;
+                return true;
+            }
+
+            /**
+             * @param index index of the packet
+             * @return payload of the packet (several datagrams if segment_size() is not 0)
+             */
+            std::span<const u8> packet(IN const u32 index) const {
+                return { slab_.data() + index * packet_size_, sizes_[index] };
+            }
+
+            /**
+             * @param index index of the packet
+             * @return sender of the received packet
+             */
+            const endpoint& address(IN const u32 index) const {
+                return endpoints_[index];
+            }
+
+            /**
+             * @param index index of the packet
+             * @return size of every datagram in the packet (the last one can be shorter), 0 if it's one datagram
+             */
+            u16 segment_size(IN const u32 index) const {
+                return segments_[index];
+            }
+
+            /**
+             * Calls the function for every datagram, packets coalesced by GRO are split back
+             *
+             * @param function void(std::span<const u8> datagram, const endpoint& sender)
+             */
+            template <typename F>
+            void for_each_datagram(const F& function) const {
+                for (u32 i = 0; i < count_; i++) {
+                    const std::span<const u8> p = packet(i);
+                    const size_t step = segments_[i] == 0 ? p.size() : segments_[i];
+                    if (p.empty()) function(p, endpoints_[i]);
+                    for (size_t offset = 0; offset < p.size(); offset += step) {
+                        function(p.subspan(offset, std::min(step, p.size() - offset)), endpoints_[i]);
+                    }
+                }
+            }
+
+            u32 size() const {
+                return count_;
+            }
+
+            u32 capacity() const {
+                return capacity_;
+            }
+
+            size_t packet_size() const {
+                return packet_size_;
+            }
+
+            bool is_empty() const {
+                return count_ == 0;
+            }
+
+            // Every added packet is sent
+            bool is_sent() const {
+                return sent_ == count_;
+            }
+
+            void clear() {
+                count_ = 0;
+                sent_ = 0;
+            }
+        };
+
+        /**
+         * Non-blocking UDP socket which receives and sends datagrams in batches
+         * (one recvmmsg or sendmmsg call per batch on Linux).
+         */
+        struct udp_socket {
+
+            #ifdef POSIX
+            fd_t socket_fd = -1;
+            #endif
+
+        private:
+            #ifdef POSIX
+            static status open_socket_(const char* const host,
+                                       const u16 port,
+                                       const bool passive,
+                                       const bool reuse_port,
+                                       udp_socket* const result) {
+                addrinfo* address_info = nullptr;
+                const status resolve_status = resolve_(host, port, passive, &address_info, SOCK_DGRAM);
+                if (resolve_status != status::SUCCESS) return resolve_status;
+
+                status result_status = status::UNKNOWN_ERROR;
+                for (const addrinfo* address = address_info; address != nullptr; address = address->ai_next) {
+                    const fd_t socket_fd = open_(address);
+                    if (socket_fd == -1) {
+                        result_status = process_error_();
+                        continue;
+                    }
+
+                    #ifdef SO_REUSEPORT
+                    if (passive && reuse_port) {
+                        const i32 enable = 1;
+                        setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+                    }
+                    #endif
+                    // Connected UDP socket only exchanges datagrams with this address
+                    const i32 r = passive
+                            ? ::bind(socket_fd, address->ai_addr, address->ai_addrlen)
+                            : connect(socket_fd, address->ai_addr, address->ai_addrlen);
+                    if (r != 0) {
+                        result_status = process_error_();
+                        close(socket_fd);
+                        continue;
+                    }
+
+                    udp_socket s{};
+                    s.socket_fd = socket_fd;
+                    *result = std::move(s);
+                    result_status = status::SUCCESS;
+                    break;
+                }
+                freeaddrinfo(address_info);
+                return result_status;
+            }
+            #endif
+
+        public:
+
+            udp_socket() {}
+
+            udp_socket(const udp_socket&) =delete;
+            udp_socket& operator=(const udp_socket&) =delete;
+
+            udp_socket(udp_socket&& other) noexcept {
+                #ifdef POSIX
+                std::swap(socket_fd, other.socket_fd);
+                #endif
+            }
+
+            udp_socket& operator=(udp_socket&& other) noexcept {
+                #ifdef POSIX
+                std::swap(socket_fd, other.socket_fd);
+                #endif
+                return *this;
+            }
+
+            /**
+             * Creates the socket which receives datagrams sent to the address
+             *
+             * @param host address to receive on (nullptr for all addresses)
+             * @param port port to receive on (0 to pick any free port, see port())
+             * @param result socket
+             * @param reuse_port allow other sockets with reuse_port to bind to the same port,
+             *                   so the system spreads incoming datagrams between them (SO_REUSEPORT)
+             * @return status of the operation
+             */
+            static status bind(IN const char* const host,
+                               IN const u16 port,
+                               OUT udp_socket* const result,
+                               IN const bool reuse_port = false) {
+                #ifdef POSIX
+                #ifndef SO_REUSEPORT
+                if (reuse_port) return status::NOT_IMPLEMENTED;
+                #endif
+                return open_socket_(host, port, true, reuse_port, result);
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            /**
+             * Creates the socket connected to the address, so packets without a receiver are sent there
+             *
+             * @param host name or address of the host
+             * @param port port of the host
+             * @param result socket
+             * @return status of the operation
+             */
+            static status create(IN const char* const host, IN const u16 port, OUT udp_socket* const result) {
+                #ifdef POSIX
+                return open_socket_(host, port, false, false, result);
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            /**
+             * Lets the kernel coalesce datagrams of the same flow into one packet (UDP_GRO),
+             * see packet_batch::segment_size() and packet_batch::for_each_datagram()
+             *
+             * @return status of the operation (NOT_IMPLEMENTED if the system doesn't support it)
+             */
+            status enable_gro() {
+                #if defined(UTILITIES_EPOLL) && defined(UDP_GRO)
+                const i32 enable = 1;
+                if (setsockopt(socket_fd, IPPROTO_UDP, UDP_GRO, &enable, sizeof(enable)) != 0) return process_error_();
+                return status::SUCCESS;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            /**
+             * Bigger kernel buffer lets the socket survive bursts without dropping datagrams
+             *
+             * @param bytes size of the receive buffer
+             * @return status of the operation
+             */
+            status set_receive_buffer(IN const size_t bytes) {
+                #ifdef POSIX
+                const i32 size = static_cast<i32>(std::min<size_t>(bytes, INT32_MAX));
+                if (setsockopt(socket_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) != 0) return process_error_();
+                return status::SUCCESS;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            /**
+             * Receives as many datagrams as fit into the batch. Previous content of the batch
+             * is replaced. Datagrams bigger than packet_size() are truncated.
+             *
+             * @param batch received packets
+             * @return SUCCESS if at least one packet is received, WOULD_BLOCK if there are none, or error
+             */
+            status receive(OUT packet_batch* const batch) {
+                batch->clear();
+                #ifdef UTILITIES_EPOLL
+                for (u32 i = 0; i < batch->capacity_; i++) {
+                    batch->iovecs_[i] = { batch->slot_(i), batch->packet_size_ };
+                    msghdr& header = batch->headers_[i].msg_hdr;
+                    header.msg_name = &batch->endpoints_[i].address;
+                    header.msg_namelen = sizeof(sockaddr_storage);
+                    header.msg_iov = &batch->iovecs_[i];
+                    header.msg_iovlen = 1;
+                    header.msg_control = batch->control_.data() + i * packet_batch::CONTROL_WORDS;
+                    header.msg_controllen = packet_batch::CONTROL_WORDS * sizeof(u64);
+                    header.msg_flags = 0;
+                }
+
+                i32 received = -1;
+                do {
+                    received = recvmmsg(socket_fd, batch->headers_.data(), batch->capacity_, MSG_DONTWAIT, nullptr);
+                } while (received == -1 && errno == EINTR);
+                if (received == -1) return process_error_();
+
+                for (i32 i = 0; i < received; i++) {
+                    msghdr& header = batch->headers_[i].msg_hdr;
+                    batch->sizes_[i] = batch->headers_[i].msg_len;
+                    batch->endpoints_[i].length = header.msg_namelen;
+                    batch->segments_[i] = 0;
+                    #ifdef UDP_GRO
+                    for (cmsghdr* c = CMSG_FIRSTHDR(&header); c != nullptr; c = CMSG_NXTHDR(&header, c)) {
+                        if (c->cmsg_level == IPPROTO_UDP && c->cmsg_type == UDP_GRO) {
+                            i32 segment = 0;
+                            std::memcpy(&segment, CMSG_DATA(c), sizeof(segment));
+                            batch->segments_[i] = static_cast<u16>(segment);
+                        }
+                    }
+                    #endif
+                }
+                batch->count_ = received;
+                batch->sent_ = received;
+                return status::SUCCESS;
+                #elif defined(POSIX)
+                while (batch->count_ < batch->capacity_) {
+                    const u32 i = batch->count_;
+                    endpoint& from = batch->endpoints_[i];
+                    from.length = sizeof(sockaddr_storage);
+                    const ssize_t r = recvfrom(socket_fd, batch->slot_(i), batch->packet_size_, 0,
+                                               reinterpret_cast<sockaddr*>(&from.address), &from.length);
+                    if (r == -1 && errno == EINTR) continue;
+                    if (r == -1) {
+                        if (batch->count_ != 0) break;
+                        return process_error_();
+                    }
+                    batch->sizes_[i] = static_cast<u32>(r);
+                    batch->segments_[i] = 0;
+                    batch->count_ += 1;
+                }
+                batch->sent_ = batch->count_;
+                return status::SUCCESS;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            /**
+             * Sends packets of the batch which are not sent yet
+             *
+             * @param batch packets to send
+             * @param sent amount of packets sent by this call
+             * @return SUCCESS if every packet is sent, WOULD_BLOCK if the rest should be sent later, or error
+             */
+            status send(packet_batch& batch, OUT u32* const sent = nullptr) {
+                if (sent != nullptr) *sent = 0;
+                if (batch.is_sent()) return status::SUCCESS;
+                #ifdef UTILITIES_EPOLL
+                for (u32 i = batch.sent_; i < batch.count_; i++) {
+                    batch.iovecs_[i] = { batch.slot_(i), batch.sizes_[i] };
+                    msghdr& header = batch.headers_[i].msg_hdr;
+                    endpoint& to = batch.endpoints_[i];
+                    header.msg_name = to.length == 0 ? nullptr : &to.address;
+                    header.msg_namelen = to.length;
+                    header.msg_iov = &batch.iovecs_[i];
+                    header.msg_iovlen = 1;
+                    header.msg_control = nullptr;
+                    header.msg_controllen = 0;
+                    header.msg_flags = 0;
+                    #ifdef UDP_SEGMENT
+                    if (batch.segments_[i] != 0) {
+                        // Kernel (or the network card) splits the packet into datagrams
+                        header.msg_control = batch.control_.data() + i * packet_batch::CONTROL_WORDS;
+                        header.msg_controllen = CMSG_SPACE(sizeof(u16));
+                        cmsghdr* const c = CMSG_FIRSTHDR(&header);
+                        c->cmsg_level = IPPROTO_UDP;
+                        c->cmsg_type = UDP_SEGMENT;
+                        c->cmsg_len = CMSG_LEN(sizeof(u16));
+                        const u16 segment = batch.segments_[i];
+                        std::memcpy(CMSG_DATA(c), &segment, sizeof(segment));
+                    }
+                    #endif
+                }
+
+                i32 r = -1;
+                do {
+                    r = sendmmsg(socket_fd, batch.headers_.data() + batch.sent_, batch.count_ - batch.sent_, MSG_DONTWAIT);
+                } while (r == -1 && errno == EINTR);
+                if (r == -1) return process_error_();
+                batch.sent_ += r;
+                if (sent != nullptr) *sent = r;
+                return batch.is_sent() ? status::SUCCESS : status::WOULD_BLOCK;
+                #elif defined(POSIX)
+                u32 count = 0;
+                while (!batch.is_sent()) {
+                    const u32 i = batch.sent_;
+                    const endpoint& to = batch.endpoints_[i];
+                    const size_t size = batch.sizes_[i];
+                    // Without GSO the packet is split here
+                    const size_t step = batch.segments_[i] == 0 ? std::max<size_t>(size, 1) : batch.segments_[i];
+                    for (size_t offset = 0; offset < std::max<size_t>(size, 1); offset += step) {
+                        ssize_t r = -1;
+                        do {
+                            r = sendto(socket_fd, batch.slot_(i) + offset, std::min(step, size - offset), 0,
+                                       to.length == 0 ? nullptr : reinterpret_cast<const sockaddr*>(&to.address), to.length);
+                        } while (r == -1 && errno == EINTR);
+                        if (r == -1) {
+                            if (sent != nullptr) *sent = count;
+                            return process_error_();
+                        }
+                    }
+                    batch.sent_ += 1;
+                    count += 1;
+                }
+                if (sent != nullptr) *sent = count;
+                return status::SUCCESS;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            /**
+             * @return port the socket is bound to (0 on error)
+             */
+            u16 port() const {
+                #ifdef POSIX
+                sockaddr_storage address{};
+                socklen_t length = sizeof(address);
+                if (getsockname(socket_fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) return 0;
+                return port_(address);
+                #else
+                return 0;
+                #endif
+            }
+
+            ~udp_socket() {
+                #ifdef POSIX
+                if (socket_fd != -1) close(socket_fd);
+                #endif
+            }
+        };
+
+    }
+
+
+    /**
+     * Reactor which waits for readiness of many file descriptors at once and calls their handlers.
+     * Notifications are edge-triggered: a handler is called only when the state changes, so it
+     * should read (or write) until the call would block. Handlers can be called spuriously.
+     * Also runs timers and functions posted from other threads. Everything except post(), wake()
+     * and stop() should be called from the thread which runs the loop.
+     */
+    struct event_loop {
+
+        // Flags passed to the handler
+        static constexpr u32 READABLE = 1;
+        static constexpr u32 WRITABLE = 2;
+        // Peer closed the connection
+        static constexpr u32 CLOSED = 4;
+        // Socket has a pending error or zero-copy notifications
+        static constexpr u32 ERROR = 8;
+
+        using handler = std::function<void(u32 events)>;
+        using clock = std::chrono::steady_clock;
+
+    private:
+        struct registration {
+            // Handler is never moved, so it's safe to add descriptors while it's running
+            uptr<handler> callback{};
+            u32 generation = 0;
+        };
+
+        struct timer {
+            clock::time_point deadline{};
+            u64 id = 0;
+
+            bool operator>(const timer& other) const {
+                return deadline > other.deadline;
+            }
+        };
+
+        #ifdef UTILITIES_EPOLL
+        fd_t epoll_fd_ = -1;
+        fd_t wake_fd_ = -1;
+        #endif
+        // Indexed by the file descriptor
+        vec<registration> registrations_{};
+        u32 registered_ = 0;
+        // Removed handlers are kept alive until the end of the iteration
+        vec<uptr<handler>> removed_{};
+
+        vec_priority_queue<timer, std::greater<>> timers_{};
+        // Cancelled timers are removed from here and skipped when they reach the top of the queue
+        umap<u64, std::function<void()>> timer_callbacks_{};
+        u64 next_timer_ = 1;
+
+        std::mutex posted_mutex_{};
+        vec<std::function<void()>> posted_{};
+        vec<std::function<void()>> running_{};
+        bool stopped_ = false;
+
+        #ifdef UTILITIES_EPOLL
+        vec<epoll_event> events_{};
+        #endif
+
+        static u32 translate_(const u32 flags) {
+            u32 result = 0;
+            #ifdef UTILITIES_EPOLL
+            if (flags & EPOLLIN) result |= READABLE;
+            if (flags & EPOLLOUT) result |= WRITABLE;
+            if (flags & (EPOLLRDHUP | EPOLLHUP)) result |= CLOSED;
+            if (flags & EPOLLERR) result |= ERROR;
+            #endif
+            return result;
+        }
+
+        // Milliseconds until the closest timer, or the timeout if it's closer
+        i32 timeout_(const i32 timeout) const {
+            if (!posted_.empty()) return 0;
+            if (timers_.empty()) return timeout;
+            const auto left = std::chrono::ceil<std::chrono::milliseconds>(timers_.top().deadline - clock::now()).count();
+            const i32 until_timer = static_cast<i32>(std::clamp<i64>(left, 0, INT32_MAX));
+            return timeout < 0 ? until_timer : std::min(timeout, until_timer);
+        }
+
+        u32 run_timers_() {
+            u32 executed = 0;
+            const clock::time_point now = clock::now();
+            while (!timers_.empty() && timers_.top().deadline <= now) {
+                const u64 id = timers_.top().id;
+                timers_.pop();
+                const auto found = timer_callbacks_.find(id);
+                if (found == timer_callbacks_.end()) continue;
+                const std::function<void()> callback = std::move(found->second);
+                timer_callbacks_.erase(found);
+                callback();
+                executed += 1;
+            }
+            return executed;
+        }
+
+        u32 run_posted_() {
+            {
+                std::lock_guard<std::mutex> lock{ posted_mutex_ };
+                running_.swap(posted_);
+            }
+            for (auto& function : running_) function();
+            const u32 executed = running_.size();
+            running_.clear();
+            return executed;
+        }
+
+        void close_() {
+            #ifdef UTILITIES_EPOLL
+            if (epoll_fd_ != -1) close(epoll_fd_);
+            if (wake_fd_ != -1) close(wake_fd_);
+            epoll_fd_ = -1;
+            wake_fd_ = -1;
+            #endif
+        }
+
+    public:
+
+        event_loop() {}
+
+        event_loop(const event_loop&) =delete;
+        event_loop& operator=(const event_loop&) =delete;
+
+        /**
+         * Creates the epoll instance and the eventfd for wakeups (Linux only)
+         *
+         * @param result event loop to initialize (should not be initialized already)
+         * @param max_events maximum amount of events received by a single epoll_wait
+         * @return status of the operation
+         */
+        static status create(OUT event_loop* const result, IN const u32 max_events = 1024) {
+            #ifdef UTILITIES_EPOLL
+            if (max_events == 0) return status::INVALID_ARGUMENT;
+            const fd_t epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+            if (epoll_fd == -1) return status::UNKNOWN_ERROR;
+            const fd_t wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (wake_fd == -1) {
+                close(epoll_fd);
+                return status::UNKNOWN_ERROR;
+            }
+
+            // Wakeup is the only level-triggered descriptor, it's drained by the loop itself
+            epoll_event event{ .events = EPOLLIN, .data = { .u64 = UINT64_MAX } };
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event) != 0) {
+                close(epoll_fd);
+                close(wake_fd);
+                return status::UNKNOWN_ERROR;
+            }
+
+            result->close_();
+            result->epoll_fd_ = epoll_fd;
+            result->wake_fd_ = wake_fd;
+            result->events_.resize(max_events);
+            return status::SUCCESS;
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        /**
+         * Starts watching the file descriptor. It's registered for both reading and writing once,
+         * so no system calls are needed when the handler wants to write.
+         *
+         * @param fd non-blocking file descriptor
+         * @param callback called with READABLE/WRITABLE/CLOSED/ERROR flags
+         * @return status of the operation
+         */
+        status add(IN const fd_t fd, IN handler callback) {
+            #ifdef UTILITIES_EPOLL
+            if (fd < 0 || !callback) return status::INVALID_ARGUMENT;
+            if (registrations_.size() <= static_cast<size_t>(fd)) registrations_.resize(fd + 1);
+            registration& r = registrations_[fd];
+            if (r.callback) return status::INVALID_ARGUMENT;
+
+            // Generation lets the loop ignore events of a removed descriptor when its number is reused
+            r.generation += 1;
+            epoll_event event{
+                .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+                .data = { .u64 = (u64{ r.generation } << 32) | static_cast<u32>(fd) } };
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+                return errno == EBADF ? status::INVALID_ARGUMENT : status::UNKNOWN_ERROR;
+            }
+            r.callback = std::make_unique<handler>(std::move(callback));
+            registered_ += 1;
+            return status::SUCCESS;
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        status add(IN const socket::tcp_socket& socket, IN handler callback) {
+            #ifdef POSIX
+            return add(socket.socket_fd, std::move(callback));
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        status add(IN const socket::tcp_acceptor& acceptor, IN handler callback) {
+            #ifdef POSIX
+            return add(acceptor.socket_fd, std::move(callback));
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        status add(IN const socket::udp_socket& socket, IN handler callback) {
+            #ifdef POSIX
+            return add(socket.socket_fd, std::move(callback));
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        /**
+         * Stops watching the file descriptor. Should be called before it's closed.
+         * Can be called from a handler, including the handler of this descriptor.
+         *
+         * @param fd file descriptor
+         * @return status of the operation
+         */
+        status remove(IN const fd_t fd) {
+            #ifdef UTILITIES_EPOLL
+            if (fd < 0 || registrations_.size() <= static_cast<size_t>(fd) || !registrations_[fd].callback) {
+                return status::INVALID_ARGUMENT;
+            }
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+            // Handler may be running right now, so it's destroyed only after it returns
+            registration& r = registrations_[fd];
+            r.generation += 1;
+            removed_.emplace_back(std::move(r.callback));
+            registered_ -= 1;
+            return status::SUCCESS;
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        status remove(IN const socket::tcp_acceptor& acceptor) {
+            #ifdef POSIX
+            return remove(acceptor.socket_fd);
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        status remove(IN const socket::tcp_socket& socket) {
+            #ifdef POSIX
+            return remove(socket.socket_fd);
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        status remove(IN const socket::udp_socket& socket) {
+            #ifdef POSIX
+            return remove(socket.socket_fd);
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        /**
+         * Calls the function once after the delay
+         *
+         * @param delay time to wait
+         * @param callback function to call
+         * @return id of the timer which can be used to cancel it
+         */
+        u64 add_timer(IN const clock::duration delay, IN std::function<void()> callback) {
+            const u64 id = next_timer_++;
+            timers_.push(timer{ .deadline = clock::now() + delay, .id = id });
+            timer_callbacks_.emplace(id, std::move(callback));
+            return id;
+        }
+
+        /**
+         * @param id id of the timer
+         * @return true if the timer was cancelled, false if it's already executed or cancelled
+         */
+        bool cancel_timer(IN const u64 id) {
+            return timer_callbacks_.erase(id) != 0;
+        }
+
+        /**
+         * Runs the function on the loop thread. Can be called from any thread.
+         *
+         * @param function function to run
+         */
+        void post(IN std::function<void()> function) {
+            {
+                std::lock_guard<std::mutex> lock{ posted_mutex_ };
+                posted_.emplace_back(std::move(function));
+            }
+            wake();
+        }
+
+        /**
+         * Interrupts waiting of the loop. Can be called from any thread.
+         */
+        void wake() {
+            #ifdef UTILITIES_EPOLL
+            const u64 value = 1;
+            // Only fails if the counter overflows, which means that the loop will wake up anyway
+            const ssize_t written = ::write(wake_fd_, &value, sizeof(value));
+            (void) written;
+            #endif
+        }
+
+        /**
+         * Makes run() return after the current iteration. Can be called from any thread.
+         */
+        void stop() {
+            post([this]() { stopped_ = true; });
+        }
+
+        /**
+         * Waits for events once and dispatches them, then runs expired timers and posted functions
+         *
+         * @param timeout maximum time to wait in milliseconds (-1 to wait until something happens)
+         * @param dispatched amount of called handlers, timers and functions
+         * @return status of the operation
+         */
+        status run_once(IN const i32 timeout = -1, OUT u32* const dispatched = nullptr) {
+            #ifdef UTILITIES_EPOLL
+            u32 executed = 0;
+            i32 ready = 0;
+            {
+                std::lock_guard<std::mutex> lock{ posted_mutex_ };
+                ready = timeout_(timeout);
+            }
+            ready = epoll_wait(epoll_fd_, events_.data(), events_.size(), ready);
+            if (ready == -1 && errno != EINTR) return status::UNKNOWN_ERROR;
+
+            for (i32 i = 0; i < ready; i++) {
+                const u64 data = events_[i].data.u64;
+                if (data == UINT64_MAX) {
+                    u64 value = 0;
+                    const ssize_t drained = ::read(wake_fd_, &value, sizeof(value));
+                    (void) drained;
+                    continue;
+                }
+                const u32 fd = static_cast<u32>(data);
+                const u32 generation = static_cast<u32>(data >> 32);
+                if (fd >= registrations_.size()) continue;
+                registration& r = registrations_[fd];
+                if (r.generation != generation || !r.callback) continue;
+                handler* const callback = r.callback.get();
+                (*callback)(translate_(events_[i].events));
+                executed += 1;
+            }
+
+            executed += run_timers_();
+            executed += run_posted_();
+            removed_.clear();
+            if (dispatched != nullptr) *dispatched = executed;
+            return status::SUCCESS;
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        /**
+         * Runs the loop until stop() is called
+         *
+         * @return status of the operation
+         */
+        status run() {
+            stopped_ = false;
+            while (!stopped_) {
+                const status s = run_once();
+                if (s != status::SUCCESS) return s;
+            }
+            return status::SUCCESS;
+        }
+
+        /**
+         * @return amount of watched file descriptors
+         */
+        u32 size() const {
+            return registered_;
+        }
+
+        ~event_loop() {
+            close_();
+        }
+    };
+
+
+    namespace file {
+    
+        static status process_error() {
+            #ifdef POSIX
+            switch (errno) {
+                case EACCES: return status::ACCESS_DENIED;
+                case ENOENT: return status::FILE_NOT_FOUND;
+            }
+            return status::UNKNOWN_ERROR;
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        static status get_size(IN const char* const path, OUT size_t* size) {
+            #ifdef POSIX
+            struct stat stat_buf{};
+            const int status = stat(path, &stat_buf);
+            if (status != 0) {
+                return process_error();
+            }
+
+            *size = stat_buf.st_size;
+            return status::SUCCESS;
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        static status read(IN const char* const path, IN size_t bytes_to_read, OUT void* const data) {
+            #ifdef POSIX
+            const fd_t fd = open(path, O_RDONLY);
+            if (fd == -1) {
+                return process_error();
+            }
+
+            // read() can return less than requested, keep reading until everything is here
+            u8* bytes = static_cast<u8*>(data);
+            while (bytes_to_read != 0) {
+                const ssize_t bytes_read = ::read(fd, bytes, bytes_to_read);
+                if (bytes_read == -1 && errno == EINTR) continue;
+                if (bytes_read <= 0) {
+                    const status error = bytes_read == 0 ? status::UNKNOWN_ERROR : process_error();
+                    close(fd);
+                    return error;
+                }
+                bytes += bytes_read;
+                bytes_to_read -= bytes_read;
+            }
+            close(fd);
+
+            return status::SUCCESS;
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        /**
+         * How the mapped memory is going to be accessed, so the system can pick
+         * the right readahead
+         */
+        enum struct advice {
+            NORMAL,
+            SEQUENTIAL,
+            RANDOM,
+            WILLNEED,
+        };
+
+        static status advise_(void* const data, const size_t size, const advice a) {
+            #ifdef POSIX
+            if (data == nullptr || size == 0) return status::SUCCESS;
+            i32 flag = MADV_NORMAL;
+            switch (a) {
+                case advice::NORMAL: flag = MADV_NORMAL; break;
+                case advice::SEQUENTIAL: flag = MADV_SEQUENTIAL; break;
+                case advice::RANDOM: flag = MADV_RANDOM; break;
+                case advice::WILLNEED: flag = MADV_WILLNEED; break;
+            }
+            if (madvise(data, size, flag) != 0) return status::UNKNOWN_ERROR;
+            return status::SUCCESS;
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        /**
+         * Read-only memory mapping of the whole file. Unmapped on destruction.
+         */
+        struct mapping {
+            const u8* data = nullptr;
+            size_t size = 0;
+
+            mapping() =default;
+            mapping(const mapping&) =delete;
+            mapping& operator=(const mapping&) =delete;
+
+            mapping(mapping&& other) noexcept: data(other.data), size(other.size) {
+                other.data = nullptr;
+                other.size = 0;
+            }
+
+            mapping& operator=(mapping&& other) noexcept {
+                std::swap(data, other.data);
+                std::swap(size, other.size);
+                return *this;
+            }
+
+            /**
+             * Changes the access pattern hint for a part of the mapping
+             *
+             * @param a expected access pattern
+             * @param offset start of the part (rounded down to the page)
+             * @param length size of the part
+             * @return status of the operation
+             */
+            status advise(const advice a, size_t offset = 0, size_t length = SIZE_MAX) const {
+                #ifdef POSIX
+                if (offset >= size) return status::SUCCESS;
+                const size_t page = sysconf(_SC_PAGESIZE);
+                length = std::min(length, size - offset);
+                length += offset % page;
+                offset -= offset % page;
+                return advise_(const_cast<u8*>(data) + offset, length, a);
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            ~mapping() {
+                #ifdef POSIX
+                if (data != nullptr) munmap(const_cast<u8*>(data), size);
+                #endif
+            }
+        };
+
+        /**
+         * Maps the whole file into memory for reading. Nothing is copied,
+         * pages are read from the file (or the page cache) on first access.
+         *
+         * @param path path to the file
+         * @param result mapping of the file
+         * @param a expected access pattern
+         * @param populate read the whole file into memory right away (MAP_POPULATE)
+         * @return status of the operation
+         */
+        static status map(IN const char* const path,
+                          OUT mapping* const result,
+                          IN const advice a = advice::NORMAL,
+                          IN const bool populate = false) {
+            #ifdef POSIX
+            const fd_t fd = open(path, O_RDONLY);
+            if (fd == -1) {
+                return process_error();
+            }
+
+            struct stat stat_buf{};
+            if (fstat(fd, &stat_buf) != 0) {
+                const status error = process_error();
+                close(fd);
+                return error;
+            }
+
+            mapping m{};
+            m.size = stat_buf.st_size;
+            if (m.size != 0) {
+                i32 flags = MAP_PRIVATE;
+                #ifdef MAP_POPULATE
+                if (populate) flags |= MAP_POPULATE;
+                #endif
+                void* const data = mmap(nullptr, m.size, PROT_READ, flags, fd, 0);
+                if (data == MAP_FAILED) {
+                    const status error = process_error();
+                    close(fd);
+                    return error;
+                }
+                m.data = static_cast<const u8*>(data);
+            }
+            // Mapping stays valid after the file is closed
+            close(fd);
+
+            if (a != advice::NORMAL) advise_(const_cast<u8*>(m.data), m.size, a);
+
+            *result = std::move(m);
+            return status::SUCCESS;
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        /**
+         * Writable memory mapping of a file. Changes go to the file, sync() waits until
+         * they are written. Unmapped on destruction.
+         */
+        struct output_mapping {
+            u8* data = nullptr;
+            size_t size = 0;
+
+            output_mapping() =default;
+            output_mapping(const output_mapping&) =delete;
+            output_mapping& operator=(const output_mapping&) =delete;
+
+            output_mapping(output_mapping&& other) noexcept: data(other.data), size(other.size) {
+                other.data = nullptr;
+                other.size = 0;
+            }
+
+            output_mapping& operator=(output_mapping&& other) noexcept {
+                std::swap(data, other.data);
+                std::swap(size, other.size);
+                return *this;
+            }
+
+            status advise(const advice a) const {
+                return advise_(data, size, a);
+            }
+
+            // Writes all changes to the file and waits for completion
+            status sync() const {
+                #ifdef POSIX
+                if (data == nullptr) return status::SUCCESS;
+                if (msync(data, size, MS_SYNC) != 0) return process_error();
+                return status::SUCCESS;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            ~output_mapping() {
+                #ifdef POSIX
+                if (data != nullptr) munmap(data, size);
+                #endif
+            }
+        };
+
+        /**
+         * Creates a file (or truncates existing one) of the given size and maps it
+         * for reading and writing
+         *
+         * @param path path to the file
+         * @param size size of the file in bytes
+         * @param result mapping of the file
+         * @return status of the operation
+         */
+        static status map_output(IN const char* const path, IN const size_t size, OUT output_mapping* const result) {
+            #ifdef POSIX
+            const fd_t fd = open(path, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+            if (fd == -1) {
+                return process_error();
+            }
+            if (ftruncate(fd, size) != 0) {
+                const status error = process_error();
+                close(fd);
+                return error;
+            }
+
+            output_mapping m{};
+            m.size = size;
+            if (size != 0) {
+                void* const data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (data == MAP_FAILED) {
+                    const status error = process_error();
+                    close(fd);
+                    return error;
+                }
+                m.data = static_cast<u8*>(data);
+            }
+            close(fd);
+
+            *result = std::move(m);
+            return status::SUCCESS;
+            #else
+            return status::NOT_IMPLEMENTED;
+            #endif
+        }
+
+        /**
+         * File opened for writing. Closed on destruction.
+         */
+        struct output {
+            #ifdef POSIX
+            fd_t fd = -1;
+            #endif
+
+            output() =default;
+            output(const output&) =delete;
+            output& operator=(const output&) =delete;
+
+            output(output&& other) noexcept {
+                #ifdef POSIX
+                std::swap(fd, other.fd);
+                #endif
+            }
+
+            output& operator=(output&& other) noexcept {
+                #ifdef POSIX
+                std::swap(fd, other.fd);
+                #endif
+                return *this;
+            }
+
+            /**
+             * Writes all bytes at the current position of the file
+             *
+             * @param data bytes to write
+             * @param size amount of bytes
+             * @return status of the operation
+             */
+            status write(IN const void* const data, IN size_t size) {
+                #ifdef POSIX
+                const u8* bytes = static_cast<const u8*>(data);
+                while (size != 0) {
+                    const ssize_t written = ::write(fd, bytes, size);
+                    if (written == -1) {
+                        if (errno == EINTR) continue;
+                        return process_error();
+                    }
+                    bytes += written;
+                    size -= written;
+                }
+                return status::SUCCESS;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            /**
+             * Writes all bytes at the provided position without moving the current position
+             *
+             * @param offset position in the file
+             * @param data bytes to write
+             * @param size amount of bytes
+             * @return status of the operation
+             */
+            status write_at(IN size_t offset, IN const void* const data, IN size_t size) {
+                #ifdef POSIX
+                const u8* bytes = static_cast<const u8*>(data);
+                while (size != 0) {
+                    const ssize_t written = ::pwrite(fd, bytes, size, offset);
+                    if (written == -1) {
+                        if (errno == EINTR) continue;
+                        return process_error();
+                    }
+                    bytes += written;
+                    offset += written;
+                    size -= written;
+                }
+                return status::SUCCESS;
+                #else
+                return status::NOT_IMPLEMENTED;
+                #endif
+            }
+
+            ~output() {
+                #ifdef POSIX
+                if (fd != -1) close(fd);
+                #endif
+            }
+        };
+
+        /**
+         * Creates a new file (or truncates existing one) for writing
+         *
+         * @param path path to the file
+         * @param result opened file
+         * @return status of the operation
+         */
+        static status create(IN const char* const path, OUT output* const result) {
+            #ifdef POSIX
+            const fd_t fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+            if (fd == -1) {
+                return process_error();
+            }
+            output o{};
+            o.fd = fd;
+            *result = std::move(o);
             return status::SUCCESS;
             #else
             return status::NOT_IMPLEMENTED;
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include "../include/utils/async.h"
+
+static void write_test_file(const str& path, const str& content) {
+    sys::file::output output{};
+    ASSERT_EQ(sys::status::SUCCESS, sys::file::create(path.c_str(), &output));
+    ASSERT_EQ(sys::status::SUCCESS, output.write(content.data(), content.size()));
+}
+
+static void read_many_files(const sys::async::backend backend) {
+    vec<str> paths{};
+    vec<str> expected{};
+    for (u32 i = 0; i < 200; i++) {
+        paths.emplace_back("async_" + std::to_string(i) + ".txt");
+        expected.emplace_back(str(i * 37 % 5000, static_cast<char>('a' + i % 26)));
+        write_test_file(paths.back(), expected.back());
+    }
+    paths.emplace_back("async_missing.txt");
+
+    vec<vec<u8>> contents{};
+    vec<sys::status> statuses{};
+    ASSERT_EQ(sys::status::SUCCESS, sys::async::read_files(paths, &contents, &statuses, 16, backend));
+
+    for (u32 i = 0; i < expected.size(); i++) {
+        ASSERT_EQ(sys::status::SUCCESS, statuses[i]);
+        ASSERT_EQ(expected[i], str(contents[i].begin(), contents[i].end()));
+    }
+    ASSERT_EQ(sys::status::FILE_NOT_FOUND, statuses.back());
+    ASSERT_TRUE(contents.back().empty());
+
+    for (u32 i = 0; i < expected.size(); i++) remove(paths[i].c_str());
+}
+
+TEST(AsyncFileTest, read_files_in_batches) {
+    read_many_files(sys::async::backend::AUTO);
+}
+
+TEST(AsyncFileTest, read_files_in_batches_with_threads) {
+    read_many_files(sys::async::backend::THREADS);
+}
+
+static void queue_operations(const sys::async::backend backend) {
+    write_test_file("async_queue.txt", "0123456789");
+
+    sys::async::file_queue queue{};
+    ASSERT_EQ(sys::status::SUCCESS, sys::async::file_queue::create(4, &queue, backend));
+    ASSERT_EQ(backend == sys::async::backend::THREADS, !queue.uses_io_uring());
+
+    ASSERT_EQ(sys::status::SUCCESS, queue.push({ .op = sys::async::operation::OPEN, .user_data = 1, .path = "async_queue.txt" }));
+    ASSERT_EQ(sys::status::SUCCESS, queue.push({ .op = sys::async::operation::STAT, .user_data = 2, .path = "async_queue.txt" }));
+
+    fd_t fd = -1;
+    sys::async::completion completions[4]{};
+    ASSERT_EQ(2, queue.wait(completions, 4, 2));
+    for (const auto& c : { completions[0], completions[1] }) {
+        ASSERT_GE(c.result, 0);
+        if (c.op == sys::async::operation::OPEN) fd = static_cast<fd_t>(c.result);
+        if (c.op == sys::async::operation::STAT) {
+            ASSERT_EQ(10, c.result);
+        }
+    }
+
+    char buffer[4]{};
+    ASSERT_EQ(sys::status::SUCCESS, queue.push({ .op = sys::async::operation::READ, .user_data = 3, .fd = fd, .buffer = buffer, .size = 4, .offset = 3 }));
+    ASSERT_EQ(1, queue.wait(completions, 4, 1));
+    ASSERT_EQ(3, completions[0].user_data);
+    ASSERT_EQ(4, completions[0].result);
+    ASSERT_EQ("3456", str(buffer, 4));
+
+    ASSERT_EQ(sys::status::SUCCESS, queue.push({ .op = sys::async::operation::CLOSE, .user_data = 4, .fd = fd }));
+    ASSERT_EQ(1, queue.wait(completions, 4, 1));
+    ASSERT_EQ(0, completions[0].result);
+    ASSERT_EQ(0, queue.in_flight());
+
+    remove("async_queue.txt");
+}
+
+TEST(AsyncFileTest, queue_with_threads) {
+    queue_operations(sys::async::backend::THREADS);
+}
+
+TEST(AsyncFileTest, queue_with_io_uring) {
+    sys::async::file_queue queue{};
+    if (sys::async::file_queue::create(4, &queue, sys::async::backend::IO_URING) != sys::status::SUCCESS) {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+    queue_operations(sys::async::backend::IO_URING);
+}
+
+TEST(AsyncFileTest, queue_is_limited_by_depth) {
+    sys::async::file_queue queue{};
+    ASSERT_EQ(sys::status::SUCCESS, sys::async::file_queue::create(2, &queue));
+    ASSERT_EQ(sys::status::SUCCESS, queue.push({ .op = sys::async::operation::STAT, .path = "missing" }));
+    ASSERT_EQ(sys::status::SUCCESS, queue.push({ .op = sys::async::operation::STAT, .path = "missing" }));
+    ASSERT_EQ(sys::status::NOT_ENOUGH_SPACE, queue.push({ .op = sys::async::operation::STAT, .path = "missing" }));
+
+    sys::async::completion completions[2]{};
+    ASSERT_EQ(2, queue.wait(completions, 2, 2));
+    ASSERT_EQ(-ENOENT, completions[0].result);
+    ASSERT_EQ(sys::status::FILE_NOT_FOUND, sys::async::error_status(completions[1].result));
+}
@@ -0,0 +1,232 @@
+#include <gtest/gtest.h>
+#include "../include/utils/bits.h"
+
+TEST(BitsTest, varint_round_trip) {
+    const u64 values[] = { 0, 1, 127, 128, 300, 16383, 16384, UINT32_MAX, UINT64_MAX - 1, UINT64_MAX };
+    for (const u64 value : values) {
+        u8 buffer[bits::VARINT_MAX_SIZE];
+        const size_t size = bits::write_varint(value, buffer);
+        ASSERT_EQ(bits::varint_size(value), size);
+
+        u64 decoded = 0;
+        ASSERT_EQ(size, bits::read_varint(buffer, size, &decoded));
+        ASSERT_EQ(value, decoded);
+        // Any prefix is incomplete
+        ASSERT_EQ(0, bits::read_varint(buffer, size - 1, &decoded));
+    }
+    u8 buffer[bits::VARINT_MAX_SIZE];
+    ASSERT_EQ(1, bits::write_varint(127, buffer));
+    ASSERT_EQ(2, bits::write_varint(128, buffer));
+    ASSERT_EQ(0x80, buffer[0]);
+    ASSERT_EQ(0x01, buffer[1]);
+    ASSERT_EQ(10, bits::varint_size(UINT64_MAX));
+}
+
+TEST(BitsTest, varint_rejects_too_long_values) {
+    u8 buffer[12];
+    std::fill(buffer, buffer + 12, 0xFF);
+    u64 value = 0;
+    ASSERT_EQ(0, bits::read_varint(buffer, 12, &value));
+}
+
+TEST(BitsTest, little_endian_load_and_store) {
+    u8 buffer[9]{};
+    bits::store_le<u32>(0x11223344, buffer + 1);
+    ASSERT_EQ(0x44, buffer[1]);
+    ASSERT_EQ(0x11, buffer[4]);
+    ASSERT_EQ(0x11223344u, bits::load_le<u32>(buffer + 1));
+
+    bits::store_le<f64>(-2.5, buffer + 1);
+    ASSERT_EQ(-2.5, bits::load_le<f64>(buffer + 1));
+    ASSERT_EQ(0x4433u, bits::byte_swap<u16>(0x3344));
+}
+
+TEST(BitsTest, bitset_operations_work_on_words) {
+    bits::bitset a{ 1000 };
+    bits::bitset b{ 1000, true };
+    ASSERT_EQ(0, a.count());
+    ASSERT_EQ(1000, b.count());
+    ASSERT_EQ(16 * sizeof(u64), a.memory());
+
+    for (size_t i = 0; i < 1000; i += 3) a.set(i);
+    ASSERT_EQ(334, a.count());
+    ASSERT_TRUE(a[999]);
+    ASSERT_FALSE(a[998]);
+
+    b ^= a;
+    ASSERT_EQ(666, b.count());
+    b |= a;
+    ASSERT_EQ(1000, b.count());
+    b &= a;
+    ASSERT_EQ(a, b);
+    b.subtract(a);
+    ASSERT_EQ(0, b.count());
+
+    // Bits after the end are not counted
+    a.flip();
+    ASSERT_EQ(666, a.count());
+    a.resize(1010, true);
+    ASSERT_EQ(676, a.count());
+    a.resize(64);
+    ASSERT_EQ(42, a.count());
+
+    bits::bitset c{};
+    for (size_t i = 0; i < 200; i++) c.push_back(i % 50 == 7);
+    vec<size_t> found{};
+    c.for_each_set([&](const size_t index) { found.push_back(index); });
+    ASSERT_EQ((vec<size_t>{ 7, 57, 107, 157 }), found);
+    ASSERT_EQ(57, c.find_next(8));
+    ASSERT_EQ(200, c.find_next(158));
+}
+
+TEST(BitsTest, popcount_matches_scalar_count) {
+    vec<u64> words(1003);
+    u64 expected = 0;
+    u64 state = 12345;
+    for (u64& word : words) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        word = state;
+        expected += std::popcount(word);
+    }
+    ASSERT_EQ(expected, bits::popcount(words.data(), words.size()));
+    ASSERT_EQ(0, bits::popcount(words.data(), 0));
+    for (u32 i = 0; i < 64; i++) ASSERT_EQ(i, bits::select_in_word(~u64{ 0 }, i));
+    ASSERT_EQ(63, bits::select_in_word(u64{ 1 } << 63 | 1, 1));
+}
+
+TEST(BitsTest, rank_and_select_match_naive_scan) {
+    for (const size_t size : { 0, 1, 63, 64, 511, 512, 513, 5000 }) {
+        bits::bitset set{ size };
+        for (size_t i = 0; i < size; i++) {
+            if ((i * 7919) % 13 < 4 || (i > 600 && i < 1800)) set.set(i);
+        }
+        const bits::rank_index index{ set };
+        ASSERT_EQ(set.count(), index.ones());
+
+        size_t rank = 0;
+        for (size_t i = 0; i <= size; i++) {
+            ASSERT_EQ(rank, index.rank(i));
+            if (i < size && set[i]) {
+                ASSERT_EQ(i, index.select(rank));
+                rank += 1;
+            }
+        }
+    }
+}
+
+TEST(BitsTest, packed_vector_stores_values_of_any_width) {
+    for (u32 width = 1; width <= 32; width++) {
+        const u64 mask = (u64{ 1 } << width) - 1;
+        bits::packed_vector v{ width, 300 };
+        ASSERT_EQ(width, v.width());
+        for (size_t i = 0; i < 300; i++) v.set(i, static_cast<u32>((i * 2654435761u) & mask));
+        // Neighbours are not overwritten
+        v.set(150, static_cast<u32>(mask));
+        v.set(150, 0);
+        v.push_back(static_cast<u32>(mask));
+
+        vec<u32> unpacked(301);
+        v.unpack(0, 301, unpacked.data());
+        for (size_t i = 0; i < 300; i++) {
+            const u32 expected = i == 150 ? 0 : static_cast<u32>((i * 2654435761u) & mask);
+            ASSERT_EQ(expected, v[i]);
+            ASSERT_EQ(expected, unpacked[i]);
+        }
+        ASSERT_EQ(mask, v[300]);
+        ASSERT_EQ(mask, unpacked[300]);
+
+        v.unpack(17, 5, unpacked.data());
+        for (size_t i = 0; i < 5; i++) ASSERT_EQ(v[17 + i], unpacked[i]);
+    }
+    // 1 bit per flag instead of a byte
+    ASSERT_LE(bits::packed_vector(1, 8000).memory(), 1008);
+}
+
+TEST(BitsTest, zigzag_keeps_small_values_small) {
+    ASSERT_EQ(0, bits::zigzag_encode(0));
+    ASSERT_EQ(1, bits::zigzag_encode(-1));
+    ASSERT_EQ(2, bits::zigzag_encode(1));
+    ASSERT_EQ(UINT64_MAX, bits::zigzag_encode(INT64_MIN));
+    ASSERT_EQ(UINT32_MAX - 1, bits::zigzag_encode32(INT32_MAX));
+    for (const i64 value : { i64{ 0 }, i64{ -1 }, i64{ 63 }, i64{ -64 }, i64{ 1 } << 40, INT64_MIN, INT64_MAX }) {
+        ASSERT_EQ(value, bits::zigzag_decode(bits::zigzag_encode(value)));
+        u8 buffer[bits::VARINT_MAX_SIZE];
+        const size_t size = bits::write_svarint(value, buffer);
+        i64 decoded = 0;
+        ASSERT_EQ(size, bits::read_svarint(buffer, size, &decoded));
+        ASSERT_EQ(value, decoded);
+    }
+    ASSERT_EQ(INT32_MIN, bits::zigzag_decode32(bits::zigzag_encode32(INT32_MIN)));
+
+    // Mix of single byte runs and longer values
+    vec<u64> values{};
+    for (u64 i = 0; i < 100; i++) values.push_back(i % 10 == 9 ? i << 30 : i);
+    vec<u8> encoded(values.size() * bits::VARINT_MAX_SIZE);
+    size_t size = 0;
+    for (const u64 value : values) size += bits::write_varint(value, encoded.data() + size);
+    vec<u64> decoded(values.size());
+    ASSERT_EQ(size, bits::read_varints(encoded.data(), size, decoded.data(), decoded.size()));
+    ASSERT_EQ(values, decoded);
+    ASSERT_EQ(0, bits::read_varints(encoded.data(), size - 1, decoded.data(), decoded.size()));
+}
+
+TEST(BitsTest, bit_stream_round_trip) {
+    vec<u8> buffer{};
+    bits::bit_writer writer{ buffer };
+    for (u32 i = 0; i < 1000; i++) writer.write(u64{ i } * 2654435761u, i % 56 + 1);
+    writer.write_bit(true);
+    writer.flush();
+    ASSERT_EQ((writer.bits_written() + 7) / 8, buffer.size());
+    ASSERT_EQ(0, writer.bits_written() % 8);
+
+    bits::bit_reader reader{ buffer.data(), buffer.size() };
+    for (u32 i = 0; i < 1000; i++) {
+        const u32 count = i % 56 + 1;
+        const u64 expected = (u64{ i } * 2654435761u) & (~u64{ 0 } >> (64 - count));
+        ASSERT_EQ(expected, reader.read(count));
+    }
+    ASSERT_TRUE(reader.read_bit());
+    ASSERT_FALSE(reader.overflow());
+    reader.read(16);
+    ASSERT_TRUE(reader.overflow());
+}
+
+TEST(BitsTest, stream_vbyte_round_trip) {
+    for (const size_t count : { 0, 1, 3, 4, 5, 17, 1000 }) {
+        vec<u32> values(count);
+        for (size_t i = 0; i < count; i++) values[i] = static_cast<u32>(i * 2654435761u) >> (8 * (i % 4));
+        vec<u8> encoded(bits::stream_vbyte_max_size(count));
+        const size_t size = bits::stream_vbyte_encode(values.data(), count, encoded.data());
+        ASSERT_LE(size, encoded.size());
+
+        vec<u32> decoded(count);
+        ASSERT_EQ(size, bits::stream_vbyte_decode(encoded.data(), size, count, decoded.data()));
+        ASSERT_EQ(values, decoded);
+        if (count != 0) {
+            ASSERT_EQ(0, bits::stream_vbyte_decode(encoded.data(), size - 1, count, decoded.data()));
+        }
+    }
+    // Small values take a byte and a quarter
+    const vec<u32> small(1000, 200);
+    vec<u8> encoded(bits::stream_vbyte_max_size(small.size()));
+    ASSERT_EQ(1250, bits::stream_vbyte_encode(small.data(), small.size(), encoded.data()));
+}
+
+TEST(BitsTest, stream_vbyte_deltas_round_trip) {
+    // Coordinates of a path which goes back and forth
+    vec<i32> values(1001);
+    i32 x = -5000;
+    for (size_t i = 0; i < values.size(); i++) {
+        x += static_cast<i32>(i % 7) - 3 + (i % 100 == 0 ? 100000 : 0);
+        values[i] = x;
+    }
+    values[500] = INT32_MIN;
+    values[501] = INT32_MAX;
+
+    vec<u8> encoded(bits::stream_vbyte_max_size(values.size()));
+    const size_t size = bits::stream_vbyte_encode_deltas(values.data(), values.size(), encoded.data(), -5000);
+    ASSERT_LT(size, values.size() * 2);
+    vec<i32> decoded(values.size());
+    ASSERT_EQ(size, bits::stream_vbyte_decode_deltas(encoded.data(), size, decoded.size(), decoded.data(), -5000));
+    ASSERT_EQ(values, decoded);
+}
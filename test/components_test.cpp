@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include "../include/utils/complex/components.h"
+
+static graph make_grid(const u32 width, const u32 height) {
+    graph g{};
+    for (u32 y = 0; y < height; y++) {
+        for (u32 x = 0; x < width; x++) {
+            g.insert_vertex(vec2{ x, y });
+        }
+    }
+    for (u32 y = 0; y < height; y++) {
+        for (u32 x = 0; x + 1 < width; x++) {
+            g.connect_vertices(y * width + x, y * width + x + 1);
+        }
+    }
+    g.commit();
+    return g;
+}
+
+TEST(ComponentsTest, every_row_is_a_component) {
+    const graph g = make_grid(100, 10);
+    const auto l = components::label(g, 4);
+    ASSERT_EQ(10, l.count());
+    for (u32 size : l.sizes) ASSERT_EQ(100, size);
+    ASSERT_EQ(l.component[0], l.component[99]);
+    ASSERT_NE(l.component[0], l.component[100]);
+}
+
+TEST(ComponentsTest, incoming_connections_are_considered) {
+    graph g{};
+    const u32 a = g.insert_vertex(vec2{ 0, 0 });
+    const u32 b = g.insert_vertex(vec2{ 1, 0 });
+    const u32 c = g.insert_vertex(vec2{ 2, 0 });
+    g.connect_vertices(a, b);
+    g.commit();
+
+    const auto l = components::label(g);
+    ASSERT_EQ(2, l.count());
+    ASSERT_EQ(l.component[a], l.component[b]);
+    ASSERT_NE(l.component[a], l.component[c]);
+}
+
+TEST(ComponentsTest, parallel_labelling_matches_single_thread) {
+    graph g = make_grid(300, 300);
+    // join every second row with a column of edges
+    for (u32 y = 0; y + 1 < 300; y += 2) g.connect_vertices((y + 1) * 300, y * 300);
+    g.commit();
+
+    const auto single = components::label(g, 1);
+    const auto parallel = components::label(g, 8);
+    ASSERT_EQ(150, single.count());
+    ASSERT_EQ(single.component, parallel.component);
+    ASSERT_EQ(single.sizes, parallel.sizes);
+}
+
+TEST(ComponentsTest, keep_largest_component) {
+    graph g = make_grid(10, 2);
+    const u32 a = g.insert_vertex(vec2{ 100, 100 });
+    const u32 b = g.insert_vertex(vec2{ 101, 100 });
+    g.connect_vertices(a, b);
+    g.connect_vertices(0, 10);
+
+    components::keep_largest(g);
+    ASSERT_EQ(20, g.vertices().size());
+    ASSERT_EQ(19, g.connections().size());
+}
+
+TEST(ComponentsTest, remove_small_components_and_describe) {
+    graph g = make_grid(5, 3);
+    g.insert_vertex(vec2{ 50, 50 });
+
+    components::remove_smaller_than(g, 2);
+    ASSERT_EQ(15, g.vertices().size());
+
+    const auto l = components::label(g);
+    const auto stats = components::describe(g, l);
+    ASSERT_EQ(3, stats.size());
+    const auto& first = stats[l.component[0]];
+    ASSERT_EQ(5, first.vertices);
+    ASSERT_EQ(4, first.edges);
+    ASSERT_EQ(vec2(0, 0), first.bounds.bl);
+    ASSERT_EQ(vec2(4, 0), first.bounds.tr);
+}
@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+#include "../include/utils/complex/graph_file.h"
+
+TEST(GraphFileTest, written_graph_can_be_mapped) {
+    graph g{};
+    graph::batch changes{};
+    changes.insert_vertices = { vec2{ 0, 0 }, vec2{ 1, 0 }, vec2{ 2, 0 }, vec2{ 3, 0 } };
+    changes.connect = { { 0, 1 }, { 0, 3 }, { 3, 0 }, { 2, 3 } };
+    g.apply(changes);
+
+    ASSERT_EQ(sys::status::SUCCESS, graph_file::write("graph.bin", g));
+
+    graph_file::view view{};
+    ASSERT_EQ(sys::status::SUCCESS, graph_file::view::open("graph.bin", &view));
+    ASSERT_EQ(4, view.vertices());
+    ASSERT_EQ(4, view.connections());
+    ASSERT_EQ(vec2(2, 0), view.get_vertex(2));
+    ASSERT_EQ(2, view.out_degree(0));
+    ASSERT_EQ(0, view.out_degree(1));
+    ASSERT_EQ(3, view.neighbours(0)[1]);
+    ASSERT_EQ(0, view.neighbours(3)[0]);
+
+    remove("graph.bin");
+}
+
+TEST(GraphFileTest, removed_vertices_are_skipped) {
+    graph g{};
+    const u32 a = g.insert_vertex(vec2{ 0, 0 });
+    g.insert_vertex(vec2{ 1, 0 });
+    const u32 c = g.insert_vertex(vec2{ 2, 0 });
+    g.connect_vertices(c, a);
+    g.remove_disconnected();
+    g.commit();
+
+    ASSERT_EQ(sys::status::SUCCESS, graph_file::write("graph.bin", g));
+    graph_file::view view{};
+    ASSERT_EQ(sys::status::SUCCESS, graph_file::view::open("graph.bin", &view));
+    ASSERT_EQ(2, view.vertices());
+    ASSERT_EQ(vec2(2, 0), view.get_vertex(1));
+    ASSERT_EQ(0, view.neighbours(1)[0]);
+
+    remove("graph.bin");
+}
+
+TEST(GraphFileTest, streaming_writer_rejects_decreasing_sources) {
+    graph_file::writer writer{};
+    ASSERT_EQ(sys::status::SUCCESS, graph_file::writer::create("graph.bin", &writer, 64));
+    for (u32 i = 0; i < 1000; i++) ASSERT_EQ(sys::status::SUCCESS, writer.add_vertex(vec2{ i, i }));
+
+    const vec<u32> targets{ 1, 2, 3 };
+    ASSERT_EQ(sys::status::SUCCESS, writer.add_connections(10, targets));
+    ASSERT_EQ(sys::status::INVALID_ARGUMENT, writer.add_connections(5, targets));
+    ASSERT_EQ(sys::status::INVALID_ARGUMENT, writer.add_vertex(vec2{}));
+    // Connections have to stay sorted by (source, target)
+    ASSERT_EQ(sys::status::INVALID_ARGUMENT, writer.add_connections(11, vec<u32>{ 2, 1 }));
+    ASSERT_EQ(sys::status::INVALID_ARGUMENT, writer.add_connections(10, vec<u32>{ 2 }));
+    ASSERT_EQ(sys::status::SUCCESS, writer.add_connections(10, vec<u32>{ 3, 4 }));
+    ASSERT_EQ(sys::status::SUCCESS, writer.add_connections(999, targets));
+    ASSERT_EQ(sys::status::SUCCESS, writer.finish());
+
+    graph_file::view view{};
+    ASSERT_EQ(sys::status::SUCCESS, graph_file::view::open("graph.bin", &view));
+    ASSERT_EQ(1000, view.vertices());
+    ASSERT_EQ(8, view.connections());
+    ASSERT_EQ(5, view.out_degree(10));
+    ASSERT_EQ(0, view.out_degree(11));
+    ASSERT_EQ(3, view.out_degree(999));
+    ASSERT_EQ(vec2(500, 500), view.get_vertex(500));
+
+    remove("graph.bin");
+}
+
+TEST(GraphFileTest, open_rejects_invalid_file) {
+    sys::file::output output{};
+    ASSERT_EQ(sys::status::SUCCESS, sys::file::create("graph.bin", &output));
+    const str content = "definitely not a graph file, but long enough to contain a header";
+    ASSERT_EQ(sys::status::SUCCESS, output.write(content.data(), content.size()));
+
+    graph_file::view view{};
+    ASSERT_EQ(sys::status::INVALID_FORMAT, graph_file::view::open("graph.bin", &view));
+    ASSERT_EQ(sys::status::FILE_NOT_FOUND, graph_file::view::open("missing.bin", &view));
+
+    remove("graph.bin");
+}
+
+// Writes the file with the header and the offsets changed by the function
+template <typename F>
+static sys::status open_corrupted(const vec<u8>& original, const F& corrupt) {
+    vec<u8> content = original;
+    graph_file::header h{};
+    std::memcpy(&h, content.data(), sizeof(h));
+    corrupt(h, content);
+    std::memcpy(content.data(), &h, sizeof(h));
+    {
+        sys::file::output output{};
+        if (sys::file::create("corrupted.bin", &output) != sys::status::SUCCESS) return sys::status::UNKNOWN_ERROR;
+        output.write(content.data(), content.size());
+    }
+    graph_file::view view{};
+    const sys::status s = graph_file::view::open("corrupted.bin", &view);
+    remove("corrupted.bin");
+    return s;
+}
+
+TEST(GraphFileTest, open_rejects_corrupted_header) {
+    graph g{};
+    graph::batch changes{};
+    changes.insert_vertices = { vec2{ 0, 0 }, vec2{ 1, 0 }, vec2{ 2, 0 }, vec2{ 3, 0 } };
+    changes.connect = { { 0, 1 }, { 0, 3 }, { 3, 0 }, { 2, 3 } };
+    g.apply(changes);
+    ASSERT_EQ(sys::status::SUCCESS, graph_file::write("graph.bin", g));
+    size_t size = 0;
+    ASSERT_EQ(sys::status::SUCCESS, sys::file::get_size("graph.bin", &size));
+    vec<u8> original(size);
+    ASSERT_EQ(sys::status::SUCCESS, sys::file::read("graph.bin", size, original.data()));
+    remove("graph.bin");
+
+    const auto set_offset = [](vec<u8>& content, const graph_file::header& h, const u32 index, const u64 value) {
+        std::memcpy(content.data() + h.offsets_offset + index * sizeof(u64), &value, sizeof(value));
+    };
+
+    ASSERT_EQ(sys::status::SUCCESS, open_corrupted(original, [](graph_file::header&, vec<u8>&) {}));
+    // Size of the targets wraps around 2^64
+    ASSERT_EQ(sys::status::INVALID_FORMAT, open_corrupted(original, [&](graph_file::header& h, vec<u8>& content) {
+        h.connections = (~u64{ 0 }) / sizeof(u32) + 1;
+        set_offset(content, h, h.vertices, h.connections);
+    }));
+    // Offset itself is past the end of the file
+    ASSERT_EQ(sys::status::INVALID_FORMAT, open_corrupted(original, [](graph_file::header& h, vec<u8>&) {
+        h.positions_offset = ~u64{ 0 } - 7;
+    }));
+    ASSERT_EQ(sys::status::INVALID_FORMAT, open_corrupted(original, [](graph_file::header& h, vec<u8>&) {
+        h.targets_offset += 1;
+    }));
+    // Offsets of vertices decrease or point past the targets
+    ASSERT_EQ(sys::status::INVALID_FORMAT, open_corrupted(original, [&](graph_file::header& h, vec<u8>& content) {
+        set_offset(content, h, 1, 3);
+    }));
+    ASSERT_EQ(sys::status::INVALID_FORMAT, open_corrupted(original, [&](graph_file::header& h, vec<u8>& content) {
+        set_offset(content, h, 2, 1000);
+    }));
+    // Target is not a vertex of the graph
+    ASSERT_EQ(sys::status::INVALID_FORMAT, open_corrupted(original, [](graph_file::header& h, vec<u8>& content) {
+        const u32 target = h.vertices;
+        std::memcpy(content.data() + h.targets_offset + sizeof(u32), &target, sizeof(target));
+    }));
+}
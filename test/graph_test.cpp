@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include "../include/utils/complex/graph.h"
+
+TEST(GraphTest, remove_disconnected_keeps_vertices_with_incoming_connections) {
+    graph g{};
+    const u32 a = g.insert_vertex(vec2{ 0, 0 });
+    const u32 b = g.insert_vertex(vec2{ 1, 0 });
+    const u32 c = g.insert_vertex(vec2{ 2, 0 });
+    g.connect_vertices(a, b);
+
+    g.remove_disconnected();
+    ASSERT_EQ(2, g.vertices().size());
+    ASSERT_TRUE(g.contains(a));
+    ASSERT_TRUE(g.contains(b));
+    ASSERT_FALSE(g.contains(c));
+}
+
+TEST(GraphTest, ids_are_not_reused_after_removal) {
+    graph g{};
+    g.insert_vertex(vec2{ 0, 0 });
+    const u32 b = g.insert_vertex(vec2{ 1, 0 });
+    g.connect_vertices(b, b);
+    g.remove_disconnected();
+
+    const u32 c = g.insert_vertex(vec2{ 5, 5 });
+    ASSERT_NE(b, c);
+    ASSERT_EQ(vec2(1, 0), g.get_vertex(b));
+    ASSERT_EQ(vec2(5, 5), g.get_vertex(c));
+    ASSERT_ANY_THROW(g.get_vertex(0));
+}
+
+TEST(GraphTest, batch_tracks_degrees) {
+    graph g{};
+    graph::batch changes{};
+    for (u32 i = 0; i < 4; i++) changes.insert_vertices.emplace_back(vec2{ i, 0 });
+    const u32 first = g.next_id();
+    changes.connect = { { first + 3, first }, { first, first + 1 }, { first, first + 2 }, { first + 1, first + 2 } };
+    ASSERT_EQ(first, g.apply(changes));
+
+    ASSERT_EQ(4, g.connections().size());
+    ASSERT_TRUE(std::is_sorted(g.connections().begin(), g.connections().end()));
+    ASSERT_EQ(2, g.out_degree(first));
+    ASSERT_EQ(1, g.in_degree(first));
+    ASSERT_EQ(2, g.in_degree(first + 2));
+    ASSERT_EQ(0, g.out_degree(first + 2));
+
+    changes.clear();
+    changes.disconnect = { { first, first + 2 } };
+    changes.remove_vertices = { first + 3 };
+    g.apply(changes);
+
+    ASSERT_EQ(2, g.connections().size());
+    ASSERT_EQ(3, g.vertices().size());
+    ASSERT_EQ(0, g.in_degree(first));
+    ASSERT_EQ(1, g.in_degree(first + 2));
+
+    const auto neighbours = g.neighbours(first);
+    ASSERT_EQ(1, neighbours.size());
+    ASSERT_EQ(first + 1, neighbours[0].second);
+}
+
+TEST(GraphTest, single_connections_are_sorted_on_commit) {
+    graph g{};
+    for (u32 i = 0; i < 100; i++) g.insert_vertex(vec2{ i, i });
+    for (u32 i = 100; i > 1; i--) g.connect_vertices(i - 1, i - 2);
+    ASSERT_EQ(1, g.in_degree(0));
+    ASSERT_ANY_THROW(g.connections());
+
+    g.commit();
+    ASSERT_EQ(99, g.connections().size());
+    ASSERT_TRUE(std::is_sorted(g.connections().begin(), g.connections().end()));
+    g.connect_vertices(0, 99);
+    g.commit();
+    ASSERT_EQ(2, g.neighbours(0).size() + g.neighbours(1).size());
+    ASSERT_EQ(1, g.in_degree(99));
+}
+
+TEST(GraphTest, single_connections_are_merged_with_batch) {
+    graph g{};
+    graph::batch changes{};
+    changes.insert_vertices = { vec2{ 0, 0 }, vec2{ 1, 0 }, vec2{ 2, 0 } };
+    g.apply(changes);
+    g.connect_vertices(2, 0);
+    g.connect_vertices(1, 2);
+
+    changes.clear();
+    changes.connect = { { 0, 1 } };
+    changes.remove_vertices = { 1 };
+    g.apply(changes);
+    ASSERT_EQ((vec<graph::edge>{ { 2, 0 } }), g.connections());
+    ASSERT_EQ(1, g.in_degree(0));
+    ASSERT_EQ(0, g.in_degree(2));
+}
+
+TEST(GraphTest, invalid_csr_is_rejected) {
+    const vec<vec2> vertices{ vec2{ 0, 0 }, vec2{ 1, 0 } };
+    ASSERT_THROW((graph{ vertices, csr{ .offsets = { 0, 1, 1, 1 }, .targets = { 1 } } }), std::out_of_range);
+    ASSERT_THROW((graph{ vertices, csr{ .offsets = { 0, 1, 1 }, .targets = { 2 } } }), std::out_of_range);
+    ASSERT_THROW((graph{ vertices, csr{ .offsets = { 0, 2, 1 }, .targets = { 1, 0 } } }), std::out_of_range);
+    ASSERT_THROW((graph{ vertices, csr{ .offsets = { 0, 1, 3 }, .targets = { 1, 0 } } }), std::out_of_range);
+
+    const graph g{ vertices, csr{ .offsets = { 0, 1, 2 }, .targets = { 1, 0 } } };
+    ASSERT_EQ(2, g.connections().size());
+}
+
+TEST(GraphTest, large_batch) {
+    graph g{};
+    graph::batch changes{};
+    const u32 size = 100'000;
+    changes.insert_vertices.resize(size);
+    for (u32 i = 0; i < size * 10; i++) {
+        changes.connect.emplace_back((i * 7919u) % size, (i * 104729u + 1) % size);
+    }
+    g.apply(changes);
+
+    ASSERT_EQ(size * 10, g.connections().size());
+    u64 total = 0;
+    for (u32 id = 0; id < size; id++) total += g.out_degree(id);
+    ASSERT_EQ(size * 10, total);
+}
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "../include/utils/lz.h"
+#include "../include/utils/complex/collections.h"
+
+static vec<u8> round_trip(const vec<u8>& input, size_t* const compressed_size) {
+    vec<u8> compressed(lz::max_compressed_size(input.size()));
+    *compressed_size = lz::compress(input.data(), input.size(), compressed.data(), compressed.size());
+    EXPECT_NE(0, *compressed_size);
+    vec<u8> output(input.size());
+    EXPECT_TRUE(lz::decompress(compressed.data(), *compressed_size, output.data(), output.size()));
+    return output;
+}
+
+TEST(LzTest, repetitive_data_is_compressed) {
+    vec<u8> input{};
+    const str line = "{\"id\":12345,\"name\":\"player\",\"x\":1.5,\"y\":-2.25}\n";
+    while (input.size() < 64 * KB) input.insert(input.end(), line.begin(), line.end());
+
+    size_t compressed_size = 0;
+    ASSERT_EQ(input, round_trip(input, &compressed_size));
+    ASSERT_LT(compressed_size * 10, input.size());
+
+    // Overlapping matches (offset smaller than the match)
+    const vec<u8> zeros(10000, 0);
+    ASSERT_EQ(zeros, round_trip(zeros, &compressed_size));
+    ASSERT_LT(compressed_size, 100);
+}
+
+TEST(LzTest, random_and_short_data_round_trip) {
+    std::mt19937 random{ 42 };
+    for (const size_t size : { 0, 1, 4, 12, 13, 100, 4096, 100000 }) {
+        vec<u8> input(size);
+        for (u8& byte : input) byte = static_cast<u8>(random());
+        size_t compressed_size = 0;
+        ASSERT_EQ(input, round_trip(input, &compressed_size));
+        ASSERT_LE(compressed_size, lz::max_compressed_size(size));
+    }
+
+    // Random data with some repeats
+    vec<u8> input(50000);
+    for (size_t i = 0; i < input.size(); i++) {
+        input[i] = i > 1000 && random() % 4 != 0 ? input[i - 1 - random() % 1000] : static_cast<u8>(random());
+    }
+    size_t compressed_size = 0;
+    ASSERT_EQ(input, round_trip(input, &compressed_size));
+}
+
+TEST(LzTest, corrupted_block_is_rejected) {
+    vec<u8> input(1000);
+    for (size_t i = 0; i < input.size(); i++) input[i] = static_cast<u8>(i % 17);
+    vec<u8> compressed(lz::max_compressed_size(input.size()));
+    const size_t size = lz::compress(input.data(), input.size(), compressed.data(), compressed.size());
+
+    vec<u8> output(input.size());
+    // Wrong size of the output
+    ASSERT_FALSE(lz::decompress(compressed.data(), size, output.data(), output.size() - 1));
+    // Truncated block
+    ASSERT_FALSE(lz::decompress(compressed.data(), size - 1, output.data(), output.size()));
+    // Offset of the first match points before the beginning of the output
+    const u8 invalid[] = { 0x10, 'a', 0x10, 0x00, 0x00 };
+    ASSERT_FALSE(lz::decompress(invalid, sizeof(invalid), output.data(), 5));
+
+    // Any garbage is rejected or decompressed without touching memory outside of the buffers
+    std::mt19937 random{ 7 };
+    constexpr size_t guard = 64;
+    vec<u8> guarded(guard + output.size() + guard);
+    u32 rejected = 0;
+    for (u32 i = 0; i < 1000; i++) {
+        vec<u8> garbage(compressed.begin(), compressed.begin() + size);
+        garbage[random() % size] = static_cast<u8>(random());
+        std::fill(guarded.begin(), guarded.end(), 0xCD);
+        rejected += !lz::decompress(garbage.data(), garbage.size(), guarded.data() + guard, output.size());
+        for (size_t g = 0; g < guard; g++) {
+            ASSERT_EQ(0xCD, guarded[g]);
+            ASSERT_EQ(0xCD, guarded[guard + output.size() + g]);
+        }
+    }
+    // Most of the corruptions change the structure of the block, not only literals
+    ASSERT_GT(rejected, 100);
+
+    // Output buffer is too small
+    ASSERT_EQ(0, lz::compress(input.data(), input.size(), compressed.data(), 100));
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include "../include/utils/memory.h"
+
+TEST(StackTest, allocate_returns_start_of_the_block) {
+    alignas(16) u8 buffer[64]{};
+    allocator::stack stack{ buffer, sizeof(buffer) };
+
+    void* first = nullptr;
+    ASSERT_EQ(allocator::stack::status::SUCCESS, stack.allocate(3, &first));
+    ASSERT_EQ(buffer, first);
+
+    void* second = nullptr;
+    ASSERT_EQ(allocator::stack::status::SUCCESS, stack.allocate(8, &second, 8));
+    ASSERT_EQ(buffer + 8, second);
+    ASSERT_EQ(16, stack.head);
+
+    void* third = nullptr;
+    ASSERT_EQ(allocator::stack::status::NOT_ENOUGH_SPACE, stack.allocate(64, &third));
+}
+
+TEST(ArenaTest, memory_is_committed_on_demand) {
+    allocator::arena arena{};
+    ASSERT_EQ(allocator::arena::status::SUCCESS, allocator::arena::create(1 * GB, &arena));
+    ASSERT_EQ(0, arena.committed());
+
+    u8* bytes = arena.allocate<u8>(100 * KB);
+    ASSERT_NE(nullptr, bytes);
+    std::memset(bytes, 1, 100 * KB);
+    ASSERT_GE(arena.committed(), 100 * KB);
+    ASSERT_LT(arena.committed(), 1 * MB);
+
+    arena.clear();
+    arena.trim();
+    ASSERT_EQ(0, arena.committed());
+    ASSERT_EQ(100 * KB, arena.high_water());
+}
+
+TEST(ArenaTest, allocations_are_aligned) {
+    allocator::arena arena{};
+    ASSERT_EQ(allocator::arena::status::SUCCESS, allocator::arena::create(1 * MB, &arena));
+
+    void* pointer = nullptr;
+    ASSERT_EQ(allocator::arena::status::SUCCESS, arena.allocate(1, &pointer, 1));
+    for (const size_t alignment : { 2, 8, 64, 4096 }) {
+        ASSERT_EQ(allocator::arena::status::SUCCESS, arena.allocate(1, &pointer, alignment));
+        ASSERT_EQ(0, reinterpret_cast<uintptr_t>(pointer) % alignment);
+    }
+}
+
+TEST(ArenaTest, scope_rolls_back_allocations) {
+    allocator::arena arena{};
+    ASSERT_EQ(allocator::arena::status::SUCCESS, allocator::arena::create(1 * MB, &arena));
+
+    u64* outside = arena.allocate<u64>();
+    const size_t used = arena.used();
+    {
+        allocator::arena::scope scope{ arena };
+        for (u32 i = 0; i < 100; i++) ASSERT_NE(nullptr, arena.allocate<u64>(100));
+        ASSERT_GT(arena.used(), used);
+    }
+    ASSERT_EQ(used, arena.used());
+    ASSERT_GE(arena.high_water(), 100 * 100 * sizeof(u64));
+
+    // Memory after the rollback is reused
+    u64* next = arena.allocate<u64>();
+    ASSERT_EQ(outside + 1, next);
+}
+
+TEST(ArenaTest, allocation_fails_when_reserve_is_exhausted) {
+    allocator::arena arena{};
+    ASSERT_EQ(allocator::arena::status::SUCCESS, allocator::arena::create(64 * KB, &arena));
+    void* pointer = nullptr;
+    ASSERT_EQ(allocator::arena::status::SUCCESS, arena.allocate(arena.reserved(), &pointer, 1));
+    ASSERT_EQ(allocator::arena::status::NOT_ENOUGH_SPACE, arena.allocate(1, &pointer, 1));
+}
+
+TEST(ArenaTest, transparent_huge_pages_arena) {
+    allocator::arena arena{};
+    ASSERT_EQ(allocator::arena::status::SUCCESS,
+              allocator::arena::create(64 * MB, &arena, allocator::arena::pages::TRANSPARENT_HUGE));
+    u8* bytes = arena.allocate<u8>(3 * MB);
+    ASSERT_NE(nullptr, bytes);
+    bytes[3 * MB - 1] = 1;
+    ASSERT_EQ(0, arena.committed() % allocator::arena::HUGE_PAGE);
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <random>
+#include "../include/utils/memory.h"
+#include "../include/utils/complex/collections.h"
+
+TEST(ConcurrentArenaTest, allocations_are_aligned) {
+    allocator::concurrent_arena arena{};
+    ASSERT_EQ(allocator::concurrent_arena::status::SUCCESS, allocator::concurrent_arena::create(16 * MB, &arena));
+    allocator::concurrent_arena::local local{ arena };
+
+    void* pointer = nullptr;
+    for (const size_t alignment : { 1, 4, 16, 256, 4096 }) {
+        ASSERT_EQ(allocator::concurrent_arena::status::SUCCESS, local.allocate(3, &pointer, alignment));
+        ASSERT_EQ(0, reinterpret_cast<uintptr_t>(pointer) % alignment);
+    }
+    ASSERT_NE(nullptr, local.allocate<u8>(1 * MB));
+}
+
+TEST(ConcurrentArenaTest, runs_out_of_space) {
+    allocator::concurrent_arena arena{};
+    ASSERT_EQ(allocator::concurrent_arena::status::SUCCESS, allocator::concurrent_arena::create(256 * KB, &arena, 64 * KB));
+    allocator::concurrent_arena::local local{ arena };
+
+    u32 allocated = 0;
+    while (local.allocate<u8>(1 * KB) != nullptr) allocated++;
+    ASSERT_GE(allocated, 192);
+    ASSERT_LE(allocated, 256);
+}
+
+// Every thread fills its allocations with its id, then all of them are checked.
+// Any overlap between threads would overwrite somebody else's pattern.
+TEST(ConcurrentArenaTest, stress_threads_never_share_memory) {
+    struct allocation {
+        u8* data;
+        u32 size;
+    };
+
+    allocator::concurrent_arena arena{};
+    ASSERT_EQ(allocator::concurrent_arena::status::SUCCESS, allocator::concurrent_arena::create(512 * MB, &arena, 16 * KB));
+
+    const u32 threads_count = std::max(4u, std::thread::hardware_concurrency());
+    for (u32 round = 0; round < 3; round++) {
+        vec<vec<allocation>> allocations(threads_count);
+        vec<std::thread> threads{};
+        for (u32 t = 0; t < threads_count; t++) {
+            threads.emplace_back([&, t]() {
+                allocator::concurrent_arena::local local{ arena };
+                std::mt19937 random{ t * 31 + round };
+                for (u32 i = 0; i < 20000; i++) {
+                    // Mostly small allocations with an occasional big one
+                    const u32 size = i % 1000 == 0 ? 20000 : 1 + random() % 200;
+                    u8* data = local.allocate<u8>(size);
+                    ASSERT_NE(nullptr, data);
+                    std::memset(data, static_cast<int>(t + 1), size);
+                    allocations[t].push_back({ data, size });
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+
+        for (u32 t = 0; t < threads_count; t++) {
+            for (const auto& a : allocations[t]) {
+                for (u32 i = 0; i < a.size; i++) ASSERT_EQ(t + 1, a.data[i]);
+            }
+        }
+
+        ASSERT_GT(arena.used(), 0);
+        arena.reset();
+        ASSERT_EQ(0, arena.used());
+    }
+}
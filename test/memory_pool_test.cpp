@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include "../include/utils/memory.h"
+#include "../include/utils/complex/collections.h"
+
+TEST(PoolTest, blocks_are_reused_after_free) {
+    allocator::pool pool{ 24 };
+    void* first = nullptr;
+    ASSERT_EQ(allocator::pool::status::SUCCESS, pool.allocate(&first));
+    pool.free(first);
+
+    void* second = nullptr;
+    ASSERT_EQ(allocator::pool::status::SUCCESS, pool.allocate(&second));
+    ASSERT_EQ(first, second);
+    ASSERT_EQ(0, reinterpret_cast<uintptr_t>(second) % alignof(std::max_align_t));
+}
+
+TEST(PoolTest, pool_grows_beyond_one_chunk) {
+    allocator::pool pool{ 64, 4 * KB };
+    set<void*> blocks{};
+    for (u32 i = 0; i < 1000; i++) {
+        void* block = nullptr;
+        ASSERT_EQ(allocator::pool::status::SUCCESS, pool.allocate(&block));
+        std::memset(block, 0xAB, pool.block_size());
+        blocks.emplace(block);
+    }
+    ASSERT_EQ(1000, blocks.size());
+    for (void* block : blocks) pool.free(block);
+}
+
+TEST(PoolTest, blocks_can_be_freed_from_other_threads) {
+    allocator::pool pool{ 32 };
+    const u32 per_thread = 20000;
+    vec<vec<void*>> allocated(4);
+
+    vec<std::thread> threads{};
+    for (u32 t = 0; t < 4; t++) {
+        threads.emplace_back([&, t]() {
+            allocator::pool::cache cache{ pool };
+            for (u32 i = 0; i < per_thread; i++) {
+                void* block = nullptr;
+                ASSERT_EQ(allocator::pool::status::SUCCESS, cache.allocate(&block));
+                *static_cast<u32*>(block) = t;
+                allocated[t].emplace_back(block);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    threads.clear();
+
+    // Every thread frees blocks allocated by another thread
+    for (u32 t = 0; t < 4; t++) {
+        threads.emplace_back([&, t]() {
+            allocator::pool::cache cache{ pool };
+            const auto& blocks = allocated[(t + 1) % 4];
+            for (u32 i = 0; i < blocks.size(); i++) {
+                ASSERT_EQ((t + 1) % 4, *static_cast<u32*>(blocks[i]));
+                // Half of the blocks go through the cache, half directly to the pool
+                if (i % 2 == 0) cache.free(blocks[i]);
+                else pool.free(blocks[i]);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    // All blocks are back in the pool and get reused
+    // (together with blocks which were left in the caches of the first threads)
+    set<void*> previous{};
+    for (const auto& blocks : allocated) previous.insert(blocks.begin(), blocks.end());
+    set<void*> reused{};
+    allocator::pool::cache cache{ pool };
+    for (u32 i = 0; i < 4 * (per_thread + 64); i++) {
+        void* block = nullptr;
+        ASSERT_EQ(allocator::pool::status::SUCCESS, cache.allocate(&block));
+        if (previous.contains(block)) reused.emplace(block);
+    }
+    ASSERT_EQ(previous.size(), reused.size());
+}
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include "../include/utils/memory.h"
+#include "../include/utils/complex/collections.h"
+
+TEST(MemoryResourceTest, containers_allocate_from_stack) {
+    alignas(16) u8 buffer[4 * KB]{};
+    allocator::stack stack{ buffer, sizeof(buffer) };
+    allocator::stack_resource resource{ stack };
+
+    pmr::vec<u64> values{ &resource };
+    values.reserve(16);
+    for (u64 i = 0; i < 16; i++) values.emplace_back(i);
+
+    const u8* data = reinterpret_cast<const u8*>(values.data());
+    ASSERT_GE(data, buffer);
+    ASSERT_LT(data, buffer + sizeof(buffer));
+    ASSERT_EQ(0, reinterpret_cast<uintptr_t>(data) % alignof(u64));
+    ASSERT_EQ(16 * sizeof(u64), stack.head);
+}
+
+TEST(MemoryResourceTest, full_stack_throws_without_upstream) {
+    u8 buffer[64]{};
+    allocator::stack stack{ buffer, sizeof(buffer) };
+    allocator::stack_resource resource{ stack };
+
+    pmr::vec<u8> values{ &resource };
+    ASSERT_THROW(values.reserve(1 * KB), std::bad_alloc);
+}
+
+TEST(MemoryResourceTest, full_stack_falls_back_to_upstream) {
+    u8 buffer[64]{};
+    allocator::stack stack{ buffer, sizeof(buffer) };
+    allocator::stack_resource resource{ stack, std::pmr::new_delete_resource() };
+
+    pmr::vec<u8> values{ &resource };
+    values.resize(1 * KB, 7);
+    ASSERT_EQ(7, values[1000]);
+}
+
+TEST(MemoryResourceTest, arena_reuses_memory_after_reset) {
+    allocator::arena_resource arena{ 1 * KB };
+
+    const u8* first_data = nullptr;
+    for (u32 frame = 0; frame < 3; frame++) {
+        {
+            pmr::umap<u32, pmr::str> names{ &arena };
+            pmr::set<u32> ids{ &arena };
+            pmr::vec<u32> values{ &arena };
+            for (u32 i = 0; i < 1000; i++) {
+                names.emplace(i, "a name which doesn't fit into small string buffer");
+                ids.emplace(i);
+                values.emplace_back(i);
+            }
+            ASSERT_EQ(1000, names.size());
+            ASSERT_EQ(999, values.back());
+            if (frame == 1) first_data = reinterpret_cast<const u8*>(values.data());
+            if (frame == 2) {
+                ASSERT_EQ(first_data, reinterpret_cast<const u8*>(values.data()));
+            }
+        }
+        arena.reset();
+    }
+}
+
+TEST(MemoryResourceTest, default_aliases_accept_allocators) {
+    using alloc = std::pmr::polymorphic_allocator<pair<const u32, u32>>;
+    allocator::arena_resource arena{};
+    map<u32, u32, std::less<u32>, alloc> values{ alloc{ &arena } };
+    values.emplace(1, 2);
+    ASSERT_EQ(2, values.at(1));
+
+    const auto shared = pmr::make_shared<u64>(&arena, 42);
+    ASSERT_EQ(42, *shared);
+}
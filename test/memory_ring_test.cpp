@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+#include "../include/utils/memory.h"
+#include "../include/utils/complex/collections.h"
+
+TEST(RingTest, capacity_is_rounded_to_page) {
+    allocator::ring ring{};
+    ASSERT_EQ(allocator::ring::status::SUCCESS, allocator::ring::create(100, &ring));
+    ASSERT_EQ(0, ring.capacity % sysconf(_SC_PAGESIZE));
+    ASSERT_EQ(ring.capacity, ring.writable());
+    ASSERT_TRUE(ring.is_empty());
+}
+
+TEST(RingTest, data_is_continuous_across_the_end) {
+    allocator::ring ring{};
+    ASSERT_EQ(allocator::ring::status::SUCCESS, allocator::ring::create(4 * KB, &ring));
+    const size_t capacity = ring.capacity;
+
+    // Move the start close to the end of the mapping
+    vec<u8> filler(capacity - 10, 0);
+    ASSERT_EQ(allocator::ring::status::SUCCESS, ring.write(filler.data(), filler.size()));
+    ring.consume(filler.size());
+
+    const str message = "message which wraps around the end of the buffer";
+    ASSERT_EQ(allocator::ring::status::SUCCESS, ring.write(message.data(), message.size()));
+    ASSERT_EQ(message, str(reinterpret_cast<const char*>(ring.read_ptr()), ring.readable()));
+
+    // Beginning of the mapping sees the wrapped part
+    ASSERT_EQ(0, std::memcmp(ring.data, message.data() + 10, message.size() - 10));
+
+    ring.consume(message.size());
+    ASSERT_TRUE(ring.is_empty());
+    ASSERT_LT(ring.start, capacity);
+}
+
+TEST(RingTest, write_fails_when_full) {
+    allocator::ring ring{};
+    ASSERT_EQ(allocator::ring::status::SUCCESS, allocator::ring::create(4 * KB, &ring));
+    vec<u8> data(ring.capacity, 1);
+    ASSERT_EQ(allocator::ring::status::SUCCESS, ring.write(data.data(), data.size()));
+    ASSERT_EQ(allocator::ring::status::NOT_ENOUGH_SPACE, ring.write(data.data(), 1));
+    ASSERT_EQ(allocator::ring::status::NOT_ENOUGH_SPACE, ring.commit(1));
+}
+
+TEST(StackTest, clear_start_keeps_remaining_data) {
+    u8 buffer[16]{};
+    allocator::stack stack{ buffer, sizeof(buffer) };
+    for (u8 i = 0; i < 8; i++) buffer[i] = i;
+    stack.head = 8;
+
+    stack.clear_start(3);
+    ASSERT_EQ(5, stack.head);
+    for (u8 i = 0; i < 5; i++) ASSERT_EQ(i + 3, buffer[i]);
+}
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include "../include/utils/proto_schema.h"
+
+using update = proto1::schema<u32, f32, i64, proto1::array<u8>, proto1::array<f32>, u8>;
+enum update_field { ID, X, TIME, NAME, WEIGHTS, FLAGS };
+
+TEST(ProtoSchemaTest, layout_is_computed_at_compile_time) {
+    static_assert(update::OFFSETS[ID] == 0);
+    static_assert(update::OFFSETS[X] == 4);
+    static_assert(update::OFFSETS[TIME] == 8);
+    static_assert(update::OFFSETS[NAME] == 16);
+    static_assert(update::OFFSETS[WEIGHTS] == 24);
+    static_assert(update::OFFSETS[FLAGS] == 32);
+    static_assert(update::FIXED_SIZE == 33);
+    static_assert(std::is_same_v<update::field<TIME>, i64>);
+}
+
+TEST(ProtoSchemaTest, encoded_fields_are_read_in_place) {
+    const str name = "vertex";
+    const vec<f32> weights{ 0.5f, -1.0f, 3.25f };
+    const size_t size = proto1::encoded_size<update>(7u, 1.5f, i64{ -42 }, name, weights, u8{ 3 });
+    ASSERT_EQ(update::FIXED_SIZE + 6 + 12, size);
+
+    vec<u8> buffer(size);
+    ASSERT_EQ(size, proto1::encode<update>(buffer.data(), 7u, 1.5f, i64{ -42 }, name, weights, u8{ 3 }));
+    // Little-endian regardless of the platform
+    ASSERT_EQ(7, buffer[0]);
+    ASSERT_EQ(0, buffer[1]);
+
+    proto1::flat_view<update> view{};
+    ASSERT_EQ(sys::status::SUCCESS, proto1::flat_view<update>::open(buffer.data(), buffer.size(), &view));
+    ASSERT_EQ(7, view.get<ID>());
+    ASSERT_EQ(1.5f, view.get<X>());
+    ASSERT_EQ(-42, view.get<TIME>());
+    ASSERT_EQ(3, view.get<FLAGS>());
+    ASSERT_EQ("vertex", view.get<NAME>().as_string());
+    // Array points into the buffer, nothing is copied
+    ASSERT_EQ(buffer.data() + update::FIXED_SIZE, view.get<NAME>().data);
+
+    const auto w = view.get<WEIGHTS>();
+    ASSERT_EQ(3, w.size());
+    ASSERT_EQ(0.5f, w[0]);
+    ASSERT_EQ(-1.0f, w[1]);
+    ASSERT_EQ(3.25f, w[2]);
+}
+
+TEST(ProtoSchemaTest, invalid_payload_is_rejected) {
+    const vec<f32> weights{ 1.0f, 2.0f };
+    vec<u8> buffer(proto1::encoded_size<update>(1u, 0.0f, i64{ 0 }, str{}, weights, u8{ 0 }));
+    proto1::encode<update>(buffer.data(), 1u, 0.0f, i64{ 0 }, str{}, weights, u8{ 0 });
+
+    proto1::flat_view<update> view{};
+    ASSERT_EQ(sys::status::INVALID_FORMAT, proto1::flat_view<update>::open(buffer.data(), update::FIXED_SIZE - 1, &view));
+    // Array doesn't fit into the truncated payload
+    ASSERT_EQ(sys::status::INVALID_FORMAT, proto1::flat_view<update>::open(buffer.data(), buffer.size() - 1, &view));
+
+    // Array offset points into the fixed part
+    bits::store_le<u32>(4, buffer.data() + update::OFFSETS[WEIGHTS]);
+    ASSERT_EQ(sys::status::INVALID_FORMAT, proto1::flat_view<update>::open(buffer.data(), buffer.size(), &view));
+}
+
+TEST(ProtoSchemaTest, message_is_encoded_into_send_buffer) {
+    using namespace sys::socket;
+    tcp_acceptor acceptor{};
+    tcp_socket client_socket{}, server_socket{};
+    ASSERT_EQ(sys::status::SUCCESS, tcp_acceptor::listen("127.0.0.1", 0, &acceptor));
+    ASSERT_EQ(sys::status::SUCCESS, tcp_socket::create("127.0.0.1", acceptor.port(), 64 * KB, &client_socket));
+    ASSERT_EQ(sys::status::SUCCESS, client_socket.finish_connect(1000));
+    pollfd descriptor{ .fd = acceptor.socket_fd, .events = POLLIN, .revents = 0 };
+    ASSERT_EQ(1, ::poll(&descriptor, 1, 1000));
+    ASSERT_EQ(sys::status::SUCCESS, acceptor.accept(64 * KB, &server_socket));
+    proto1::connection client{ std::move(client_socket) };
+    proto1::connection server{ std::move(server_socket) };
+
+    for (u32 i = 0; i < 100; i++) {
+        const vec<f32> weights(i, static_cast<f32>(i));
+        ASSERT_EQ(sys::status::SUCCESS, proto1::write_flat<update>(client, 5, i, i, 0.0f, i64{ i } * -1, str("n") + std::to_string(i), weights, u8{ 1 }));
+    }
+    ASSERT_EQ(sys::status::SUCCESS, client.flush());
+
+    u32 received = 0;
+    while (received < 100) {
+        descriptor = { .fd = server.socket.socket_fd, .events = POLLIN, .revents = 0 };
+        ::poll(&descriptor, 1, 100);
+        server.poll();
+        proto1::message m{};
+        while (server.read_message(&m) == sys::status::SUCCESS) {
+            proto1::flat_view<update> view{};
+            ASSERT_EQ(sys::status::SUCCESS, proto1::flat_view<update>::open(m, &view));
+            ASSERT_EQ(received, m.id);
+            ASSERT_EQ(received, view.get<ID>());
+            ASSERT_EQ(-static_cast<i64>(received), view.get<TIME>());
+            ASSERT_EQ("n" + std::to_string(received), view.get<NAME>().as_string());
+            ASSERT_EQ(received, view.get<WEIGHTS>().size());
+            received += 1;
+        }
+        server.clear_message();
+    }
+}
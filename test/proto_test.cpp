@@ -0,0 +1,411 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "../include/utils/proto.h"
+
+using namespace sys::socket;
+
+static void connect_pair(tcp_acceptor& acceptor, tcp_socket* const client, tcp_socket* const server, const size_t buffer_size) {
+    ASSERT_EQ(sys::status::SUCCESS, tcp_acceptor::listen("127.0.0.1", 0, &acceptor));
+    ASSERT_EQ(sys::status::SUCCESS, tcp_socket::create("127.0.0.1", acceptor.port(), buffer_size, client));
+    ASSERT_EQ(sys::status::SUCCESS, client->finish_connect(1000));
+    pollfd descriptor{ .fd = acceptor.socket_fd, .events = POLLIN, .revents = 0 };
+    ASSERT_EQ(1, ::poll(&descriptor, 1, 1000));
+    ASSERT_EQ(sys::status::SUCCESS, acceptor.accept(buffer_size, server));
+}
+
+static void wait_readable(proto1::connection& c) {
+    pollfd descriptor{ .fd = c.socket.socket_fd, .events = POLLIN, .revents = 0 };
+    ::poll(&descriptor, 1, 100);
+}
+
+TEST(ProtoTest, frame_is_parsed_incrementally) {
+    const str payload(300, 'p');
+    u8 frame[proto1::HEADER_MAX_SIZE + 300];
+    const size_t header_size = proto1::write_header(42, payload.size(), frame, 1000);
+    ASSERT_EQ(5, header_size);
+    std::memcpy(frame + header_size, payload.data(), payload.size());
+    const size_t frame_size = header_size + payload.size();
+
+    proto1::message m{};
+    size_t parsed = 0;
+    for (size_t available = 0; available < frame_size; available++) {
+        ASSERT_EQ(sys::status::WOULD_BLOCK, proto1::parse_frame(frame, available, &m, &parsed));
+    }
+    ASSERT_EQ(sys::status::SUCCESS, proto1::parse_frame(frame, frame_size, &m, &parsed));
+    ASSERT_EQ(frame_size, parsed);
+    ASSERT_EQ(42, m.type);
+    ASSERT_EQ(1000, m.id);
+    ASSERT_EQ(frame + header_size, m.data);
+    ASSERT_EQ(payload, str(reinterpret_cast<const char*>(m.data), m.size));
+
+    u8 invalid[12];
+    std::fill(invalid, invalid + 12, 0xFF);
+    ASSERT_EQ(sys::status::INVALID_FORMAT, proto1::parse_frame(invalid, 12, &m, &parsed));
+}
+
+TEST(ProtoTest, messages_are_received_in_order) {
+    tcp_acceptor acceptor{};
+    tcp_socket client_socket{}, server_socket{};
+    connect_pair(acceptor, &client_socket, &server_socket, 256 * KB);
+    proto1::connection client{ std::move(client_socket) };
+    proto1::connection server{ std::move(server_socket) };
+
+    constexpr u32 messages = 2000;
+    for (u32 i = 0; i < messages; i++) {
+        // Some messages are bigger than a single read and cross the end of the ring
+        const str payload(i % 100 == 0 ? 100 * KB : i % 37, static_cast<char>('a' + i % 26));
+        const sys::status s = client.write_message(static_cast<u8>(i), payload.data(), payload.size());
+        // Full batches are flushed right away, so the socket can become full
+        ASSERT_TRUE(s == sys::status::SUCCESS || s == sys::status::WOULD_BLOCK);
+    }
+
+    u32 received = 0;
+    u32 most_in_one_read = 0;
+    while (received < messages) {
+        const sys::status flush_status = client.flush();
+        ASSERT_TRUE(flush_status == sys::status::SUCCESS || flush_status == sys::status::WOULD_BLOCK);
+        wait_readable(server);
+        if (!server.poll()) continue;
+
+        u32 in_this_read = 0;
+        proto1::message m{};
+        sys::status s = sys::status::SUCCESS;
+        while ((s = server.read_message(&m)) == sys::status::SUCCESS) {
+            const u32 i = received++;
+            ASSERT_EQ(static_cast<u8>(i), m.type);
+            ASSERT_EQ(i % 100 == 0 ? 100 * KB : i % 37, m.size);
+            for (size_t b = 0; b < m.size; b++) ASSERT_EQ(static_cast<char>('a' + i % 26), m.data[b]);
+            in_this_read += 1;
+        }
+        ASSERT_EQ(sys::status::WOULD_BLOCK, s);
+        server.clear_message();
+        most_in_one_read = std::max(most_in_one_read, in_this_read);
+    }
+    ASSERT_EQ(messages, received);
+    ASSERT_GT(most_in_one_read, 1);
+}
+
+TEST(ProtoTest, message_bigger_than_buffer_is_invalid) {
+    tcp_acceptor acceptor{};
+    tcp_socket client_socket{}, server_socket{};
+    connect_pair(acceptor, &client_socket, &server_socket, 4096);
+    proto1::connection client{ std::move(client_socket) };
+    proto1::connection server{ std::move(server_socket) };
+
+    const size_t capacity = server.socket.incoming_buffer.writable();
+    const str payload(capacity, 'x');
+    ASSERT_EQ(sys::status::SUCCESS, client.write_message(1, payload.data(), payload.size()));
+    client.flush();
+
+    proto1::message m{};
+    sys::status s = sys::status::WOULD_BLOCK;
+    for (u32 attempt = 0; attempt < 100 && s == sys::status::WOULD_BLOCK; attempt++) {
+        wait_readable(server);
+        server.poll();
+        s = server.read_message(&m);
+    }
+    ASSERT_EQ(sys::status::INVALID_FORMAT, s);
+}
+
+// Reads everything the other side sent, returns received payloads
+static vec<str> receive_all(proto1::connection& c, const size_t expected) {
+    vec<str> payloads{};
+    for (u32 attempt = 0; attempt < 100 && payloads.size() < expected; attempt++) {
+        wait_readable(c);
+        c.poll();
+        proto1::message m{};
+        while (c.read_message(&m) == sys::status::SUCCESS) payloads.emplace_back(reinterpret_cast<const char*>(m.data), m.size);
+        c.clear_message();
+    }
+    return payloads;
+}
+
+TEST(ProtoTest, payloads_are_compressed_when_both_sides_offer) {
+    tcp_acceptor acceptor{};
+    tcp_socket client_socket{}, server_socket{};
+    connect_pair(acceptor, &client_socket, &server_socket, 64 * KB);
+    proto1::connection client{ std::move(client_socket) };
+    proto1::connection server{ std::move(server_socket) };
+
+    proto1::message m{};
+    ASSERT_EQ(sys::status::SUCCESS, client.offer_compression());
+    client.flush();
+    wait_readable(server);
+    ASSERT_TRUE(server.poll());
+    // Control messages are never returned
+    ASSERT_EQ(sys::status::WOULD_BLOCK, server.read_message(&m));
+    // Only one side offered
+    ASSERT_FALSE(client.compresses(1000));
+    ASSERT_FALSE(server.compresses(1000));
+
+    ASSERT_EQ(sys::status::SUCCESS, server.offer_compression());
+    server.flush();
+    wait_readable(client);
+    ASSERT_TRUE(client.poll());
+    ASSERT_EQ(sys::status::WOULD_BLOCK, client.read_message(&m));
+    ASSERT_TRUE(client.compresses(1000));
+    ASSERT_FALSE(client.compresses(10));
+
+    str text{};
+    while (text.size() < 4 * KB) text += "{\"id\":" + std::to_string(text.size() % 97) + ",\"name\":\"player\"}";
+    const str small = "ping";
+    std::mt19937 generator{ 42 };
+    str random(1000, 0);
+    for (char& c : random) c = static_cast<char>(generator());
+    const str payloads[] = { text, small, random, text };
+    for (const str& payload : payloads) {
+        ASSERT_EQ(sys::status::SUCCESS, client.write_message(1, payload.data(), payload.size()));
+    }
+    client.flush();
+
+    const vec<str> received = receive_all(server, 4);
+    ASSERT_EQ(4, received.size());
+    for (size_t i = 0; i < 4; i++) ASSERT_EQ(payloads[i], received[i]);
+
+    // Small message is not counted, random one is sent as is
+    const proto1::compression_statistics& sent = client.compression_sent();
+    ASSERT_EQ(3, sent.messages);
+    ASSERT_EQ(2, sent.compressed);
+    ASSERT_GT(sent.ratio(), 2.0);
+    const proto1::compression_statistics& got = server.compression_received();
+    ASSERT_EQ(3, got.messages);
+    ASSERT_EQ(2, got.compressed);
+    ASSERT_EQ(sent.raw_bytes, got.raw_bytes);
+    ASSERT_EQ(sent.wire_bytes, got.wire_bytes);
+
+    // Compression works in both directions
+    ASSERT_EQ(sys::status::SUCCESS, server.write_message(2, text.data(), text.size()));
+    server.flush();
+    const vec<str> replies = receive_all(client, 1);
+    ASSERT_EQ(1, replies.size());
+    ASSERT_EQ(text, replies[0]);
+    ASSERT_EQ(1, client.compression_received().compressed);
+}
+
+TEST(ProtoTest, small_messages_are_batched) {
+    tcp_acceptor acceptor{};
+    tcp_socket client_socket{}, server_socket{};
+    connect_pair(acceptor, &client_socket, &server_socket, 1 * MB);
+    proto1::connection client{ std::move(client_socket) };
+    proto1::connection server{ std::move(server_socket) };
+    client.batch_size = 16 * KB;
+    // Nothing can become due while the test runs, however slow the machine is
+    client.batch_delay = std::chrono::hours{ 1 };
+
+    // 11 bytes per frame, so the batch is sent automatically every ~1500 messages
+    const u8 payload[8]{};
+    for (u32 i = 0; i < 10000; i++) {
+        ASSERT_EQ(sys::status::SUCCESS, client.write_message(1, payload, sizeof(payload)));
+    }
+    ASSERT_EQ(6, client.sent().flushes);
+    ASSERT_GT(client.socket.outgoing_buffer.queued(), 0);
+
+    // The rest is sent only after the delay
+    ASSERT_EQ(sys::status::SUCCESS, client.flush_if_due());
+    ASSERT_EQ(6, client.sent().flushes);
+    client.batch_delay = std::chrono::microseconds{ 0 };
+    ASSERT_LE(client.flush_deadline(), proto1::connection::clock::now());
+    ASSERT_EQ(sys::status::SUCCESS, client.flush_if_due());
+    ASSERT_EQ(7, client.sent().flushes);
+    ASSERT_EQ(proto1::connection::clock::time_point::max(), client.flush_deadline());
+
+    const proto1::statistics& stats = client.sent();
+    ASSERT_EQ(10000, stats.messages);
+    ASSERT_EQ(110000, stats.bytes);
+    ASSERT_GT(stats.messages_per_flush(), 1000.0);
+    ASSERT_GT(stats.bytes_per_syscall(), 10000.0);
+
+    u32 received = 0;
+    while (received < 10000) {
+        wait_readable(server);
+        server.poll();
+        proto1::message m{};
+        while (server.read_message(&m) == sys::status::SUCCESS) received += 1;
+        server.clear_message();
+    }
+}
+
+static proto1::task request_double(proto1::multiplexer& mux, const u32 value, vec<u32>& results, u32& failed) {
+    const proto1::reply r = co_await mux.request(1, &value, sizeof(value));
+    if (r.status != sys::status::SUCCESS) {
+        failed += 1;
+        co_return;
+    }
+    u32 result = 0;
+    std::memcpy(&result, r.content.data, sizeof(result));
+    results[value] = result;
+}
+
+TEST(ProtoTest, replies_resume_their_requests) {
+    tcp_acceptor acceptor{};
+    tcp_socket client_socket{}, server_socket{};
+    connect_pair(acceptor, &client_socket, &server_socket, 1 * MB);
+    proto1::connection client{ std::move(client_socket) };
+    proto1::connection server{ std::move(server_socket) };
+
+    // Server answers only when it has every request, in the reverse order
+    constexpr u32 requests = 1000;
+    vec<pair<u64, u32>> received{};
+    proto1::multiplexer server_mux{ server, [&](const proto1::message& m) {
+        u32 value = 0;
+        std::memcpy(&value, m.data, sizeof(value));
+        received.emplace_back(m.id, value);
+    } };
+    proto1::multiplexer client_mux{ client };
+
+    sys::event_loop loop{};
+    ASSERT_EQ(sys::status::SUCCESS, sys::event_loop::create(&loop));
+    ASSERT_EQ(sys::status::SUCCESS, loop.add(client.socket, [&](const u32 events) {
+        if (events & sys::event_loop::READABLE) client_mux.dispatch();
+        if (events & sys::event_loop::WRITABLE) client.flush();
+    }));
+    ASSERT_EQ(sys::status::SUCCESS, loop.add(server.socket, [&](const u32 events) {
+        if (events & sys::event_loop::READABLE) server_mux.dispatch();
+        if (received.size() == requests) {
+            for (auto it = received.rbegin(); it != received.rend(); it++) {
+                const u32 doubled = it->second * 2;
+                proto1::message request{ .id = it->first };
+                server_mux.respond(request, 2, &doubled, sizeof(doubled));
+            }
+            received.clear();
+        }
+        server.flush();
+    }));
+
+    vec<u32> results(requests, 0);
+    u32 failed = 0;
+    for (u32 i = 0; i < requests; i++) request_double(client_mux, i, results, failed);
+    ASSERT_EQ(requests, client_mux.in_flight());
+    client.flush();
+
+    for (u32 i = 0; i < 1000 && client_mux.in_flight() != 0; i++) loop.run_once(100);
+    ASSERT_EQ(0, client_mux.in_flight());
+    ASSERT_EQ(0, failed);
+    for (u32 i = 0; i < requests; i++) ASSERT_EQ(2 * i, results[i]);
+
+    loop.remove(client.socket);
+    loop.remove(server.socket);
+}
+
+static proto1::task request_both_await_reversed(proto1::multiplexer& mux, vec<u32>& results) {
+    const u32 first = 1, second = 2;
+    proto1::multiplexer::awaiter a = mux.request(1, &first, sizeof(first));
+    proto1::multiplexer::awaiter b = mux.request(1, &second, sizeof(second));
+    for (proto1::multiplexer::awaiter* next : { &b, &a }) {
+        const proto1::reply r = co_await *next;
+        u32 result = 0;
+        if (r.status == sys::status::SUCCESS) std::memcpy(&result, r.content.data, sizeof(result));
+        results.emplace_back(result);
+    }
+}
+
+TEST(ProtoTest, requests_can_be_awaited_in_any_order) {
+    tcp_acceptor acceptor{};
+    tcp_socket client_socket{}, server_socket{};
+    connect_pair(acceptor, &client_socket, &server_socket, 4096);
+    proto1::connection client{ std::move(client_socket) };
+    proto1::connection server{ std::move(server_socket) };
+    proto1::multiplexer mux{ client };
+
+    vec<u32> results{};
+    request_both_await_reversed(mux, results);
+    ASSERT_EQ(sys::status::SUCCESS, client.flush());
+
+    vec<proto1::message> requests{};
+    for (u32 attempt = 0; attempt < 1000 && requests.size() < 2; attempt++) {
+        wait_readable(server);
+        server.poll();
+        proto1::message m{};
+        while (server.read_message(&m) == sys::status::SUCCESS) requests.emplace_back(m);
+    }
+    ASSERT_EQ(2, requests.size());
+
+    const auto reply_and_dispatch = [&](const proto1::message& request, const size_t in_flight) {
+        u32 value = 0;
+        std::memcpy(&value, request.data, sizeof(value));
+        const u32 doubled = value * 2;
+        ASSERT_EQ(sys::status::SUCCESS, server.write_message(2, &doubled, sizeof(doubled), request.id));
+        ASSERT_EQ(sys::status::SUCCESS, server.flush());
+        for (u32 attempt = 0; attempt < 1000 && mux.in_flight() != in_flight; attempt++) {
+            wait_readable(client);
+            ASSERT_EQ(sys::status::SUCCESS, mux.dispatch());
+        }
+        ASSERT_EQ(in_flight, mux.in_flight());
+    };
+
+    // Reply to the first request arrives while the coroutine awaits the second one,
+    // the receive buffer is reused by the next dispatch() before the first reply is awaited
+    reply_and_dispatch(requests[0], 1);
+    ASSERT_TRUE(results.empty());
+    reply_and_dispatch(requests[1], 0);
+    server.clear_message();
+    ASSERT_EQ((vec<u32>{ 4, 2 }), results);
+    ASSERT_EQ(0, mux.in_flight());
+}
+
+TEST(ProtoTest, fail_all_resumes_waiting_requests) {
+    tcp_acceptor acceptor{};
+    tcp_socket client_socket{}, server_socket{};
+    connect_pair(acceptor, &client_socket, &server_socket, 4096);
+    proto1::connection client{ std::move(client_socket) };
+    proto1::multiplexer mux{ client };
+
+    vec<u32> results(10, 0);
+    u32 failed = 0;
+    for (u32 i = 0; i < 10; i++) request_double(mux, i, results, failed);
+    ASSERT_EQ(10, mux.in_flight());
+    mux.fail_all(sys::status::CONNECTION_FAILED);
+    ASSERT_EQ(10, failed);
+    ASSERT_EQ(0, mux.in_flight());
+}
+
+TEST(ProtoTest, dispatch_reports_closed_connection) {
+    tcp_acceptor acceptor{};
+    tcp_socket client_socket{}, server_socket{};
+    connect_pair(acceptor, &client_socket, &server_socket, 4096);
+    proto1::connection client{ std::move(client_socket) };
+    proto1::multiplexer mux{ client };
+
+    vec<u32> results(10, 0);
+    u32 failed = 0;
+    for (u32 i = 0; i < 10; i++) request_double(mux, i, results, failed);
+    ASSERT_EQ(sys::status::SUCCESS, client.flush());
+    ASSERT_EQ(sys::status::SUCCESS, mux.dispatch());
+    ASSERT_EQ(10, mux.in_flight());
+
+    // Server reads the requests and goes away without answering
+    // (unread data would make it reset the connection instead)
+    {
+        proto1::connection server{ std::move(server_socket) };
+        u32 received = 0;
+        for (u32 attempt = 0; attempt < 1000 && received < 10; attempt++) {
+            server.poll();
+            proto1::message m{};
+            while (server.read_message(&m) == sys::status::SUCCESS) received += 1;
+            server.clear_message();
+        }
+        ASSERT_EQ(10, received);
+    }
+    sys::status s = sys::status::SUCCESS;
+    for (u32 attempt = 0; attempt < 1000 && s == sys::status::SUCCESS; attempt++) s = mux.dispatch();
+    ASSERT_EQ(sys::status::CONNECTION_CLOSED, s);
+    ASSERT_EQ(10, failed);
+    ASSERT_EQ(0, mux.in_flight());
+}
+
+TEST(ProtoTest, destroyed_multiplexer_destroys_waiting_requests) {
+    tcp_acceptor acceptor{};
+    tcp_socket client_socket{}, server_socket{};
+    connect_pair(acceptor, &client_socket, &server_socket, 4096);
+    proto1::connection client{ std::move(client_socket) };
+
+    vec<u32> results(10, 0);
+    u32 failed = 0;
+    {
+        proto1::multiplexer mux{ client };
+        for (u32 i = 0; i < 10; i++) request_double(mux, i, results, failed);
+        ASSERT_EQ(10, mux.in_flight());
+    }
+    // Coroutines are destroyed without being resumed
+    ASSERT_EQ(0, failed);
+}
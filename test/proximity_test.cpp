@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "../include/utils/complex/proximity.h"
+
+static vec<vec2> random_points(const u32 size, const u32 seed) {
+    std::mt19937 random{ seed };
+    std::uniform_real_distribution<f32> coordinate{ 0.f, 100.f };
+    vec<vec2> points{};
+    for (u32 i = 0; i < size; i++) points.emplace_back(coordinate(random), coordinate(random));
+    return points;
+}
+
+TEST(ProximityTest, radius_matches_brute_force) {
+    const auto points = random_points(3000, 1);
+    const f32 radius = 3.f;
+    const csr edges = proximity::radius(points, radius, 4);
+
+    ASSERT_EQ(points.size(), edges.vertices());
+    for (u32 i = 0; i < points.size(); i++) {
+        vec<u32> expected{};
+        for (u32 j = 0; j < points.size(); j++) {
+            if (i != j && proximity::distance2(points[i], points[j]) <= radius * radius) expected.emplace_back(j);
+        }
+        const vec<u32> actual(edges.targets.begin() + edges.offsets[i], edges.targets.begin() + edges.offsets[i + 1]);
+        ASSERT_EQ(expected, actual);
+    }
+}
+
+TEST(ProximityTest, nearest_matches_brute_force) {
+    const auto points = random_points(2000, 2);
+    const u32 k = 5;
+    const csr edges = proximity::nearest(points, k, 4);
+
+    for (u32 i = 0; i < points.size(); i++) {
+        vec<pair<f32, u32>> all{};
+        for (u32 j = 0; j < points.size(); j++) {
+            if (i != j) all.emplace_back(proximity::distance2(points[i], points[j]), j);
+        }
+        std::sort(all.begin(), all.end());
+
+        ASSERT_EQ(k, edges.offsets[i + 1] - edges.offsets[i]);
+        for (u32 n = edges.offsets[i]; n < edges.offsets[i + 1]; n++) {
+            const f32 d = proximity::distance2(points[i], points[edges.targets[n]]);
+            ASSERT_LE(d, all[k - 1].first);
+        }
+    }
+}
+
+TEST(ProximityTest, radius_graph_contains_all_vertices) {
+    const vec<vec2> points{ vec2{ 0, 0 }, vec2{ 1, 0 }, vec2{ 10, 0 } };
+    const graph g = proximity::radius_graph(points, 1.5f);
+
+    ASSERT_EQ(3, g.vertices().size());
+    ASSERT_EQ(2, g.connections().size());
+    ASSERT_EQ(1, g.neighbours(0)[0].second);
+    ASSERT_EQ(0, g.neighbours(1)[0].second);
+}
+
+TEST(ProximityTest, non_finite_input_is_rejected) {
+    const f32 inf = std::numeric_limits<f32>::infinity();
+    const f32 nan = std::numeric_limits<f32>::quiet_NaN();
+    const vec<vec2> points{ vec2{ 0, 0 }, vec2{ 1, 0 } };
+    ASSERT_THROW(proximity::radius(points, nan), std::invalid_argument);
+    ASSERT_THROW(proximity::radius(points, inf), std::invalid_argument);
+    ASSERT_THROW(proximity::radius({ vec2{ 0, 0 }, vec2{ nan, 0 } }, 1.f), std::invalid_argument);
+    ASSERT_THROW(proximity::nearest({ vec2{ 0, inf }, vec2{ 1, 0 } }, 1), std::invalid_argument);
+    ASSERT_THROW(proximity::nearest({ vec2{ -3e38f, 0 }, vec2{ 3e38f, 0 } }, 1), std::invalid_argument);
+    ASSERT_EQ(2, proximity::radius(points, 1.f).targets.size());
+}
+
+TEST(ProximityTest, nearest_with_less_points_than_k) {
+    const vec<vec2> points{ vec2{ 0, 0 }, vec2{ 1, 0 }, vec2{ 5, 5 } };
+    const csr edges = proximity::nearest(points, 10);
+    ASSERT_EQ(6, edges.targets.size());
+}
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include "../include/utils/stream.h"
+
+static str write_lines(const char* const path, const u32 lines) {
+    str content{};
+    for (u32 i = 0; i < lines; i++) content += "line " + std::to_string(i) + (i % 7 == 0 ? " longer line" : "") + "\n";
+    sys::file::output output{};
+    sys::file::create(path, &output);
+    output.write(content.data(), content.size());
+    return content;
+}
+
+TEST(StreamTest, chunks_contain_whole_file) {
+    const str content = write_lines("stream.txt", 1000);
+    for (const bool readahead : { true, false }) {
+        sys::file::chunk_reader reader{};
+        ASSERT_EQ(sys::status::SUCCESS, sys::file::chunk_reader::open("stream.txt", &reader, 64, readahead));
+
+        str result{};
+        std::span<const u8> chunk{};
+        while (true) {
+            ASSERT_EQ(sys::status::SUCCESS, reader.next(&chunk));
+            if (chunk.empty()) break;
+            ASSERT_LE(chunk.size(), 64);
+            result.append(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+        }
+        ASSERT_EQ(content, result);
+        ASSERT_EQ(sys::status::SUCCESS, reader.next(&chunk));
+        ASSERT_TRUE(chunk.empty());
+    }
+    remove("stream.txt");
+}
+
+TEST(StreamTest, records_cross_chunk_borders) {
+    const str content = write_lines("stream.txt", 1000);
+    for (const size_t chunk_size : { 1, 5, 13, 64, 4096 }) {
+        sys::file::chunk_reader reader{};
+        ASSERT_EQ(sys::status::SUCCESS, sys::file::chunk_reader::open("stream.txt", &reader, chunk_size));
+        sys::file::record_reader lines{ reader };
+
+        u32 count = 0;
+        std::string_view line{};
+        while (lines.next(&line)) {
+            const str expected = "line " + std::to_string(count) + (count % 7 == 0 ? " longer line" : "");
+            ASSERT_EQ(expected, line);
+            count += 1;
+        }
+        ASSERT_EQ(1000, count);
+        ASSERT_EQ(sys::status::SUCCESS, lines.error());
+    }
+    remove("stream.txt");
+}
+
+TEST(StreamTest, last_record_without_delimiter) {
+    sys::file::output output{};
+    ASSERT_EQ(sys::status::SUCCESS, sys::file::create("stream.txt", &output));
+    const str content = "a;;bc;def";
+    output.write(content.data(), content.size());
+
+    sys::file::chunk_reader reader{};
+    ASSERT_EQ(sys::status::SUCCESS, sys::file::chunk_reader::open("stream.txt", &reader, 2));
+    sys::file::record_reader records{ reader, ';' };
+    vec<str> result{};
+    std::string_view record{};
+    while (records.next(&record)) result.emplace_back(record);
+    ASSERT_EQ((vec<str>{ "a", "", "bc", "def" }), result);
+    remove("stream.txt");
+}
+
+TEST(StreamTest, open_returns_file_not_found) {
+    sys::file::chunk_reader reader{};
+    ASSERT_EQ(sys::status::FILE_NOT_FOUND, sys::file::chunk_reader::open("missing.txt", &reader));
+}
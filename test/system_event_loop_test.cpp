@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include "../include/utils/system.h"
+
+using namespace std::chrono_literals;
+
+static void nonblocking_pair(fd_t* const fds) {
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds));
+}
+
+TEST(EventLoopTest, handler_receives_readiness) {
+    sys::event_loop loop{};
+    ASSERT_EQ(sys::status::SUCCESS, sys::event_loop::create(&loop));
+    fd_t fds[2];
+    nonblocking_pair(fds);
+
+    u32 received = 0;
+    str data{};
+    ASSERT_EQ(sys::status::SUCCESS, loop.add(fds[0], [&](const u32 events) {
+        received |= events;
+        char buffer[4];
+        ssize_t r = 0;
+        while ((r = ::read(fds[0], buffer, sizeof(buffer))) > 0) data.append(buffer, r);
+    }));
+    ASSERT_EQ(1, loop.size());
+
+    // Socket is writable right after registration
+    ASSERT_EQ(sys::status::SUCCESS, loop.run_once(0));
+    ASSERT_TRUE(received & sys::event_loop::WRITABLE);
+
+    received = 0;
+    ASSERT_EQ(5, ::write(fds[1], "hello", 5));
+    ASSERT_EQ(sys::status::SUCCESS, loop.run_once(1000));
+    ASSERT_TRUE(received & sys::event_loop::READABLE);
+    ASSERT_EQ("hello", data);
+
+    // Edge-triggered: nothing new happened, so the handler is not called again
+    received = 0;
+    u32 dispatched = 1;
+    ASSERT_EQ(sys::status::SUCCESS, loop.run_once(0, &dispatched));
+    ASSERT_EQ(0, dispatched);
+
+    close(fds[1]);
+    ASSERT_EQ(sys::status::SUCCESS, loop.run_once(1000));
+    ASSERT_TRUE(received & sys::event_loop::CLOSED);
+
+    ASSERT_EQ(sys::status::SUCCESS, loop.remove(fds[0]));
+    ASSERT_EQ(sys::status::INVALID_ARGUMENT, loop.remove(fds[0]));
+    ASSERT_EQ(0, loop.size());
+    close(fds[0]);
+}
+
+TEST(EventLoopTest, tcp_socket_drains_on_notification) {
+    sys::event_loop loop{};
+    ASSERT_EQ(sys::status::SUCCESS, sys::event_loop::create(&loop));
+    fd_t fds[2];
+    nonblocking_pair(fds);
+
+    sys::socket::tcp_socket socket{};
+    ASSERT_EQ(allocator::ring::status::SUCCESS, allocator::ring::create(4096, &socket.incoming_buffer));
+    socket.socket_fd = fds[0];
+    ASSERT_EQ(sys::status::SUCCESS, loop.add(socket, [&](const u32 events) {
+        if (events & sys::event_loop::READABLE) socket.poll();
+    }));
+
+    const str message(3000, 'x');
+    ASSERT_EQ(3000, ::write(fds[1], message.data(), message.size()));
+    ASSERT_EQ(sys::status::SUCCESS, loop.run_once(1000));
+
+    u8* data = nullptr;
+    ASSERT_EQ(3000, socket.read(&data));
+    ASSERT_EQ(message, str(reinterpret_cast<char*>(data), 3000));
+    ASSERT_EQ(sys::status::SUCCESS, loop.remove(socket));
+    close(fds[1]);
+}
+
+TEST(EventLoopTest, timers_run_in_order_of_deadlines) {
+    sys::event_loop loop{};
+    ASSERT_EQ(sys::status::SUCCESS, sys::event_loop::create(&loop));
+
+    vec<u32> order{};
+    loop.add_timer(20ms, [&]() { order.emplace_back(2); });
+    loop.add_timer(5ms, [&]() { order.emplace_back(1); });
+    const u64 cancelled = loop.add_timer(10ms, [&]() { order.emplace_back(3); });
+    loop.add_timer(30ms, [&]() { loop.stop(); });
+    ASSERT_TRUE(loop.cancel_timer(cancelled));
+    ASSERT_FALSE(loop.cancel_timer(cancelled));
+
+    const auto start = sys::event_loop::clock::now();
+    ASSERT_EQ(sys::status::SUCCESS, loop.run());
+    ASSERT_GE(sys::event_loop::clock::now() - start, 30ms);
+    ASSERT_EQ((vec<u32>{ 1, 2 }), order);
+}
+
+TEST(EventLoopTest, post_wakes_loop_from_another_thread) {
+    sys::event_loop loop{};
+    ASSERT_EQ(sys::status::SUCCESS, sys::event_loop::create(&loop));
+
+    std::thread::id executed_on{};
+    std::thread other([&]() {
+        std::this_thread::sleep_for(10ms);
+        loop.post([&]() { executed_on = std::this_thread::get_id(); });
+        loop.stop();
+    });
+    // Would block forever without the wakeup
+    ASSERT_EQ(sys::status::SUCCESS, loop.run());
+    other.join();
+    ASSERT_EQ(std::this_thread::get_id(), executed_on);
+}
+
+TEST(EventLoopTest, handlers_can_remove_and_add_descriptors) {
+    sys::event_loop loop{};
+    ASSERT_EQ(sys::status::SUCCESS, sys::event_loop::create(&loop, 16));
+
+    constexpr u32 pairs = 200;
+    vec<std::array<fd_t, 2>> fds(pairs);
+    u32 calls = 0;
+    for (u32 i = 0; i < pairs; i++) {
+        nonblocking_pair(fds[i].data());
+        const fd_t fd = fds[i][0];
+        ASSERT_EQ(sys::status::SUCCESS, loop.add(fd, [&, fd](const u32) {
+            calls += 1;
+            // Removing itself and growing the registrations while running
+            loop.remove(fd);
+            fd_t extra[2];
+            nonblocking_pair(extra);
+            loop.add(extra[0], [](const u32) {});
+            loop.remove(extra[0]);
+            close(extra[0]);
+            close(extra[1]);
+        }));
+    }
+    ASSERT_EQ(pairs, loop.size());
+
+    for (u32 i = 0; i < 100 && loop.size() != 0; i++) loop.run_once(0);
+    ASSERT_EQ(pairs, calls);
+    ASSERT_EQ(0, loop.size());
+    for (auto& pair : fds) {
+        close(pair[0]);
+        close(pair[1]);
+    }
+}
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+#include "../include/utils/system.h"
+
+TEST(SystemMapTest, mapped_file_has_file_content) {
+    sys::file::output output{};
+    ASSERT_EQ(sys::status::SUCCESS, sys::file::create("mapped.txt", &output));
+    const str content = "Hello mapped world";
+    ASSERT_EQ(sys::status::SUCCESS, output.write(content.data(), content.size()));
+
+    sys::file::mapping mapping{};
+    ASSERT_EQ(sys::status::SUCCESS, sys::file::map("mapped.txt", &mapping, sys::file::advice::SEQUENTIAL, true));
+    ASSERT_EQ(content.size(), mapping.size);
+    ASSERT_EQ(content, str(reinterpret_cast<const char*>(mapping.data), mapping.size));
+    ASSERT_EQ(sys::status::SUCCESS, mapping.advise(sys::file::advice::RANDOM, 5, 3));
+
+    remove("mapped.txt");
+}
+
+TEST(SystemMapTest, map_returns_file_not_found) {
+    sys::file::mapping mapping{};
+    ASSERT_EQ(sys::status::FILE_NOT_FOUND, sys::file::map("missing.txt", &mapping));
+    ASSERT_EQ(nullptr, mapping.data);
+}
+
+TEST(SystemMapTest, output_mapping_writes_to_file) {
+    const size_t size = 3 * 4096 + 17;
+    {
+        sys::file::output_mapping output{};
+        ASSERT_EQ(sys::status::SUCCESS, sys::file::map_output("mapped.bin", size, &output));
+        for (size_t i = 0; i < size; i++) output.data[i] = static_cast<u8>(i % 251);
+        ASSERT_EQ(sys::status::SUCCESS, output.sync());
+    }
+
+    size_t file_size = 0;
+    ASSERT_EQ(sys::status::SUCCESS, sys::file::get_size("mapped.bin", &file_size));
+    ASSERT_EQ(size, file_size);
+
+    vec<u8> data(size);
+    ASSERT_EQ(sys::status::SUCCESS, sys::file::read("mapped.bin", size, data.data()));
+    for (size_t i = 0; i < size; i++) ASSERT_EQ(i % 251, data[i]);
+
+    // Reading more than the file has is an error
+    vec<u8> more(size + 1);
+    ASSERT_NE(sys::status::SUCCESS, sys::file::read("mapped.bin", size + 1, more.data()));
+
+    remove("mapped.bin");
+}
@@ -0,0 +1,255 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include "../include/utils/system.h"
+
+using namespace sys::socket;
+
+static sys::status accept_blocking(tcp_acceptor& acceptor, tcp_socket* const socket) {
+    pollfd descriptor{ .fd = acceptor.socket_fd, .events = POLLIN, .revents = 0 };
+    if (::poll(&descriptor, 1, 1000) != 1) return sys::status::WOULD_BLOCK;
+    return acceptor.accept(4096, socket);
+}
+
+TEST(TcpTest, connects_over_loopback) {
+    tcp_acceptor acceptor{};
+    ASSERT_EQ(sys::status::SUCCESS, tcp_acceptor::listen("127.0.0.1", 0, &acceptor));
+    const u16 port = acceptor.port();
+    ASSERT_NE(0, port);
+
+    tcp_socket server{};
+    ASSERT_EQ(sys::status::WOULD_BLOCK, acceptor.accept(4096, &server));
+
+    tcp_socket client{};
+    ASSERT_EQ(sys::status::SUCCESS, tcp_socket::create("127.0.0.1", port, 4096, &client));
+    ASSERT_EQ(sys::status::SUCCESS, client.finish_connect(1000));
+    ASSERT_TRUE(client.connected);
+
+    ASSERT_EQ(sys::status::SUCCESS, accept_blocking(acceptor, &server));
+    ASSERT_TRUE(server.connected);
+
+    ASSERT_EQ(5, ::write(client.socket_fd, "hello", 5));
+    pollfd descriptor{ .fd = server.socket_fd, .events = POLLIN, .revents = 0 };
+    ASSERT_EQ(1, ::poll(&descriptor, 1, 1000));
+    ASSERT_TRUE(server.poll());
+    u8* data = nullptr;
+    ASSERT_EQ(5, server.read(&data));
+    ASSERT_EQ("hello", str(reinterpret_cast<char*>(data), 5));
+}
+
+TEST(TcpTest, connect_to_closed_port_fails) {
+    u16 port = 0;
+    {
+        tcp_acceptor acceptor{};
+        ASSERT_EQ(sys::status::SUCCESS, tcp_acceptor::listen("127.0.0.1", 0, &acceptor));
+        port = acceptor.port();
+    }
+
+    tcp_socket client{};
+    const sys::status s = tcp_socket::create("127.0.0.1", port, 4096, &client);
+    if (s == sys::status::SUCCESS) {
+        ASSERT_EQ(sys::status::CONNECTION_FAILED, client.finish_connect(1000));
+    } else {
+        ASSERT_EQ(sys::status::CONNECTION_FAILED, s);
+    }
+}
+
+TEST(TcpTest, listen_on_used_port_fails) {
+    tcp_acceptor first{};
+    ASSERT_EQ(sys::status::SUCCESS, tcp_acceptor::listen("127.0.0.1", 0, &first));
+    tcp_acceptor second{};
+    ASSERT_EQ(sys::status::ADDRESS_IN_USE, tcp_acceptor::listen("127.0.0.1", first.port(), &second));
+}
+
+TEST(TcpTest, sharded_acceptors_share_port) {
+    vec<tcp_acceptor> acceptors{};
+    ASSERT_EQ(sys::status::SUCCESS, listen_sharded("127.0.0.1", 0, 4, &acceptors));
+    ASSERT_EQ(4, acceptors.size());
+    const u16 port = acceptors[0].port();
+    for (const auto& acceptor : acceptors) ASSERT_EQ(port, acceptor.port());
+
+    constexpr u32 connections = 32;
+    vec<tcp_socket> clients(connections);
+    for (auto& client : clients) {
+        ASSERT_EQ(sys::status::SUCCESS, tcp_socket::create("127.0.0.1", port, 4096, &client));
+        ASSERT_EQ(sys::status::SUCCESS, client.finish_connect(1000));
+    }
+
+    // Every acceptor is drained on its own thread
+    std::atomic<u32> accepted = 0;
+    vec<std::thread> threads{};
+    for (auto& acceptor : acceptors) {
+        threads.emplace_back([&]() {
+            tcp_socket server{};
+            while (acceptor.accept(4096, &server) == sys::status::SUCCESS) accepted += 1;
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    ASSERT_EQ(connections, accepted.load());
+}
+
+TEST(TcpTest, resolve_failure) {
+    tcp_socket client{};
+    ASSERT_EQ(sys::status::RESOLVE_FAILED, tcp_socket::create("invalid host name", 80, 4096, &client));
+}
+
+static void connect_pair(tcp_acceptor& acceptor, tcp_socket* const client, tcp_socket* const server) {
+    ASSERT_EQ(sys::status::SUCCESS, tcp_acceptor::listen("127.0.0.1", 0, &acceptor));
+    ASSERT_EQ(sys::status::SUCCESS, tcp_socket::create("127.0.0.1", acceptor.port(), 64 * KB, client));
+    ASSERT_EQ(sys::status::SUCCESS, client->finish_connect(1000));
+    ASSERT_EQ(sys::status::SUCCESS, accept_blocking(acceptor, server));
+}
+
+// Flushes the client while draining the server, until everything is received or nothing arrives for a while
+static str transfer(tcp_socket& client, tcp_socket& server, const size_t expected) {
+    str received{};
+    u32 idle = 0;
+    while (received.size() < expected && idle < 100) {
+        const sys::status s = client.flush();
+        EXPECT_TRUE(s == sys::status::SUCCESS || s == sys::status::WOULD_BLOCK);
+        pollfd descriptor{ .fd = server.socket_fd, .events = POLLIN, .revents = 0 };
+        ::poll(&descriptor, 1, 100);
+        server.poll();
+        u8* data = nullptr;
+        const size_t size = server.read(&data);
+        received.append(reinterpret_cast<char*>(data), size);
+        server.clear(size);
+        idle = size == 0 ? idle + 1 : 0;
+    }
+    EXPECT_EQ(expected, received.size());
+    return received;
+}
+
+TEST(TcpTest, queued_writes_are_sent_in_order) {
+    tcp_acceptor acceptor{};
+    tcp_socket client{}, server{};
+    connect_pair(acceptor, &client, &server);
+
+    str expected{};
+    for (u32 i = 0; i < 10000; i++) {
+        const str message = std::to_string(i) + ";";
+        ASSERT_EQ(sys::status::SUCCESS, client.write(message.data(), message.size()));
+        expected += message;
+    }
+    ASSERT_EQ(expected.size(), client.outgoing_buffer.queued());
+
+    u64 syscalls = 0;
+    ASSERT_EQ(sys::status::SUCCESS, client.outgoing_buffer.flush(client.socket_fd, &syscalls));
+    // Small writes are merged, so a single call is enough
+    ASSERT_EQ(1, syscalls);
+    ASSERT_TRUE(client.outgoing_buffer.is_empty());
+    ASSERT_EQ(expected, transfer(client, server, expected.size()));
+}
+
+TEST(TcpTest, partial_writes_and_backpressure) {
+    tcp_acceptor acceptor{};
+    tcp_socket client{}, server{};
+    connect_pair(acceptor, &client, &server);
+
+    client.outgoing_buffer.limit = 32 * MB;
+    const str block(1 * MB, 'a');
+    str expected{};
+    for (u32 i = 0; i < 32; i++) {
+        str b = block;
+        b[0] = static_cast<char>('a' + i % 26);
+        ASSERT_EQ(sys::status::SUCCESS, client.write(b.data(), b.size()));
+        expected += b;
+    }
+    ASSERT_EQ(sys::status::NOT_ENOUGH_SPACE, client.write("x", 1));
+
+    // Nobody reads, so the socket becomes full long before 32 MB are sent
+    ASSERT_EQ(sys::status::WOULD_BLOCK, client.flush());
+    ASSERT_LT(client.outgoing_buffer.queued(), expected.size());
+    ASSERT_GT(client.outgoing_buffer.queued(), 0);
+
+    ASSERT_EQ(expected, transfer(client, server, expected.size()));
+    ASSERT_EQ(sys::status::SUCCESS, client.flush());
+}
+
+TEST(TcpTest, referenced_buffers_are_reported_when_sent) {
+    tcp_acceptor acceptor{};
+    tcp_socket client{}, server{};
+    connect_pair(acceptor, &client, &server);
+
+    // Without MSG_ZEROCOPY support buffers are still sent without copying into the queue
+    const sys::status zerocopy = client.enable_zerocopy();
+    ASSERT_TRUE(zerocopy == sys::status::SUCCESS || zerocopy == sys::status::NOT_IMPLEMENTED);
+    vec<str> buffers{};
+    for (u32 i = 0; i < 8; i++) buffers.emplace_back(256 * KB, static_cast<char>('0' + i));
+
+    str expected{};
+    for (u32 i = 0; i < buffers.size(); i++) {
+        ASSERT_EQ(sys::status::SUCCESS, client.write("header", 6));
+        ASSERT_EQ(sys::status::SUCCESS, client.write_zerocopy(buffers[i].data(), buffers[i].size(), i));
+        expected += "header" + buffers[i];
+    }
+    ASSERT_EQ(expected, transfer(client, server, expected.size()));
+
+    // Zero-copy notifications arrive asynchronously
+    vec<u64> completed{};
+    for (u32 attempt = 0; attempt < 100 && completed.size() < buffers.size(); attempt++) {
+        ASSERT_EQ(sys::status::SUCCESS, client.completed(&completed));
+        if (completed.size() < buffers.size()) {
+            pollfd descriptor{ .fd = client.socket_fd, .events = 0, .revents = 0 };
+            ::poll(&descriptor, 1, 10);
+        }
+    }
+    std::sort(completed.begin(), completed.end());
+    ASSERT_EQ((vec<u64>{ 0, 1, 2, 3, 4, 5, 6, 7 }), completed);
+    ASSERT_EQ(0, client.outgoing_buffer.pending_zerocopy());
+}
+
+TEST(TcpTest, file_transfer_sends_file_range) {
+    str content{};
+    for (u32 i = 0; i < 8000000; i++) content += static_cast<char>('a' + i % 23);
+    sys::file::output output{};
+    ASSERT_EQ(sys::status::SUCCESS, sys::file::create("transfer.bin", &output));
+    ASSERT_EQ(sys::status::SUCCESS, output.write(content.data(), content.size()));
+
+    using method = file_transfer::method;
+    // Queue limit smaller than a chunk makes COPY read less at once
+    const pair<method, size_t> cases[]{ { method::SENDFILE, 64 * MB }, { method::SPLICE, 64 * MB },
+                                        { method::COPY, 64 * MB }, { method::COPY, 1000 } };
+    for (const auto& [m, limit] : cases) {
+        tcp_acceptor acceptor{};
+        tcp_socket client{}, server{};
+        connect_pair(acceptor, &client, &server);
+        client.outgoing_buffer.limit = limit;
+
+        file_transfer transfer{};
+        ASSERT_EQ(sys::status::SUCCESS, file_transfer::open("transfer.bin", &transfer, 1000, 6000000, m));
+        ASSERT_EQ(6000000, transfer.remaining());
+        ASSERT_EQ(sys::status::SUCCESS, client.write("head", 4));
+
+        // Receiver is slower than the sender, so the transfer has to be resumed several times
+        str received{};
+        u64 sent = 0;
+        u32 blocked = 0;
+        u32 idle = 0;
+        while (received.size() < 6000004 && idle < 100) {
+            const sys::status s = transfer.send(client, &sent);
+            ASSERT_TRUE(s == sys::status::SUCCESS || s == sys::status::WOULD_BLOCK);
+            // Only bytes which left the queue are counted
+            ASSERT_EQ(6000000, sent + transfer.remaining());
+            blocked += s == sys::status::WOULD_BLOCK;
+            pollfd descriptor{ .fd = server.socket_fd, .events = POLLIN, .revents = 0 };
+            ::poll(&descriptor, 1, 100);
+            server.poll();
+            u8* data = nullptr;
+            const size_t size = server.read(&data);
+            received.append(reinterpret_cast<char*>(data), size);
+            server.clear(size);
+            idle = size == 0 ? idle + 1 : 0;
+        }
+        ASSERT_EQ(6000004, received.size());
+        ASSERT_EQ(sys::status::SUCCESS, transfer.send(client));
+        ASSERT_TRUE(transfer.is_done());
+        ASSERT_GT(blocked, 0);
+        ASSERT_EQ(6000000, sent);
+        ASSERT_EQ("head" + content.substr(1000, 6000000), received);
+    }
+
+    file_transfer transfer{};
+    ASSERT_EQ(sys::status::INVALID_ARGUMENT, file_transfer::open("transfer.bin", &transfer, content.size() + 1));
+    ASSERT_EQ(sys::status::FILE_NOT_FOUND, file_transfer::open("missing.bin", &transfer));
+    remove("transfer.bin");
+}
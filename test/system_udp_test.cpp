@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include "../include/utils/system.h"
+
+using namespace sys::socket;
+
+static void wait_readable(const udp_socket& socket) {
+    pollfd descriptor{ .fd = socket.socket_fd, .events = POLLIN, .revents = 0 };
+    ::poll(&descriptor, 1, 1000);
+}
+
+// Receives datagrams until there are as many as expected or nothing arrives for a while
+static vec<str> receive_all(udp_socket& socket, packet_batch& batch, const size_t expected, vec<u16>* const ports = nullptr) {
+    vec<str> datagrams{};
+    for (u32 attempt = 0; attempt < 100 && datagrams.size() < expected; attempt++) {
+        wait_readable(socket);
+        while (socket.receive(&batch) == sys::status::SUCCESS) {
+            batch.for_each_datagram([&](const std::span<const u8> datagram, const endpoint& from) {
+                datagrams.emplace_back(reinterpret_cast<const char*>(datagram.data()), datagram.size());
+                if (ports != nullptr) ports->push_back(from.port());
+            });
+        }
+    }
+    return datagrams;
+}
+
+TEST(UdpTest, batches_are_exchanged_over_loopback) {
+    udp_socket server{};
+    ASSERT_EQ(sys::status::SUCCESS, udp_socket::bind("127.0.0.1", 0, &server));
+    ASSERT_NE(0, server.port());
+    udp_socket client{};
+    ASSERT_EQ(sys::status::SUCCESS, udp_socket::create("127.0.0.1", server.port(), &client));
+
+    packet_batch batch{};
+    ASSERT_EQ(sys::status::SUCCESS, packet_batch::create(16, 1500, &batch));
+    ASSERT_EQ(sys::status::WOULD_BLOCK, server.receive(&batch));
+    ASSERT_TRUE(batch.is_empty());
+
+    // Batch is smaller than the amount of packets, so it's sent and received in parts
+    constexpr u32 packets = 100;
+    packet_batch outgoing{};
+    ASSERT_EQ(sys::status::SUCCESS, packet_batch::create(32, 1500, &outgoing));
+    const vec<u8> too_big(1501);
+    ASSERT_FALSE(outgoing.add(too_big.data(), too_big.size()));
+    for (u32 i = 0; i < packets; i++) {
+        const str payload = "packet " + std::to_string(i);
+        if (!outgoing.add(payload.data(), payload.size())) {
+            ASSERT_EQ(32, outgoing.size());
+            ASSERT_EQ(sys::status::SUCCESS, client.send(outgoing));
+            outgoing.clear();
+            ASSERT_TRUE(outgoing.add(payload.data(), payload.size()));
+        }
+    }
+    u32 sent = 0;
+    ASSERT_EQ(sys::status::SUCCESS, client.send(outgoing, &sent));
+    ASSERT_EQ(packets % 32, sent);
+    ASSERT_TRUE(outgoing.is_sent());
+
+    vec<u16> ports{};
+    const vec<str> received = receive_all(server, batch, packets, &ports);
+    ASSERT_EQ(packets, received.size());
+    for (u32 i = 0; i < packets; i++) {
+        ASSERT_EQ("packet " + std::to_string(i), received[i]);
+        ASSERT_EQ(client.port(), ports[i]);
+    }
+
+    // Reply to the sender
+    endpoint to{};
+    ASSERT_EQ(sys::status::SUCCESS, endpoint::resolve("127.0.0.1", client.port(), &to));
+    outgoing.clear();
+    ASSERT_TRUE(outgoing.add("reply", 5, &to));
+    ASSERT_EQ(sys::status::SUCCESS, server.send(outgoing));
+    const vec<str> replies = receive_all(client, batch, 1);
+    ASSERT_EQ(1, replies.size());
+    ASSERT_EQ("reply", replies[0]);
+}
+
+TEST(UdpTest, segmented_packet_arrives_as_datagrams) {
+    udp_socket server{};
+    ASSERT_EQ(sys::status::SUCCESS, udp_socket::bind("127.0.0.1", 0, &server));
+    udp_socket client{};
+    ASSERT_EQ(sys::status::SUCCESS, udp_socket::create("127.0.0.1", server.port(), &client));
+    // Coalesced datagrams are split back by for_each_datagram()
+    server.enable_gro();
+
+    // 10 datagrams of 1000 bytes and the last one of 500
+    str payload(10500, 0);
+    for (size_t i = 0; i < payload.size(); i++) payload[i] = static_cast<char>('a' + i / 1000);
+    packet_batch outgoing{};
+    ASSERT_EQ(sys::status::SUCCESS, packet_batch::create(1, 64 * KB, &outgoing));
+    // Kernel splits a packet into at most MAX_SEGMENTS datagrams
+    ASSERT_FALSE(outgoing.add(payload.data(), packet_batch::MAX_SEGMENTS * 100 + 1, nullptr, 100));
+    ASSERT_TRUE(outgoing.is_empty());
+    ASSERT_TRUE(outgoing.add(payload.data(), payload.size(), nullptr, 1000));
+    if (client.send(outgoing) != sys::status::SUCCESS) GTEST_SKIP() << "UDP segmentation offload is not supported";
+
+    packet_batch batch{};
+    ASSERT_EQ(sys::status::SUCCESS, packet_batch::create(16, 64 * KB, &batch));
+    const vec<str> received = receive_all(server, batch, 11);
+    ASSERT_EQ(11, received.size());
+    for (size_t i = 0; i < 11; i++) ASSERT_EQ(payload.substr(i * 1000, 1000), received[i]);
+}